@@ -0,0 +1,62 @@
+#include "Accumulator.h"
+
+#include <cmath>
+#include <limits>
+
+Accumulator::Accumulator() :
+    m_width(0),
+    m_height(0)
+{ }
+
+void Accumulator::reset(int width, int height)
+{
+    std::size_t pixels = (std::size_t) width * (std::size_t) height;
+
+    m_width = width;
+    m_height = height;
+
+    m_red.assign(pixels, 0.0f);
+    m_green.assign(pixels, 0.0f);
+    m_blue.assign(pixels, 0.0f);
+    m_mean.assign(pixels, 0.0f);
+    m_m2.assign(pixels, 0.0f);
+    m_count.assign(pixels, 0);
+}
+
+void Accumulator::add(std::size_t pixel, int red, int green, int blue)
+{
+    m_red[pixel] += red;
+    m_green[pixel] += green;
+    m_blue[pixel] += blue;
+
+    float luminance = 0.299f * red + 0.587f * green + 0.114f * blue;
+    int count = ++m_count[pixel];
+    float delta = luminance - m_mean[pixel];
+    m_mean[pixel] += delta / count;
+    m_m2[pixel] += delta * (luminance - m_mean[pixel]);
+}
+
+double Accumulator::standardError(std::size_t pixel) const
+{
+    int count = m_count[pixel];
+
+    if (count < 2) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    return std::sqrt((double) m_m2[pixel] / (double) (count - 1) / (double) count);
+}
+
+void Accumulator::resolve(int y, QRgb* out) const
+{
+    std::size_t first = index(0, y);
+
+    for (int x = 0; x < m_width; x++) {
+        std::size_t pixel = first + x;
+        float recip_count = m_count[pixel] > 0 ? 1.0f / (float) m_count[pixel] : 0.0f;
+
+        out[x] = qRgb((int) (m_red[pixel] * recip_count + 0.5f),
+                      (int) (m_green[pixel] * recip_count + 0.5f),
+                      (int) (m_blue[pixel] * recip_count + 0.5f));
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef Accumulator_H
+#define Accumulator_H
+
+#include <cstddef>
+#include <vector>
+
+#include <QColor>
+
+/*
+ * Running per-pixel color sums for progressive supersampling. Every pixel
+ * also tracks the variance of its samples' luminance (Welford's method), so
+ * it knows how far its mean can still be from the converged color.
+ */
+class Accumulator
+{
+    private:
+        int m_width;
+        int m_height;
+        std::vector<float> m_red;
+        std::vector<float> m_green;
+        std::vector<float> m_blue;
+        std::vector<float> m_mean;
+        std::vector<float> m_m2;
+        std::vector<int> m_count;
+
+    public:
+        Accumulator();
+
+        //Forgets all samples
+        void reset(int width, int height);
+
+        int width() const                           { return m_width; }
+        int height() const                          { return m_height; }
+        std::size_t index(int x, int y) const       { return (std::size_t) y * (std::size_t) m_width + (std::size_t) x; }
+
+        void add(std::size_t pixel, int red, int green, int blue);
+
+        int count(std::size_t pixel) const          { return m_count[pixel]; }
+
+        //Standard error of the pixel's mean luminance, in 8 bit levels
+        double standardError(std::size_t pixel) const;
+
+        //Means of one row of pixels
+        void resolve(int y, QRgb* out) const;
+};
+
+#endif
@@ -1,69 +1,168 @@
 #include "BackgroundWorker.h"
 #include "MainWindow.h"
 #include "RenderParams.h"
+#include "SampleBuffer.h"
+#include "EscapeTime.h"
+#include "SampleGrid.h"
+#include "ColorTable.h"
+#include "Downsampler.h"
+#include "Accumulator.h"
+#include "Topology.h"
+#include "OrbitSampler.h"
+#include "Trace.h"
+#include "JobScheduler.h"
 
 #include <complex>
+#include <cmath>
 #include <thread>
 #include <chrono>
 #include <cassert>
 #include <iostream>
 #include <mutex>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
 namespace
 {
-    double mandelbrot(const double c_real, const double c_imag, const int maxIters, const double boundary)
+    //Automatic iteration budget: keep doubling the limit while at least this
+    //fraction of all samples escapes in the latest step
+    const double AUTO_ITERATIONS_THRESHOLD = 0.001;
+    const int AUTO_ITERATIONS_LIMIT = 1 << 20;
+
+    //Rows are prioritized in bands of this many, so neighbouring rows are still computed together
+    const int PRIORITY_BAND_ROWS = 8;
+
+    //Progressive refinement: a pixel gets samples until the standard error of its
+    //luminance drops below this many 8 bit levels, within these limits
+    const double REFINE_STANDARD_ERROR = 0.5;
+    const int REFINE_MIN_SAMPLES = 8;
+    const int REFINE_MAX_SAMPLES = 1024;
+
+    //Steps of the R2 sequence, from the plastic number
+    const double R2_STEP_X = 0.7548776662466927;
+    const double R2_STEP_Y = 0.5698402909980532;
+
+    //Orbit density renders: points are escape tested in batches of this many, and
+    //the render stops once this many orbits per pixel were drawn
+    const int ORBIT_BATCH = 64;
+    const int ORBITS_PER_PIXEL = 256;
+
+    //Passes start short so the first image shows up quickly, then get longer up to this
+    const int DENSITY_FIRST_PASS_MS = 50;
+    const int DENSITY_MAX_PASS_MS = 1000;
+
+    //Progress counts coloring and downsampling a sample as this many iterations of work
+    const long long SAMPLE_WORK = 4;
+
+    //Colorized tiles in flight per render thread
+    const int QUEUE_TILES_PER_THREAD = 2;
+
+    /*
+     * Escape time images are symmetric about the real axis. If the view
+     * crosses it and the sample rows line up with their reflections, only the
+     * larger half is computed and pixel rows of the other half whose samples
+     * all have a reflection are copied. Everything else is computed as usual.
+     */
+    void splitMirroredRows(const SampleGrid& grid, const Formula& formula, int height,
+                           std::vector<int>& computeRows, std::vector<int>& mirrorRows, int& mirrorSum)
     {
-        //Test if point is in main cardioid
-        double c_real_minus_quarter = c_real - 0.25;
-        double c_imag_square = c_imag * c_imag;
-        double q =  c_real_minus_quarter * c_real_minus_quarter + c_imag_square;
-        double c1_test = q * (q + c_real_minus_quarter);
+        int antialiasing = grid.antialiasing();
+        int sampleHeight = height * antialiasing;
 
-        if (c1_test < 0.25 * c_imag_square) {
-            return -1;
-        }
+        computeRows.clear();
+        mirrorRows.clear();
+        mirrorSum = 0;
 
-        //Test if point is in period 2 bulb
-        double c_real_plus_1 = c_real + 1;
+        bool symmetric = formula.realAxisSymmetric() && grid.realAxisMirror(mirrorSum);
+        bool mirrorLow = false;
 
-        if (c_real_plus_1 * c_real_plus_1 + c_imag_square < 1.0 / 16.0) {
-            return -1;
+        if (symmetric) {
+            int low = std::min(std::max((mirrorSum + 1) / 2, 0), sampleHeight);
+            int high = std::min(std::max(sampleHeight - mirrorSum / 2 - 1, 0), sampleHeight);
+            mirrorLow = low < high;
         }
 
-        const double boundarySqr = boundary * boundary;
+        for (int y = 0; y < height; y++) {
+            bool mirrored = symmetric;
+
+            for (int aay = 0; aay < antialiasing && mirrored; aay++) {
+                int sampleY = y * antialiasing + aay;
+                int reflection = mirrorSum - sampleY;
+
+                mirrored = (mirrorLow ? sampleY < reflection : sampleY > reflection) &&
+                           reflection >= 0 && reflection < sampleHeight;
+            }
 
-        double z_real = c_real;
-        double z_imag = c_imag;
+            if (mirrored) {
+                mirrorRows.push_back(y);
+            } else {
+                computeRows.push_back(y);
+            }
+        }
+    }
 
-        for (int i = 0; i < maxIters; i++) {
-            double z_real_sqr = z_real * z_real;
-            double z_imag_sqr = z_imag * z_imag;
-            double z_real_imag = z_real * z_imag;
+    /*
+     * Orders rows so that the part of the image the user is looking at
+     * finishes first: bands nearest the focus row, then nearest the center,
+     * each band's rows top to bottom.
+     */
+    void prioritizeRows(std::vector<int>::iterator first, std::vector<int>::iterator last, int height, int focusRow)
+    {
+        int focusBand = focusRow / PRIORITY_BAND_ROWS;
+        int centerBand = (height / 2) / PRIORITY_BAND_ROWS;
 
-            double z_mag_sqr = z_real_sqr + z_imag_sqr;
+        std::stable_sort(first, last, [focusBand, centerBand](int a, int b) {
+            int bandA = a / PRIORITY_BAND_ROWS;
+            int bandB = b / PRIORITY_BAND_ROWS;
+            int ringA = std::abs(bandA - focusBand);
+            int ringB = std::abs(bandB - focusBand);
 
-            if (z_mag_sqr > boundarySqr) {
-                return i;
+            if (ringA != ringB) {
+                return ringA < ringB;
             }
 
-            z_real = z_real_sqr - z_imag_sqr + c_real;
-            z_imag = z_real_imag + z_real_imag + c_imag;
-        }
+            if (std::abs(bandA - centerBand) != std::abs(bandB - centerBand)) {
+                return std::abs(bandA - centerBand) < std::abs(bandB - centerBand);
+            }
 
-        return -1;
+            return a < b;
+        });
     }
 
-    const int ITERS = 256;
-    const int ANTIALIASING = 4;
+    //Pins a pool thread for the length of one task, then gives it back the CPUs it had
+    class PinnedScope
+    {
+        private:
+            std::vector<int> m_cpus;
+            bool m_pinned;
+
+        public:
+            explicit PinnedScope(int cpu) :
+                m_cpus(),
+                m_pinned(cpu >= 0 && Topology::currentThreadAffinity(m_cpus) && Topology::pinCurrentThread(cpu))
+            { }
+
+            ~PinnedScope()
+            {
+                if (m_pinned) {
+                    Topology::setCurrentThreadAffinity(m_cpus);
+                }
+            }
+    };
 }
 
 BackgroundWorker::BackgroundWorker(QWidget* parent) :
     QObject(parent),
     m_monitorThread(nullptr),
+    m_activeThreads(0),
+    m_threadMutexes(),
+    m_threadMutexCount(Topology::defaultWorkerCount()),
     m_state(STOPPED),
-    m_threadMutexes(std::thread::hardware_concurrency())
+    m_numaAware(false)
 {
+    m_threadMutexes.reset(new std::mutex[m_threadMutexCount]);
+
     connect(this, SIGNAL(workerDone()), this, SLOT(cleanup()), Qt::QueuedConnection);
 }
 
@@ -105,7 +204,7 @@ void BackgroundWorker::cleanup()
 
     delete m_monitorThread;
     m_monitorThread = nullptr;
-    assert(m_workerThreads.empty());
+    assert(m_activeThreads == 0);
 
     if (m_state == CANCELED) {
         m_state = STOPPED;
@@ -116,109 +215,987 @@ void BackgroundWorker::cleanup()
     }
 }
 
-void BackgroundWorker::task(QImage* image, const RenderParams& params, int& currentLine, int threadIndex)
+void BackgroundWorker::task(QImage* image, SampleBuffer* samples, const RenderParams& params, Pass& pass, int threadIndex, int node)
 {
+    Stage stage = Idle;
     int y = 0;
-    uchar* pixPtr = nullptr;
+    int owner = node;
+    ColorTile* tile = nullptr;
+    int escaped = 0;
+    long long samplesDone = 0;
+    long long iterationsDone = 0;
+    long long interiorDone = 0;
     int width = image->width();
     int height = image->height();
-    const ZoomRegion& region = params.zoomRegion();
-    int antialiasing = 2;//params.antialiasing();
+    int antialiasing = samples->width() / width;
+    int sampleWidth = samples->width();
+    ColorScheme::Coloring coloring = params.coloring();
+    EscapeTimeRowFunction computeRow = escapeTimeRow(samples->channels());
+    const Formula& formula = params.formula();
+    SampleGrid grid(params.zoomRegion(), width, height, antialiasing);
 
-    double recip_antialiasing_plus_1 = 1.0 / (double) (antialiasing + 1);
-    double region_width_over_width_minus_1 = (double) region.width() / (double) (width - 1);
-    double region_height_over_height_minus_1 = (double) region.height() / (double) (height - 1);
-    double recip_iters_minus_1 = 1.0 / (double) (ITERS - 1);
-    double recip_antialiasing_square = 1.0 / (double) (antialiasing * antialiasing);
+    //Real coordinates are the same for every sample row
+    std::vector<double> reals(sampleWidth);
+    std::vector<float> indices(sampleWidth);
+
+    for (int sx = 0; sx < sampleWidth; sx++) {
+        reals[sx] = grid.real(sx);
+    }
+
+    Trace::nameThread("render");
 
     while (true) {
         {
+            Trace::Span lockSpan("wait line lock");
             std::unique_lock<std::mutex> lock(this->m_lineMutex);
+            lockSpan.end();
 
-            if (currentLine >= height) {
-                break;
+            pass.escaped += escaped;
+            pass.samples += samplesDone;
+            pass.iterations += iterationsDone;
+            pass.interiorSamples += interiorDone;
+            escaped = 0;
+            samplesDone = 0;
+            iterationsDone = 0;
+            interiorDone = 0;
+
+            //Hand the finished tile on to the next stage
+            switch (stage) {
+                case Compute:
+                    pass.computing--;
+                    pass.computed[owner].push_back(y);
+                    pass.queued++;
+                    break;
+
+                case Colorize:
+                    pass.colorized[node].push_back(tile);
+                    break;
+
+                case Downsample:
+                    pass.freeTiles.push_back(tile);
+                    break;
+
+                case Idle:
+                    break;
+            }
+
+            if (stage != Idle) {
+                pass.busy--;
+                m_stageCondition.notify_all();
             }
 
-            y = currentLine++;
-            pixPtr = image->scanLine(y);
+            //Later stages first, so that tiles drain and the queues stay bounded
+            while (true) {
+                if (this->m_state == CANCELED) {
+                    m_stageCondition.notify_all();
+                    return;
+                }
 
-            int progress = (int) ((double) y / (double) height * 100);
-            emit progressUpdate(progress);
+                //Only rows of this node's band are colored and written here, even if another node computed them
+                if (!pass.colorized[node].empty()) {
+                    stage = Downsample;
+                    tile = pass.colorized[node].front();
+                    pass.colorized[node].pop_front();
+                    break;
+                }
+
+                if (!pass.computed[node].empty() && !pass.freeTiles.empty()) {
+                    stage = Colorize;
+                    y = pass.computed[node].front();
+                    pass.computed[node].pop_front();
+                    pass.queued--;
+                    tile = pass.freeTiles.back();
+                    pass.freeTiles.pop_back();
+                    break;
+                }
+
+                int source = node;
+
+                if (pass.nextLine[source] >= pass.endLine[source]) {
+                    for (std::size_t other = 0; other < pass.nextLine.size(); other++) {
+                        if (pass.endLine[other] - pass.nextLine[other] > pass.endLine[source] - pass.nextLine[source]) {
+                            source = other;
+                        }
+                    }
+                }
+
+                bool rowsLeft = pass.nextLine[source] < pass.endLine[source];
+
+                if (rowsLeft && pass.queued + pass.computing < pass.queueCapacity) {
+                    if (source != node) {
+                        pass.remoteRows++;
+                    }
+
+                    stage = Compute;
+                    owner = source;
+                    y = (*pass.rows)[pass.nextLine[source]++];
+                    pass.nodeRows[node]++;
+                    pass.computing++;
+                    break;
+                }
+
+                //Rows other nodes still have queued are theirs to finish
+                if (!rowsLeft && pass.busy == 0 && pass.computed[node].empty()) {
+                    return;
+                }
+
+                Trace::Span idleSpan("wait for work");
+                m_stageCondition.wait(lock);
+            }
+
+            pass.busy++;
         }
 
-        {
-            std::unique_lock<std::mutex> lock(this->m_threadMutexes[threadIndex]);
+        Trace::Span threadLockSpan("wait thread lock");
+        std::unique_lock<std::mutex> lock(this->m_threadMutexes[threadIndex]);
+        threadLockSpan.end();
 
-            for (int x = 0; x < width; x++) {
-                int totalRed = 0;
-                int totalGreen = 0;
-                int totalBlue = 0;
+        switch (stage) {
+            case Compute: {
+                if (pass.colorOnly) {
+                    break;
+                }
 
-                for (int aay = 0; aay < antialiasing; aay++) {
-                    double y_offset = (double) aay * recip_antialiasing_plus_1 - 0.5;
-                    double imag = ((double) y + y_offset) * region_height_over_height_minus_1 + region.location().y();
+                Trace::Span span(pass.mirror ? "mirror" : "compute", y);
 
-                    for (int aax = 0; aax < antialiasing; aax++) {
-                        double x_offset = (double) aax * recip_antialiasing_plus_1 - 0.5;
-                        double real = ((double) x + x_offset) * region_width_over_width_minus_1 + region.location().x();
+                for (int aay = 0; aay < antialiasing && pass.mirror; aay++) {
+                    samples->mirrorRow(pass.mirrorSum - (y * antialiasing + aay), y * antialiasing + aay);
+                }
 
-                        int numIters = mandelbrot(real, imag, ITERS, 2.0);
+                for (int aay = 0; aay < antialiasing && !pass.mirror; aay++) {
+                    double imag = grid.imag(y * antialiasing + aay);
 
-                        //TODO: use color maps
-                        //totalColor += (double) numIters * recip_iters_minus_1;
-                        QColor col = params.colorScheme().calculateColor(numIters, ITERS);
-                        totalRed   += col.red();
-                        totalGreen += col.green();
-                        totalBlue  += col.blue();
+                    std::size_t rowStart = samples->index(0, y * antialiasing + aay);
+                    if (formula.convergent()) {
+                        escaped += formula.row(reals.data(), imag, sampleWidth, pass.maxIterations, *samples, rowStart, pass.resume);
+                    } else {
+                        escaped += computeRow(reals.data(), imag, sampleWidth, pass.maxIterations, 2.0, *samples, rowStart, pass.resume);
                     }
+
+                    //Work accounting for throughput estimates
+                    const int* rowIterations = samples->iterations() + rowStart;
+                    long long rowWork = 0;
+
+                    for (int sx = 0; sx < sampleWidth; sx++) {
+                        if (rowIterations[sx] >= 0) {
+                            rowWork += rowIterations[sx];
+                        } else {
+                            rowWork += pass.maxIterations;
+                            interiorDone++;
+                        }
+                    }
+
+                    this->m_progress.add(0, rowWork);
+                    iterationsDone += rowWork;
+                    samplesDone += sampleWidth;
                 }
+                break;
+            }
+
+            case Colorize: {
+                Trace::Span span("colorize", y);
+                tile->y = y;
+
+                for (int aay = 0; aay < antialiasing; aay++) {
+                    std::size_t rowStart = samples->index(0, y * antialiasing + aay);
+                    std::size_t tileStart = (std::size_t) aay * sampleWidth;
+
+                    ColorScheme::indices(coloring, *samples, rowStart, sampleWidth, pass.maxIterations, indices.data());
+                    pass.colorTable->lookup(indices.data(), sampleWidth,
+                                            &tile->red[tileStart], &tile->green[tileStart], &tile->blue[tileStart]);
+                }
+                break;
+            }
 
-                int red   = (int) ((double) totalRed   * recip_antialiasing_square + 0.5);
-                int green = (int) ((double) totalGreen * recip_antialiasing_square + 0.5);
-                int blue  = (int) ((double) totalBlue  * recip_antialiasing_square + 0.5);
+            case Downsample: {
+                Trace::Span span("downsample", tile->y);
+                pass.downsampler->downsample(tile->red.data(), tile->green.data(), tile->blue.data(),
+                                             sampleWidth, width, (QRgb*) image->scanLine(tile->y));
 
-                *(QRgb*)pixPtr = qRgb(red, green, blue);
-                pixPtr += sizeof(QRgb);
+                //A row counts as done once it is on screen
+                this->m_progress.add((long long) sampleWidth * antialiasing, (long long) sampleWidth * antialiasing * SAMPLE_WORK);
+                break;
             }
+
+            case Idle:
+                break;
         }
+    }
+}
 
-        if (this->m_state == CANCELED) {
-            return;
+void BackgroundWorker::run(QImage* image, SampleBuffer* samples, const RenderParams& params)
+{
+    start(image, samples, params, false);
+}
+
+void BackgroundWorker::resume(QImage* image, SampleBuffer* samples, const RenderParams& params)
+{
+    //Only a buffer with iteration state for this exact image can be continued
+    bool resumable = samples->hasChannels(params.channels() | SampleBuffer::State) &&
+                     samples->width() % image->width() == 0 &&
+                     samples->width() / image->width() == samples->height() / image->height();
+
+    start(image, samples, params, resumable);
+}
+
+void BackgroundWorker::recolor(QImage* image, SampleBuffer* samples, const RenderParams& params)
+{
+    assert(samples->hasChannels(ColorScheme::channels(params.coloring())));
+    assert(samples->width() % image->width() == 0 && samples->width() / image->width() == samples->height() / image->height());
+
+    start(image, samples, params, true, true);
+}
+
+int BackgroundWorker::prepareThreads(const RenderParams& params)
+{
+    //Only safe while no worker holds a thread mutex, i.e. between jobs
+    int threads = params.threadCount() > 0 ? params.threadCount() : Topology::defaultWorkerCount();
+
+    if (threads > m_threadMutexCount) {
+        m_threadMutexes.reset(new std::mutex[threads]);
+        m_threadMutexCount = threads;
+    }
+
+    return threads;
+}
+
+void BackgroundWorker::runWorkers(int threads, int niceness, const std::function<void(int)>& worker)
+{
+    m_activeThreads = threads;
+
+    //A raised nice value cannot be taken back without privileges, so niced passes get threads of their own instead of the pool's
+    if (niceness > 0) {
+        std::vector<std::thread> workers;
+
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([&worker, niceness, i]() {
+                Topology::setCurrentThreadNiceness(niceness);
+                worker(i);
+            });
+        }
+
+        for (std::thread& thread : workers) {
+            thread.join();
         }
+
+        return;
     }
+
+    JobScheduler& scheduler = JobScheduler::shared();
+    scheduler.reserve(threads);
+
+    JobScheduler::JobHandle job = scheduler.submit(JobScheduler::Interactive, threads, [&worker](int i) {
+        worker(i);
+        return true;
+    });
+
+    scheduler.wait(job);
 }
 
-void BackgroundWorker::run(QImage* image, const RenderParams& params)
+void BackgroundWorker::start(QImage* image, SampleBuffer* samples, const RenderParams& params, bool resume, bool colorOnly)
 {
     assert(m_state == STOPPED);
     m_state = RUNNING;
 
+    int threads = prepareThreads(params);
+
+    if (!resume) {
+        int antialiasing = params.antialiasing();
+        unsigned int channels = params.channels();
+
+        if (params.autoIterations()) {
+            channels |= SampleBuffer::State;
+        }
+
+        //Reported as a canceled job, so that the canvas keeps showing what it had
+        if (!samples->reset(image->width() * antialiasing, image->height() * antialiasing, channels)) {
+            std::cerr << "Not enough memory for the samples of a " << image->width() << "x" << image->height() << " render" << std::endl;
+            m_state = STOPPED;
+
+            emit taskStart();
+            emit taskComplete(true);
+            return;
+        }
+    }
+
     emit taskStart();
 
-    m_monitorThread = new std::thread([this, image, params]() {
-        int currentLine = 0;
+    m_monitorThread = new std::thread([this, image, samples, params, resume, colorOnly, threads]() {
+        Trace::nameThread("render monitor");
+        Trace::Span jobSpan(colorOnly ? "recolor job" : "render job");
+
+        const Topology& topology = Topology::system();
+        int nodes = m_numaAware ? topology.nodeCount() : 1;
+        int height = image->height();
+
+        Pass pass;
+        pass.maxIterations = params.maxIterations();
+        pass.resume = resume;
+        pass.colorOnly = colorOnly;
+
+        //Worker i runs on node i % nodes, on a distinct CPU of that node where possible
+        std::vector<int> threadNodes(threads);
+        std::vector<int> threadCpus(threads, -1);
+        std::vector<int> nodeThreads(nodes, 0);
 
-        auto boundTask = [this, image, &params, &currentLine](int threadIndex) {
-            this->task(image, params, currentLine, threadIndex);
+        for (int i = 0; i < threads; i++) {
+            int node = i % nodes;
+            threadNodes[i] = node;
+
+            if (m_numaAware) {
+                const std::vector<int>& cpus = topology.cpus(node);
+                threadCpus[i] = cpus[nodeThreads[node] % cpus.size()];
+            }
+
+            nodeThreads[node]++;
+        }
+
+        std::vector<int> computeRows;
+        std::vector<int> mirrorRows;
+        int mirrorSum;
+        splitMirroredRows(SampleGrid(params.zoomRegion(), image->width(), height, samples->height() / height),
+                          params.formula(), height, computeRows, mirrorRows, mirrorSum);
+        int focusRow = std::min(std::max((int) (params.focusY() * height), 0), height - 1);
+        int computeFocusRow = focusRow;
+
+        //Rows over the mirrored half only show up once their reflections are computed, so those go first
+        if (std::binary_search(mirrorRows.begin(), mirrorRows.end(), focusRow)) {
+            int sampleRows = samples->height() / height;
+            computeFocusRow = std::min(std::max((mirrorSum - (focusRow + 1) * sampleRows + 1) / sampleRows, 0), height - 1);
+        }
+
+        auto boundTask = [this, image, samples, &params, &pass](int threadIndex, int node, int cpu, std::int64_t queued) {
+            if (queued >= 0) {
+                Trace::record("wait for pool", queued, Trace::now(), -1);
+            }
+
+            PinnedScope pinned(cpu);
+            this->task(image, samples, params, pass, threadIndex, node);
         };
 
         std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
 
-        for (unsigned int i = 0; i < std::thread::hardware_concurrency(); i++) {
-            m_workerThreads.emplace_back(boundTask, i);
+        m_stats = RenderStats();
+        m_stats.threads = threads;
+        m_stats.pinned = m_numaAware;
+        m_stats.nodeRows.assign(nodes, 0);
+        m_stats.mirroredRows = mirrorRows.size();
+
+        //Colorized tiles waiting to be downsampled; also bounds the rows computed ahead of colorizing
+        int sampleRows = samples->height() / height;
+        //Kept between passes, so a render only allocates tiles when it needs more or larger ones than the last
+        std::vector<std::unique_ptr<ColorTile>>& tiles = m_colorTiles;
+        std::size_t tileSamples = (std::size_t) samples->width() * sampleRows;
+
+        tiles.resize(QUEUE_TILES_PER_THREAD * threads);
+
+        for (std::unique_ptr<ColorTile>& tile : tiles) {
+            if (!tile) {
+                tile.reset(new ColorTile());
+            }
+
+            tile->red.resize(tileSamples);
+            tile->green.resize(tileSamples);
+            tile->blue.resize(tileSamples);
         }
 
-        for (std::thread& thread : m_workerThreads) {
-            thread.join();
+        Downsampler downsampler(params.filter(), sampleRows);
+        pass.downsampler = &downsampler;
+        pass.queueCapacity = tiles.size();
+
+        //With several nodes each one works through its own share in priority order
+        auto runPhase = [&](std::vector<int>& rows, bool mirror, int phaseFocusRow) {
+            pass.rows = &rows;
+            pass.mirror = mirror;
+            pass.mirrorSum = mirrorSum;
+            pass.computing = 0;
+            pass.busy = 0;
+            pass.computed.assign(nodes, std::deque<int>());
+            pass.colorized.assign(nodes, std::deque<ColorTile*>());
+            pass.queued = 0;
+            pass.freeTiles.clear();
+
+            for (const std::unique_ptr<ColorTile>& tile : tiles) {
+                pass.freeTiles.push_back(tile.get());
+            }
+
+            //Each node owns a contiguous band of rows in proportion to its thread count
+            pass.nextLine.assign(nodes, 0);
+            pass.endLine.assign(nodes, 0);
+            pass.nodeRows.assign(nodes, 0);
+            pass.remoteRows = 0;
+
+            for (int node = 0, assigned = 0; node < nodes; node++) {
+                pass.nextLine[node] = (int) ((long long) rows.size() * assigned / threads);
+                assigned += nodeThreads[node];
+                pass.endLine[node] = (int) ((long long) rows.size() * assigned / threads);
+
+                //Only within the band, so it stays the node's own contiguous rows; the same set of rows each pass
+                prioritizeRows(rows.begin() + pass.nextLine[node], rows.begin() + pass.endLine[node], height, phaseFocusRow);
+            }
+
+            std::int64_t queued = Trace::enabled() ? Trace::now() : -1;
+
+            runWorkers(threads, params.niceness(), [&](int i) {
+                boundTask(i, threadNodes[i], threadCpus[i], queued);
+            });
+
+            m_activeThreads = 0;
+
+            for (int node = 0; node < nodes; node++) {
+                m_stats.nodeRows[node] += pass.nodeRows[node];
+            }
+
+            m_stats.remoteRows += pass.remoteRows;
+        };
+
+        while (true) {
+            pass.escaped = 0;
+            pass.samples = 0;
+            pass.iterations = 0;
+            pass.interiorSamples = 0;
+
+            m_progress.start((long long) (computeRows.size() + mirrorRows.size()) * samples->width() * sampleRows);
+
+            ColorTable colorTable(params.colorScheme(), pass.maxIterations);
+            pass.colorTable = &colorTable;
+
+            //Mirrored rows are copied from computed ones, so they go strictly afterwards
+            runPhase(computeRows, false, computeFocusRow);
+
+            if (!mirrorRows.empty() && m_state != CANCELED) {
+                runPhase(mirrorRows, true, focusRow);
+            }
+
+            m_stats.samples += pass.samples;
+            m_stats.iterations += pass.iterations;
+            m_stats.interiorSamples += pass.interiorSamples;
+
+            if (m_state == CANCELED || pass.colorOnly || !params.autoIterations() || !samples->hasChannels(SampleBuffer::State)) {
+                break;
+            }
+
+            //The first step past the requested limit is always taken; after that only while it pays off
+            double escapedFraction = pass.samples > 0 ? (double) pass.escaped / (double) pass.samples : 0.0;
+
+            if (pass.resume && escapedFraction < AUTO_ITERATIONS_THRESHOLD) {
+                break;
+            }
+
+            if (pass.maxIterations >= AUTO_ITERATIONS_LIMIT || samples->countStatus(SampleBuffer::Pending) == 0) {
+                break;
+            }
+
+            pass.maxIterations *= 2;
+            pass.resume = true;
+
+            emit iterationLimitChanged(pass.maxIterations);
         }
 
         std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
 
         std::chrono::steady_clock::duration duration = end_time - begin_time;
 
-        std::cout << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0  << " ms" << std::endl;
+        m_stats.milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+        m_stats.maxIterations = pass.maxIterations;
+
+        std::cout << m_stats.summary() << std::endl;
+
+        emit workerDone();
+    });
+}
+
+void BackgroundWorker::refineTask(QImage* image, const SampleBuffer* samples, Accumulator* accumulator, const RenderParams& params,
+                                  const ColorTable& colorTable, RefinePass& pass, int threadIndex)
+{
+    int width = image->width();
+    int height = image->height();
+    ColorScheme::Coloring coloring = params.coloring();
+    unsigned int channels = ColorScheme::channels(coloring);
+    EscapeTimePointsFunction computePoints = escapeTimePoints(channels);
+    const Formula& formula = params.formula();
+    SampleGrid grid(params.zoomRegion(), width, height, 1);
+
+    //Seeding colorizes whole sample rows of the finished render; refining computes one point per pixel
+    int antialiasing = pass.seed ? samples->width() / width : 1;
+    int rowLength = width * antialiasing;
+    SampleBuffer points(rowLength, 1, channels);
+    std::vector<double> reals(rowLength);
+    std::vector<double> imags(rowLength);
+    std::vector<int> pixels(rowLength);
+    std::vector<float> indices(rowLength);
+    std::vector<unsigned char> red(rowLength);
+    std::vector<unsigned char> green(rowLength);
+    std::vector<unsigned char> blue(rowLength);
+
+    long long samplesDone = 0;
+    long long iterationsDone = 0;
+    int active = 0;
+
+    Trace::nameThread("refine");
+
+    while (true) {
+        int y;
+
+        {
+            Trace::Span lockSpan("wait line lock");
+            std::unique_lock<std::mutex> lock(this->m_lineMutex);
+            lockSpan.end();
+
+            pass.samples += samplesDone;
+            pass.iterations += iterationsDone;
+            pass.active += active;
+            samplesDone = 0;
+            iterationsDone = 0;
+            active = 0;
+
+            if (pass.nextLine >= height || this->m_state == CANCELED) {
+                return;
+            }
+
+            y = pass.nextLine++;
+        }
+
+        Trace::Span threadLockSpan("wait thread lock");
+        std::unique_lock<std::mutex> lock(this->m_threadMutexes[threadIndex]);
+        threadLockSpan.end();
+
+        Trace::Span span(pass.seed ? "seed row" : "refine row", y);
+
+        if (pass.seed) {
+            for (int aay = 0; aay < antialiasing; aay++) {
+                std::size_t rowStart = samples->index(0, y * antialiasing + aay);
+
+                ColorScheme::indices(coloring, *samples, rowStart, rowLength, params.maxIterations(), indices.data());
+                colorTable.lookup(indices.data(), rowLength, red.data(), green.data(), blue.data());
+
+                for (int sx = 0; sx < rowLength; sx++) {
+                    accumulator->add(accumulator->index(sx / antialiasing, y), red[sx], green[sx], blue[sx]);
+                }
+            }
+        } else {
+            //Each pixel walks its own R2 sequence, rotated by a per-pixel hash so neighbours do not share a pattern
+            int count = 0;
+
+            for (int x = 0; x < width; x++) {
+                std::size_t pixel = accumulator->index(x, y);
+                int n = accumulator->count(pixel);
+
+                if (n >= REFINE_MIN_SAMPLES && (n >= REFINE_MAX_SAMPLES || accumulator->standardError(pixel) < REFINE_STANDARD_ERROR)) {
+                    continue;
+                }
+
+                unsigned int hash = ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u);
+                hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+                hash ^= hash >> 15;
+
+                double u = 0.5 + R2_STEP_X * n + (double) (hash & 0xffff) / 65536.0;
+                double v = 0.5 + R2_STEP_Y * n + (double) (hash >> 16) / 65536.0;
+
+                reals[count] = grid.pointReal((double) x + (u - std::floor(u)) - 0.5);
+                imags[count] = grid.pointImag((double) y + (v - std::floor(v)) - 0.5);
+                pixels[count] = x;
+                count++;
+            }
+
+            if (formula.convergent()) {
+                formula.points(reals.data(), imags.data(), count, params.maxIterations(), points, 0);
+            } else {
+                computePoints(reals.data(), imags.data(), count, params.maxIterations(), 2.0, points, 0);
+            }
+            ColorScheme::indices(coloring, points, 0, count, params.maxIterations(), indices.data());
+            colorTable.lookup(indices.data(), count, red.data(), green.data(), blue.data());
+
+            for (int i = 0; i < count; i++) {
+                accumulator->add(accumulator->index(pixels[i], y), red[i], green[i], blue[i]);
+
+                int iterations = points.iterations()[i];
+                iterationsDone += iterations >= 0 ? iterations : params.maxIterations();
+            }
+
+            samplesDone += count;
+        }
+
+        for (int x = 0; x < width; x++) {
+            std::size_t pixel = accumulator->index(x, y);
+            int n = accumulator->count(pixel);
+
+            if (n < REFINE_MIN_SAMPLES || (n < REFINE_MAX_SAMPLES && accumulator->standardError(pixel) >= REFINE_STANDARD_ERROR)) {
+                active++;
+            }
+        }
+
+        accumulator->resolve(y, (QRgb*) image->scanLine(y));
+
+        //Every refinement pass sweeps the rows once; only its own work counts
+        this->m_progress.add(width, iterationsDone + (long long) width * SAMPLE_WORK);
+    }
+}
+
+void BackgroundWorker::refine(QImage* image, const SampleBuffer* samples, Accumulator* accumulator, const RenderParams& params)
+{
+    assert(m_state == STOPPED);
+    m_state = RUNNING;
+
+    int threads = prepareThreads(params);
+
+    emit taskStart();
+
+    m_monitorThread = new std::thread([this, image, samples, accumulator, params, threads]() {
+        Trace::nameThread("render monitor");
+        Trace::Span jobSpan("refine job");
+
+        std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+
+        ColorTable colorTable(params.colorScheme(), params.maxIterations());
+        int pixels = image->width() * image->height();
+
+        m_stats = RenderStats();
+        m_stats.threads = threads;
+        m_stats.maxIterations = params.maxIterations();
+
+        //The first pass starts every pixel from the samples of the finished render
+        RefinePass pass;
+        pass.seed = true;
+        accumulator->reset(image->width(), image->height());
+
+        while (true) {
+            pass.nextLine = 0;
+            pass.active = 0;
+            pass.samples = 0;
+            pass.iterations = 0;
+
+            m_progress.start(pixels);
+
+            runWorkers(threads, params.niceness(), [this, image, samples, accumulator, &params, &colorTable, &pass](int i) {
+                this->refineTask(image, samples, accumulator, params, colorTable, pass, i);
+            });
+
+            m_activeThreads = 0;
+
+            m_stats.samples += pass.samples;
+            m_stats.iterations += pass.iterations;
+
+            if (m_state == CANCELED) {
+                break;
+            }
+
+            m_stats.refinePasses++;
+
+            emit refinePassComplete();
+
+            if (pass.active == 0) {
+                break;
+            }
+
+            pass.seed = false;
+        }
+
+        std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - begin_time;
+        m_stats.milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+
+        std::cout << m_stats.summary() << std::endl;
+
+        emit workerDone();
+    });
+}
+
+void BackgroundWorker::densityTask(DensityBuffer* density, const RenderParams& params, DensityBuffer::Mode mode,
+                                   const OrbitSampler& sampler, DensityPass& pass, int threadIndex)
+{
+    int width = density->width();
+    int height = density->height();
+    int maxIterations = params.maxIterations();
+    SampleGrid grid(params.zoomRegion(), width, height, 1);
+
+    //Orbit points are binned into the pixel whose center is nearest
+    double left = grid.pointReal(-0.5);
+    double top = grid.pointImag(-0.5);
+    double scaleX = 1.0 / (grid.pointReal(1.0) - grid.pointReal(0.0));
+    double scaleY = 1.0 / (grid.pointImag(1.0) - grid.pointImag(0.0));
+
+    //The Nebulabrot adds an orbit to every channel whose limit it escaped within
+    int limits[DensityBuffer::CHANNELS] = { maxIterations,
+                                            std::max(maxIterations / 10, 16),
+                                            std::max(maxIterations / 100, 16) };
+
+    EscapeTimePointsFunction computePoints = escapeTimePoints(SampleBuffer::Iterations);
+    SampleBuffer points(ORBIT_BATCH, 1, SampleBuffer::Iterations);
+    double reals[ORBIT_BATCH];
+    double imags[ORBIT_BATCH];
+    int cells[ORBIT_BATCH];
+    std::uint32_t weights[ORBIT_BATCH];
+
+    OrbitSampler::Statistics statistics;
+    std::uint64_t random = ((std::uint64_t) pass.number << 32) + (std::uint64_t) threadIndex;
+    long long orbits = 0;
+    long long iterationsDone = 0;
+
+    Trace::nameThread("density");
+    Trace::Span span("orbits");
+
+    while (this->m_state != CANCELED && std::chrono::steady_clock::now() < pass.deadline) {
+        for (int i = 0; i < ORBIT_BATCH; i++) {
+            sampler.sample(random, reals[i], imags[i], cells[i], weights[i]);
+        }
+
+        computePoints(reals, imags, ORBIT_BATCH, maxIterations, 2.0, points, 0);
+
+        //Escape tests and replayed orbit steps
+        long long batchWork = 0;
+
+        for (int i = 0; i < ORBIT_BATCH; i++) {
+            int iterations = points.iterations()[i];
+            int steps = 0;
+            int channelMask = 1;
+
+            if (mode == DensityBuffer::AntiBuddhabrot) {
+                steps = iterations < 0 ? maxIterations : 0;
+            } else if (iterations > 0) {
+                steps = iterations;
+
+                if (mode == DensityBuffer::Nebulabrot) {
+                    channelMask = 0;
+
+                    for (int channel = 0; channel < DensityBuffer::CHANNELS; channel++) {
+                        channelMask |= iterations < limits[channel] ? 1 << channel : 0;
+                    }
+                }
+            }
+
+            iterationsDone += iterations >= 0 ? iterations : maxIterations;
+
+            //Replay the orbit from z = c, the same start as mandelbrot(), together with its mirror image
+            double c_real = reals[i];
+            double c_imag = imags[i];
+            double z_real = c_real;
+            double z_imag = c_imag;
+            int hits = 0;
+
+            for (int step = 0; step < steps; step++) {
+                double x = (z_real - left) * scaleX;
+
+                if (x >= 0.0 && x < width) {
+                    double y = (z_imag - top) * scaleY;
+                    double mirrorY = (-z_imag - top) * scaleY;
+
+                    for (int channel = 0; channel < DensityBuffer::CHANNELS; channel++) {
+                        if ((channelMask & (1 << channel)) == 0) {
+                            continue;
+                        }
+
+                        if (y >= 0.0 && y < height) {
+                            density->add(channel, (std::size_t) y * width + (std::size_t) x, weights[i]);
+                            hits++;
+                        }
+
+                        if (mirrorY >= 0.0 && mirrorY < height) {
+                            density->add(channel, (std::size_t) mirrorY * width + (std::size_t) x, weights[i]);
+                            hits++;
+                        }
+                    }
+                }
+
+                double z_real_imag = z_real * z_imag;
+                z_real = z_real * z_real - z_imag * z_imag + c_real;
+                z_imag = z_real_imag + z_real_imag + c_imag;
+            }
+
+            statistics.hits[cells[i]] += hits;
+            statistics.samples[cells[i]] += 1.0;
+            batchWork += (iterations >= 0 ? iterations : maxIterations) + steps;
+        }
+
+        this->m_progress.add(ORBIT_BATCH, batchWork);
+        orbits += ORBIT_BATCH;
+    }
+
+    std::unique_lock<std::mutex> lock(this->m_lineMutex);
+
+    pass.orbits += orbits;
+    pass.iterations += iterationsDone;
+
+    for (int cell = 0; cell < OrbitSampler::CELLS; cell++) {
+        pass.statistics.hits[cell] += statistics.hits[cell];
+        pass.statistics.samples[cell] += statistics.samples[cell];
+    }
+}
+
+void BackgroundWorker::density(QImage* image, DensityBuffer* density, const RenderParams& params, DensityBuffer::Mode mode)
+{
+    assert(m_state == STOPPED);
+    m_state = RUNNING;
+
+    int threads = prepareThreads(params);
+
+    emit taskStart();
+
+    m_monitorThread = new std::thread([this, image, density, params, mode, threads]() {
+        Trace::nameThread("render monitor");
+        Trace::Span jobSpan("density job");
+
+        std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+
+        long long target = (long long) image->width() * image->height() * ORBITS_PER_PIXEL;
+
+        m_stats = RenderStats();
+        m_stats.threads = threads;
+        m_stats.maxIterations = params.maxIterations();
+
+        density->reset(image->width(), image->height());
+        m_progress.start(target);
+
+        //The first pass draws uniformly; every pass after that learns where the visible orbits come from
+        OrbitSampler sampler;
+        DensityPass pass;
+        pass.number = 0;
+        int passTime = DENSITY_FIRST_PASS_MS;
+
+        while (true) {
+            pass.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(passTime);
+            pass.orbits = 0;
+            pass.iterations = 0;
+            pass.statistics = OrbitSampler::Statistics();
+
+            runWorkers(threads, params.niceness(), [this, density, &params, mode, &sampler, &pass](int i) {
+                this->densityTask(density, params, mode, sampler, pass, i);
+            });
+
+            m_stats.samples += pass.orbits;
+            m_stats.iterations += pass.iterations;
+
+            if (m_state != CANCELED) {
+                Trace::Span lockSpan("wait thread locks");
+                std::vector<std::unique_lock<std::mutex>> locks;
+
+                for (int i = 0; i < threads; i++) {
+                    locks.emplace_back(m_threadMutexes[i]);
+                }
+
+                lockSpan.end();
+
+                Trace::Span span("tone map");
+                density->resolve(mode, params.colorScheme(), *image);
+            }
+
+            m_activeThreads = 0;
+
+            if (m_state == CANCELED) {
+                break;
+            }
+
+            m_stats.densityPasses++;
+            sampler.update(pass.statistics);
+
+            emit refinePassComplete();
+
+            if (m_stats.samples >= target) {
+                break;
+            }
+
+            pass.number++;
+            passTime = std::min(passTime * 2, DENSITY_MAX_PASS_MS);
+        }
+
+        std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - begin_time;
+        m_stats.milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+
+        std::cout << m_stats.summary() << std::endl;
+
+        emit workerDone();
+    });
+}
+
+void BackgroundWorker::raymarchTask(QImage* image, Raymarcher& marcher, RaymarchPass& pass, int threadIndex)
+{
+    Raymarcher::Statistics statistics;
+
+    Trace::nameThread("raymarch");
+
+    while (true) {
+        int item;
+
+        {
+            Trace::Span lockSpan("wait line lock");
+            std::unique_lock<std::mutex> lock(this->m_lineMutex);
+            lockSpan.end();
+
+            pass.rays += statistics.rays;
+            pass.steps += statistics.steps;
+            statistics = Raymarcher::Statistics();
+
+            if (pass.next >= (pass.depth ? marcher.blockRows() : marcher.tileCount()) || this->m_state == CANCELED) {
+                return;
+            }
+
+            item = pass.next++;
+        }
+
+        if (pass.depth) {
+            Trace::Span span("depth row");
+            marcher.coneRow(item, statistics);
+            continue;
+        }
+
+        Trace::Span span("tile");
+        std::unique_lock<std::mutex> lock(this->m_threadMutexes[threadIndex]);
+        marcher.renderTile(item, *image, statistics);
+        lock.unlock();
+
+        this->m_progress.add(statistics.rays, statistics.steps);
+    }
+}
+
+void BackgroundWorker::raymarch(QImage* image, const Raymarcher::Scene& scene, const Camera& camera, const RenderParams& params)
+{
+    assert(m_state == STOPPED);
+    m_state = RUNNING;
+
+    int threads = prepareThreads(params);
+
+    emit taskStart();
+
+    m_monitorThread = new std::thread([this, image, scene, camera, params, threads]() {
+        Trace::nameThread("render monitor");
+        Trace::Span jobSpan("raymarch job");
+
+        std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+
+        m_stats = RenderStats();
+        m_stats.threads = threads;
+        m_stats.maxIterations = scene.iterations;
+
+        Raymarcher marcher(scene, camera, params.colorScheme(), image->width(), image->height(), !params.interactive());
+        m_progress.start((long long) image->width() * image->height());
+
+        RaymarchPass pass;
+        pass.rays = 0;
+        pass.steps = 0;
+
+        //Every tile starts its rays from the depths of the blocks around it, so the depth pass has to finish first
+        for (bool depth : { true, false }) {
+            pass.depth = depth;
+            pass.next = 0;
+
+            runWorkers(threads, params.niceness(), [this, image, &marcher, &pass](int i) {
+                this->raymarchTask(image, marcher, pass, i);
+            });
+
+            if (m_state == CANCELED) {
+                break;
+            }
+        }
+
+        m_activeThreads = 0;
+
+        //Rays are the samples and distance estimates the iterations, so sketch budgets work the same as for escape times
+        m_stats.samples = pass.rays;
+        m_stats.iterations = pass.steps;
+
+        std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - begin_time;
+        m_stats.milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
 
-        m_workerThreads.clear();
+        std::cout << m_stats.summary() << std::endl;
 
         emit workerDone();
     });
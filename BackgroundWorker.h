@@ -2,14 +2,30 @@
 #define BackgroundWorker_H
 
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <deque>
+#include <condition_variable>
 
 #include <QObject>
 
+#include "RenderStats.h"
+#include "RenderProgress.h"
+#include "DensityBuffer.h"
+#include "OrbitSampler.h"
+#include "Raymarcher.h"
+
 class MainWindow;
 class RenderParams;
 class QImage;
+class SampleBuffer;
+class ColorTable;
+class Downsampler;
+class Accumulator;
 
 class BackgroundWorker : public QObject
 {
@@ -24,20 +40,122 @@ class BackgroundWorker : public QObject
         };
 
     private:
+        /*
+         * Every pixel row goes through the stages in order; queues between
+         * them are bounded, and threads take work from the latest stage that
+         * has any so that stages of different rows overlap.
+         */
+        enum Stage
+        {
+            Idle,
+            Compute,
+            Colorize,
+            Downsample
+        };
+
+        //Colorized samples of one pixel row, one plane per color
+        struct ColorTile
+        {
+            int y;
+            std::vector<unsigned char> red;
+            std::vector<unsigned char> green;
+            std::vector<unsigned char> blue;
+        };
+
+        struct Pass
+        {
+            int maxIterations;
+            bool resume;
+
+            //The samples are final: rows skip the compute stage and are only colored
+            bool colorOnly;
+            long long escaped;
+            long long samples;
+            long long iterations;
+            long long interiorSamples;
+
+            //Rows handled in this phase; mirrored rows are copied from their reflection instead of computed
+            const std::vector<int>* rows;
+            bool mirror;
+            int mirrorSum;
+
+            //Indices into rows are partitioned between NUMA nodes; a node's threads steal from others once their own run out
+            std::vector<int> nextLine;
+            std::vector<int> endLine;
+            std::vector<int> nodeRows;
+            int remoteRows;
+
+            const ColorTable* colorTable;
+            const Downsampler* downsampler;
+            int queueCapacity;
+            int computing;
+            int busy;
+
+            //Per node: rows wait to be colored and written by a thread of the node whose band holds them, which keeps image rows first touched on that node
+            std::vector<std::deque<int>> computed;
+            std::vector<std::deque<ColorTile*>> colorized;
+            int queued;
+            std::vector<ColorTile*> freeTiles;
+        };
+
+        struct RefinePass
+        {
+            bool seed;
+            int nextLine;
+            int active;
+            long long samples;
+            long long iterations;
+        };
+
+        struct DensityPass
+        {
+            int number;
+            std::chrono::steady_clock::time_point deadline;
+            long long orbits;
+            long long iterations;
+            OrbitSampler::Statistics statistics;
+        };
+
+        struct RaymarchPass
+        {
+            //The coarse depth pass hands out block rows, the image pass tiles
+            bool depth;
+            int next;
+            long long rays;
+            long long steps;
+        };
+
         std::thread* m_monitorThread;
-        std::vector<std::thread> m_workerThreads;
-        std::vector<std::mutex> m_threadMutexes;
+
+        //Workers of the running pass, each one a tile of an interactive job on the shared pool
+        std::atomic<int> m_activeThreads;
+        std::unique_ptr<std::mutex[]> m_threadMutexes;
+        int m_threadMutexCount;
         State m_state;
         std::mutex m_lineMutex;
+        std::condition_variable m_stageCondition;
         std::mutex m_stateMutex;
         std::mutex m_startLock;
+        bool m_numaAware;
+        RenderStats m_stats;
+        RenderProgress m_progress;
+        std::vector<std::unique_ptr<ColorTile>> m_colorTiles;
 
-        void task(QImage* image, const RenderParams& params, int& currentLine, int threadIndex);
+        void task(QImage* image, SampleBuffer* samples, const RenderParams& params, Pass& pass, int threadIndex, int node);
+        void refineTask(QImage* image, const SampleBuffer* samples, Accumulator* accumulator, const RenderParams& params,
+                        const ColorTable& colorTable, RefinePass& pass, int threadIndex);
+        void densityTask(DensityBuffer* density, const RenderParams& params, DensityBuffer::Mode mode,
+                         const OrbitSampler& sampler, DensityPass& pass, int threadIndex);
+        void raymarchTask(QImage* image, Raymarcher& marcher, RaymarchPass& pass, int threadIndex);
+        int prepareThreads(const RenderParams& params);
+        void runWorkers(int threads, int niceness, const std::function<void(int)>& worker);
+        void start(QImage* image, SampleBuffer* samples, const RenderParams& params, bool resume, bool colorOnly = false);
 
     signals:
         void taskStart();
         void taskComplete(bool);
-        void progressUpdate(int);
+        void iterationLimitChanged(int);
+        void refinePassComplete();
         void workerDone();
 
     private slots:
@@ -47,10 +165,45 @@ class BackgroundWorker : public QObject
         BackgroundWorker(QWidget* parent);
         virtual ~BackgroundWorker();
 
-        void run(QImage* image, const RenderParams& params);
+        void run(QImage* image, SampleBuffer* samples, const RenderParams& params);
+        void resume(QImage* image, SampleBuffer* samples, const RenderParams& params);
+
+        //Colors finished samples again without iterating; they must have the channels the coloring needs
+        void recolor(QImage* image, SampleBuffer* samples, const RenderParams& params);
+
+        /*
+         * Progressive supersampling of a finished render: starting from its
+         * samples, keeps adding jittered samples to the pixels that have not
+         * converged yet, showing the image after every pass.
+         */
+        void refine(QImage* image, const SampleBuffer* samples, Accumulator* accumulator, const RenderParams& params);
+
+        /*
+         * Orbit density render of the view: keeps following the orbits of
+         * random points and adding them to the histogram, showing the image
+         * after every pass, until enough orbits were drawn.
+         */
+        void density(QImage* image, DensityBuffer* density, const RenderParams& params, DensityBuffer::Mode mode);
+
+        /*
+         * Raymarched render of a 3D fractal seen from camera, in tiles once
+         * a coarse depth pass is done. Only the colors and worker limits of
+         * params are used; interactive sketches leave out the soft shadows.
+         */
+        void raymarch(QImage* image, const Raymarcher::Scene& scene, const Camera& camera, const RenderParams& params);
         void cancel();
         std::mutex& threadMutex(int threadNum);
-        int threadCount() const { return m_workerThreads.size(); }
+        int threadCount() const { return m_activeThreads; }
+
+        //Pin workers to CPUs and give each NUMA node its own share of the rows
+        void setNumaAware(bool numaAware) { m_numaAware = numaAware; }
+        bool numaAware() const { return m_numaAware; }
+
+        //Progress of the running job; meant to be polled
+        const RenderProgress& progress() const { return m_progress; }
+
+        //Valid from taskComplete until the next job starts
+        const RenderStats& stats() const { return m_stats; }
 };
 
 #endif
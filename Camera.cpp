@@ -0,0 +1,68 @@
+#include "Camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const double DEFAULT_FIELD_OF_VIEW = 0.8;
+
+    //Closest the pitch gets to straight up or down
+    const double MAX_PITCH = 1.5;
+
+    const double FULL_TURN = 6.283185307179586;
+}
+
+Camera::Camera(double distance, double yaw, double pitch) :
+    m_position(),
+    m_yaw(yaw),
+    m_pitch(std::max(std::min(pitch, MAX_PITCH), -MAX_PITCH)),
+    m_fieldOfView(DEFAULT_FIELD_OF_VIEW)
+{
+    m_position = forward() * -distance;
+}
+
+Camera::Camera(const Vector3& position, double yaw, double pitch, double fieldOfView) :
+    m_position(position),
+    m_yaw(yaw),
+    m_pitch(std::max(std::min(pitch, MAX_PITCH), -MAX_PITCH)),
+    m_fieldOfView(fieldOfView)
+{ }
+
+Vector3 Camera::forward() const
+{
+    return Vector3(std::sin(m_yaw) * std::cos(m_pitch), std::sin(m_pitch), std::cos(m_yaw) * std::cos(m_pitch));
+}
+
+Vector3 Camera::right() const
+{
+    return Vector3(std::cos(m_yaw), 0.0, -std::sin(m_yaw));
+}
+
+Vector3 Camera::up() const
+{
+    return forward().cross(right());
+}
+
+void Camera::turn(double yaw, double pitch)
+{
+    m_yaw = std::remainder(m_yaw + yaw, FULL_TURN);
+    m_pitch = std::max(std::min(m_pitch + pitch, MAX_PITCH), -MAX_PITCH);
+}
+
+void Camera::move(double distance)
+{
+    m_position = m_position + forward() * distance;
+}
+
+double Camera::pixelSize(int height) const
+{
+    return 2.0 * std::tan(m_fieldOfView * 0.5) / (double) height;
+}
+
+Vector3 Camera::direction(double x, double y, int width, int height) const
+{
+    double size = pixelSize(height);
+
+    return (forward() + right() * ((x - width * 0.5) * size) - up() * ((y - height * 0.5) * size)).normalized();
+}
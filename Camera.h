@@ -0,0 +1,48 @@
+#ifndef Camera_H
+#define Camera_H
+
+#include "Vector3.h"
+
+/*
+ * Where a raymarched view is seen from, taking the place of ZoomRegion in
+ * the 3D render modes: a position, a heading as yaw about the vertical y
+ * axis and pitch above the horizon, and a vertical field of view. Yaw 0 and
+ * pitch 0 look along +z. Image rows run downwards, so the top row of an
+ * image looks furthest up.
+ */
+class Camera
+{
+    private:
+        Vector3 m_position;
+        double m_yaw;
+        double m_pitch;
+        double m_fieldOfView;
+
+    public:
+        //Looking at the origin from distance away; with the default heading from the -z side
+        explicit Camera(double distance = 3.0, double yaw = 0.0, double pitch = 0.0);
+        Camera(const Vector3& position, double yaw, double pitch, double fieldOfView);
+
+        const Vector3& position() const     { return m_position; }
+        double yaw() const                  { return m_yaw; }
+        double pitch() const                { return m_pitch; }
+        double fieldOfView() const          { return m_fieldOfView; }
+
+        Vector3 forward() const;
+        Vector3 right() const;
+        Vector3 up() const;
+
+        //Radians; pitch stops short of straight up or down, where the heading would be lost
+        void turn(double yaw, double pitch);
+
+        //Along the view direction, backwards for negative distances
+        void move(double distance);
+
+        //Width of a pixel of a height pixels tall image, per unit of distance from the camera
+        double pixelSize(int height) const;
+
+        //Unit direction through image point (x, y), in pixels from the top left corner of a width x height image
+        Vector3 direction(double x, double y, int width, int height) const;
+};
+
+#endif
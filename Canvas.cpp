@@ -9,20 +9,40 @@
 #include <QTimer>
 #include <QImage>
 #include <QPixmap>
+#include <QPainter>
 #include <QApplication>
 
 #include <cassert>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 #include "ZoomRegion.h"
 #include "BackgroundWorker.h"
 #include "RenderParams.h"
 #include "ColorScheme.h"
+#include "RenderFile.h"
+#include "Trace.h"
+#include "JuliaPreview.h"
 
 namespace {
     const int RESIZE_DELAY = 250;
     const int REFRESH_DELAY = 100;
+    const std::size_t DEFAULT_HISTORY_MEMORY = 256 * 1024 * 1024;
+
+    //Relative difference in pixel pitch below which two grids are taken to be the same
+    const double PITCH_TOLERANCE = 1e-9;
+
+    //Raymarched views: share of the distance to the fractal the camera moves per wheel step
+    const double CAMERA_STEP = 0.25;
+
+    //Closest the camera gets to the fractal, relative to its size; single precision rays cannot resolve much less
+    const double MIN_CLEARANCE = 1e-5;
+
+    const int JULIA_INSET_WIDTH = 240;
+    const int JULIA_INSET_HEIGHT = 180;
+    const int JULIA_INSET_MARGIN = 8;
 }
 
 Canvas::Canvas ( QWidget* parent ) :
@@ -30,10 +50,42 @@ Canvas::Canvas ( QWidget* parent ) :
     m_resizeTimer(nullptr),
     m_refreshTimer(nullptr),
     m_region(-2.0, -1.0, 1.0, 1.0),
+    m_formula(),
     m_colors(ColorScheme::Rainbow),
+    m_coloring(ColorScheme::IterationCount),
+    m_filter(Downsampler::Box),
     m_antialiasing(1),
+    m_maxIterations(256),
+    m_currentIterations(256),
+    m_autoIterations(true),
+    m_threadCount(0),
+    m_niceness(0),
     m_worker(nullptr),
-    m_image()
+    m_frames(),
+    m_frame(nullptr),
+    m_frameRegion(-2.0, -1.0, 1.0, 1.0),
+    m_accumulator(),
+    m_sketching(false),
+    m_samplesValid(false),
+    m_progressive(true),
+    m_refining(false),
+    m_recoloring(false),
+    m_documentFrame(false),
+    m_history(DEFAULT_HISTORY_MEMORY),
+    m_recordView(false),
+    m_frameBudget(),
+    m_orbitDensity(false),
+    m_densityMode(DensityBuffer::Buddhabrot),
+    m_density(),
+    m_densityValid(false),
+    m_raymarching(false),
+    m_scene(),
+    m_camera(Raymarcher::Scene().overview()),
+    m_raymarchBudget(),
+    m_juliaInset(false),
+    m_juliaPreview(nullptr),
+    m_juliaLabel(nullptr),
+    m_focusY(0.5)
 {
     this->setScaledContents(true);
     this->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
@@ -51,9 +103,19 @@ Canvas::Canvas ( QWidget* parent ) :
     m_refreshTimer = new QTimer(this);
     m_refreshTimer->setInterval(REFRESH_DELAY);
 
+    m_juliaPreview = new JuliaPreview(JULIA_INSET_WIDTH, JULIA_INSET_HEIGHT, this);
+
+    m_juliaLabel = new QLabel(this);
+    m_juliaLabel->setFixedSize(JULIA_INSET_WIDTH, JULIA_INSET_HEIGHT);
+    m_juliaLabel->setAttribute(Qt::WA_TransparentForMouseEvents);
+    m_juliaLabel->hide();
+
     connect(m_resizeTimer, SIGNAL(timeout()), this, SLOT(resizeTimerExpired()));
     //connect(m_refreshTimer, SIGNAL(timeout()), this, SLOT(refreshPreview()));
     connect(m_worker, SIGNAL(taskComplete(bool)), this, SLOT(renderComplete(bool)));
+    connect(m_worker, SIGNAL(iterationLimitChanged(int)), this, SLOT(iterationLimitChanged(int)));
+    connect(m_worker, SIGNAL(refinePassComplete()), this, SLOT(refreshPreview()));
+    connect(m_juliaPreview, SIGNAL(frameReady()), this, SLOT(juliaFrameReady()));
 
     render();
 }
@@ -63,16 +125,45 @@ Canvas::~Canvas() {
 }
 
 void Canvas::resizeEvent ( QResizeEvent* event ) {
+    //Once on screen the view keeps its scale and top left corner, so a larger canvas shows more of the plane instead of stretching it
+    QSize oldSize = event->oldSize();
+
+    if (this->isVisible() && !m_documentFrame && oldSize.width() > 1 && oldSize.height() > 1 && this->width() > 1 && this->height() > 1) {
+        double pitch_x = m_region.width() / (double) (oldSize.width() - 1);
+        double pitch_y = m_region.height() / (double) (oldSize.height() - 1);
+        double x1 = m_region.location().x();
+        double y1 = m_region.location().y();
+
+        m_region = ZoomRegion(x1, y1, x1 + pitch_x * (double) (this->width() - 1), y1 + pitch_y * (double) (this->height() - 1));
+    }
+
+    m_focusY = 0.5;
+
+    m_juliaLabel->move(this->width() - JULIA_INSET_WIDTH - JULIA_INSET_MARGIN, this->height() - JULIA_INSET_HEIGHT - JULIA_INSET_MARGIN);
+
     m_resizeTimer->stop();
     m_resizeTimer->start();
     QWidget::resizeEvent ( event );
 }
 
 void Canvas::resizeComplete() {
-    render();
+    //An opened document keeps its own size; the label scales it to fit
+    if (!m_documentFrame && !extendRender()) {
+        render();
+    }
+}
+
+void Canvas::setFocusPoint ( const QPoint& pos ) {
+    m_focusY = (double) pos.y() / (double) this->height();
 }
 
 void Canvas::mouseDoubleClickEvent ( QMouseEvent* event ) {
+    if (m_raymarching) {
+        return;
+    }
+
+    setFocusPoint(event->pos());
+
     const double zoom = 1.0 / 4.0;
 
     double width = (double) m_region.width() * zoom;
@@ -85,7 +176,15 @@ void Canvas::mouseDoubleClickEvent ( QMouseEvent* event ) {
 }
 
 void Canvas::wheelEvent ( QWheelEvent* event ) {
-    if (event->orientation() == Qt::Orientation::Vertical) {
+    if (event->orientation() == Qt::Orientation::Vertical && m_raymarching) {
+        //Steps shrink as the camera closes in, so it never passes into the surface
+        m_camera.move((event->delta() > 0 ? CAMERA_STEP : -CAMERA_STEP) * cameraClearance());
+
+        renderSketch();
+        m_resizeTimer->start();
+    } else if (event->orientation() == Qt::Orientation::Vertical) {
+        setFocusPoint(event->pos());
+
         double zoom = event->delta() > 0 ? 1.0 / 1.25 : 1.25;
 
         double width = (double) m_region.width() * zoom;
@@ -106,6 +205,8 @@ void Canvas::wheelEvent ( QWheelEvent* event ) {
 }
 
 void Canvas::mousePressEvent ( QMouseEvent* event ) {
+    setFocusPoint(event->pos());
+
     if (event->button() == Qt::LeftButton) {
         m_panning = true;
         m_zooming = false;
@@ -120,6 +221,10 @@ void Canvas::mousePressEvent ( QMouseEvent* event ) {
         m_zoomPivot = Point(zoomPivot_x, zoomPivot_y);
 
         QApplication::setOverrideCursor(Qt::BlankCursor);
+    } else if (event->button() == Qt::XButton1) {
+        back();
+    } else if (event->button() == Qt::XButton2) {
+        forward();
     }
 }
 
@@ -136,11 +241,39 @@ void Canvas::mouseReleaseEvent ( QMouseEvent* event ) {
 }
 
 void Canvas::mouseMoveEvent ( QMouseEvent* event ) {
+    if (m_juliaLabel->isVisible()) {
+        double c_real = (double) event->pos().x() / (double) this->width() * m_region.width() + m_region.location().x();
+        double c_imag = (double) event->pos().y() / (double) this->height() * m_region.height() + m_region.location().y();
+        m_juliaPreview->show(c_real, c_imag);
+    }
+
+    if (m_raymarching && (m_panning || m_zooming)) {
+        int mouseDelta_x = event->pos().x() - m_dragLast.x();
+        int mouseDelta_y = event->pos().y() - m_dragLast.y();
+
+        if (m_panning) {
+            //The view follows the mouse, as when panning the plane
+            double angle = m_camera.fieldOfView() / (double) this->height();
+
+            m_dragLast = event->pos();
+            m_camera.turn(-mouseDelta_x * angle, mouseDelta_y * angle);
+        } else {
+            QCursor::setPos(this->mapToGlobal(m_dragLast));
+
+            double zoom = std::exp((double) mouseDelta_y / (double) this->height() * 5.0);
+            m_camera.move((1.0 - zoom) * cameraClearance());
+        }
+
+        renderSketch();
+        return;
+    }
+
     if (m_panning) {
         int mouseDelta_x = event->pos().x() - m_dragLast.x();
         int mouseDelta_y = event->pos().y() - m_dragLast.y();
 
         m_dragLast = event->pos();
+        setFocusPoint(event->pos());
 
         double delta_x = -(double) mouseDelta_x / (double) this->width() * m_region.width();
         double delta_y = -(double) mouseDelta_y / (double) this->height() * m_region.height();
@@ -174,54 +307,442 @@ void Canvas::resizeTimerExpired() {
     resizeComplete();
 }
 
+bool Canvas::acquireFrame(int width, int height, QImage::Format format, const FrameRing::Frame* keep)
+{
+    //The history may still be compressing the samples of any frame, including the one handed out
+    m_history.finishRecording();
+
+    FrameRing::Frame* frame = m_frames.acquire(width, height, format, keep);
+
+    if (frame == nullptr) {
+        std::cerr << "Not enough memory for a " << width << "x" << height << " frame" << std::endl;
+        return false;
+    }
+
+    m_frame = frame;
+    return true;
+}
+
 void Canvas::render()
 {
-    RenderParams params(m_region, m_colors, m_antialiasing);
+    if (m_raymarching) {
+        renderRaymarch(false);
+        return;
+    }
+
+    if (m_orbitDensity) {
+        renderDensity();
+        return;
+    }
+
+    //Full renders keep the iteration state so the limit can be raised later without starting over
+    RenderParams params(m_region, m_colors, m_antialiasing, m_coloring, SampleBuffer::State);
+    params.setFormula(m_formula);
+    params.setMaxIterations(m_maxIterations);
+    params.setAutoIterations(m_autoIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
+    params.setFilter(m_filter);
+    params.setFocusY(m_focusY);
 
     m_worker->cancel();
 
-    m_image = this->pixmap()->scaled(this->width(), this->height(), Qt::IgnoreAspectRatio, Qt::FastTransformation).toImage();
-    m_worker->run(&m_image, params);
+    if (!acquireFrame(this->width(), this->height(), QImage::Format_RGB32)) {
+        return;
+    }
+
+    m_sketching = false;
+    m_samplesValid = false;
+    m_documentFrame = false;
+    m_recordView = true;
+    m_currentIterations = m_maxIterations;
+
+    m_frameRegion = m_region;
+
+    //Left as it is when NUMA aware, so freshly allocated rows are first touched by a render thread on the node that owns them
+    if (!m_worker->numaAware()) {
+        QPainter painter(&m_frame->image);
+        painter.drawPixmap(m_frame->image.rect(), *this->pixmap());
+    }
+
+    m_worker->run(&m_frame->image, &m_frame->samples, params);
 
     m_refreshTimer->start();
 
     emit rendering();
 }
 
+void Canvas::resumeRender()
+{
+    //Same view with a higher limit: only the samples that have not escaped yet are iterated further
+    RenderParams params(m_region, m_colors, m_antialiasing, m_coloring, SampleBuffer::State);
+    params.setFormula(m_formula);
+    params.setMaxIterations(std::max(m_maxIterations, m_currentIterations));
+    params.setAutoIterations(m_autoIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
+    params.setFilter(m_filter);
+    params.setFocusY(m_focusY);
+
+    m_worker->cancel();
+
+    //Iterating on writes the samples the history may still be compressing
+    m_history.finishRecording();
+
+    m_samplesValid = false;
+    m_recordView = true;
+    m_currentIterations = params.maxIterations();
+
+    m_worker->resume(&m_frame->image, &m_frame->samples, params);
+    m_refreshTimer->start();
+
+    emit rendering();
+}
+
+bool Canvas::extendRender()
+{
+    //Only finished samples with their iteration state can be carried over to the new size
+    if (m_orbitDensity || m_sketching || !m_samplesValid || m_frame == nullptr || !m_frame->samples.hasChannels(SampleBuffer::State)) {
+        return false;
+    }
+
+    int width = this->width();
+    int height = this->height();
+    int frameWidth = m_frame->image.width();
+    int frameHeight = m_frame->image.height();
+
+    if (width < 2 || height < 2 || frameWidth < 2 || frameHeight < 2) {
+        return false;
+    }
+
+    //The new canvas has to continue the frame's pixel grid: same corner, same pitch
+    double pitch_x = m_region.width() / (double) (width - 1);
+    double pitch_y = m_region.height() / (double) (height - 1);
+    double framePitch_x = m_frameRegion.width() / (double) (frameWidth - 1);
+    double framePitch_y = m_frameRegion.height() / (double) (frameHeight - 1);
+
+    if (m_region.location().x() != m_frameRegion.location().x() || m_region.location().y() != m_frameRegion.location().y() ||
+        std::abs(pitch_x - framePitch_x) > PITCH_TOLERANCE * std::abs(framePitch_x) ||
+        std::abs(pitch_y - framePitch_y) > PITCH_TOLERANCE * std::abs(framePitch_y)) {
+        return false;
+    }
+
+    m_worker->cancel();
+
+    FrameRing::Frame* previous = m_frame;
+    int antialiasing = previous->samples.width() / frameWidth;
+
+    //Overlapping samples are kept and the uncovered margins are left to compute; a smaller canvas only crops
+    if (!acquireFrame(width, height, QImage::Format_RGB32, previous)) {
+        return false;
+    }
+
+    //Without room for the samples the frame cannot continue the old one, so the caller renders it from scratch
+    if (!m_frame->samples.resizeFrom(previous->samples, width * antialiasing, height * antialiasing)) {
+        m_samplesValid = false;
+        return false;
+    }
+
+    m_frameRegion = m_region;
+
+    if (!m_worker->numaAware()) {
+        m_frame->image.fill(qRgb(0, 0, 0));
+
+        QPainter painter(&m_frame->image);
+        painter.drawImage(0, 0, previous->image);
+    }
+
+    //The limit found for the rest of the view is kept; new samples escaping below it say nothing about raising it
+    RenderParams params(m_region, m_colors, m_antialiasing, m_coloring, SampleBuffer::State);
+    params.setFormula(m_formula);
+    params.setMaxIterations(m_currentIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
+    params.setFilter(m_filter);
+    params.setFocusY(m_focusY);
+
+    m_sketching = false;
+    m_samplesValid = false;
+    m_documentFrame = false;
+    m_recordView = true;
+
+    m_worker->resume(&m_frame->image, &m_frame->samples, params);
+    m_refreshTimer->start();
+
+    emit rendering();
+    return true;
+}
+
+void Canvas::recolor()
+{
+    //Raymarched images keep nothing to color again
+    if (m_raymarching) {
+        render();
+        return;
+    }
+
+    //A finished histogram is only tone mapped again
+    if (m_orbitDensity) {
+        if (!m_densityValid || m_density.width() != m_frame->image.width() || m_density.height() != m_frame->image.height()) {
+            render();
+            return;
+        }
+
+        m_density.resolve(m_densityMode, m_colors, m_frame->image);
+        refreshPreview();
+        return;
+    }
+
+    //Finished samples that hold what the coloring needs only get new colors
+    if (!m_samplesValid || !m_frame->samples.hasChannels(ColorScheme::channels(m_coloring))) {
+        render();
+        return;
+    }
+
+    RenderParams params(m_region, m_colors, m_antialiasing, m_coloring);
+    params.setFormula(m_formula);
+    params.setMaxIterations(m_currentIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
+    params.setFilter(m_filter);
+    params.setFocusY(m_focusY);
+
+    m_worker->cancel();
+
+    m_recoloring = true;
+
+    m_worker->recolor(&m_frame->image, &m_frame->samples, params);
+    m_refreshTimer->start();
+
+    emit rendering();
+}
+
+void Canvas::showView(const ViewHistory::Entry* entry)
+{
+    //The history holds views of the plane only
+    if (entry == nullptr || m_raymarching) {
+        return;
+    }
+
+    m_worker->cancel();
+
+    m_region = entry->region();
+    m_formula = entry->formula();
+    m_frameRegion = m_region;
+    m_focusY = 0.5;
+
+    if (m_orbitDensity || !entry->hasSamples() || (entry->channels() & ColorScheme::channels(m_coloring)) != ColorScheme::channels(m_coloring)) {
+        render();
+        return;
+    }
+
+    if (!acquireFrame(entry->width(), entry->height(), QImage::Format_RGB32) || !entry->restore(m_frame->samples)) {
+        m_samplesValid = false;
+        render();
+        return;
+    }
+
+    m_sketching = false;
+    m_samplesValid = true;
+    m_recordView = false;
+    m_documentFrame = entry->width() != this->width() || entry->height() != this->height();
+    m_currentIterations = entry->maxIterations();
+
+    recolor();
+}
+
+void Canvas::back()
+{
+    showView(m_history.back(m_region, m_formula));
+}
+
+void Canvas::forward()
+{
+    showView(m_history.forward(m_region, m_formula));
+}
+
 void Canvas::renderSketch()
 {
-    RenderParams params(m_region, m_colors, 1);
+    if (m_raymarching) {
+        renderRaymarch(true);
+        return;
+    }
+
+    //Density renders show their first pass quickly enough to double as the sketch
+    if (m_orbitDensity) {
+        renderDensity();
+        return;
+    }
+
+    m_worker->cancel();
+
+    int sketchWidth;
+    int sketchHeight;
+    int sketchIterations;
+    m_frameBudget.choose(this->width(), this->height(), m_maxIterations, sketchWidth, sketchHeight, sketchIterations);
+
+    RenderParams params(m_region, m_colors, 1, m_coloring);
+    params.setFormula(m_formula);
+    params.setMaxIterations(sketchIterations);
+    params.setThreadCount(m_threadCount);
+    params.setInteractive(true);
+    params.setFocusY(m_focusY);
+
+    if (!acquireFrame(sketchWidth, sketchHeight, QImage::Format_ARGB32)) {
+        return;
+    }
+
+    m_sketching = true;
+    m_samplesValid = false;
+    m_documentFrame = false;
+
+    m_worker->run(&m_frame->image, &m_frame->samples, params);
+}
+
+void Canvas::renderDensity()
+{
+    RenderParams params(m_region, m_colors, 1, m_coloring);
+    params.setMaxIterations(m_maxIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
 
     m_worker->cancel();
 
-    m_image = QImage(this->width() / 4, this->height() / 4, QImage::Format_ARGB32);
-    m_worker->run(&m_image, params);
+    if (!acquireFrame(this->width(), this->height(), QImage::Format_RGB32)) {
+        return;
+    }
+
+    m_sketching = false;
+    m_samplesValid = false;
+    m_densityValid = false;
+    m_documentFrame = false;
+    m_recordView = false;
+    m_currentIterations = m_maxIterations;
+
+    m_worker->density(&m_frame->image, &m_density, params, m_densityMode);
+
+    emit rendering();
 }
 
+void Canvas::renderRaymarch(bool sketch)
+{
+    RenderParams params(m_region, m_colors, 1, m_coloring);
+    params.setThreadCount(m_threadCount);
+    params.setInteractive(sketch);
+
+    if (!sketch) {
+        params.setNiceness(m_niceness);
+    }
+
+    m_worker->cancel();
+
+    int width = this->width();
+    int height = this->height();
+
+    //There is no iteration limit to trade for frame rate, only resolution
+    if (sketch) {
+        int iterations;
+        m_raymarchBudget.choose(this->width(), this->height(), std::numeric_limits<int>::max(), width, height, iterations);
+    }
+
+    if (!acquireFrame(width, height, sketch ? QImage::Format_ARGB32 : QImage::Format_RGB32)) {
+        return;
+    }
+
+    m_sketching = sketch;
+    m_samplesValid = false;
+    m_documentFrame = false;
+    m_recordView = false;
+
+    m_worker->raymarch(&m_frame->image, m_scene, m_camera, params);
+
+    if (!sketch) {
+        m_refreshTimer->start();
+
+        emit rendering();
+    }
+}
+
+double Canvas::cameraClearance()
+{
+    return std::max(Raymarcher::distance(m_scene, m_camera.position()), MIN_CLEARANCE * m_scene.boundingRadius());
+}
 
 void Canvas::renderComplete(bool canceled)
 {
     m_refreshTimer->stop();
 
+    //Refinement and recoloring leave the samples alone, whether they finished or not
+    bool refined = m_refining;
+    bool recolored = m_recoloring;
+    m_refining = false;
+    m_recoloring = false;
+
+    if (!refined && !recolored) {
+        m_samplesValid = !canceled && !m_sketching && !m_orbitDensity && !m_raymarching;
+    }
+
+    //Canceled density renders keep what they have drawn so far
+    m_densityValid = m_orbitDensity;
+
+    if (m_samplesValid && m_recordView) {
+        m_history.record(m_region, m_formula, m_frame->image.width(), m_frame->image.height(), m_currentIterations, m_frame->samples);
+        m_recordView = false;
+    }
+
+    //Canceled sketches still tell how fast the view renders
+    if (m_sketching) {
+        (m_raymarching ? m_raymarchBudget : m_frameBudget).update(m_worker->stats());
+    }
+
     if (!canceled) {
         refreshPreview();
     }
+
+    //Started from the event loop, so that everyone else has seen this job finish first
+    if (m_samplesValid && !refined && m_progressive) {
+        QTimer::singleShot(0, this, SLOT(refine()));
+    }
+}
+
+void Canvas::refine()
+{
+    //Anything started in the meantime invalidates the samples, except a recolor, which has to finish first
+    if (!m_samplesValid || !m_progressive || m_refining || m_recoloring) {
+        return;
+    }
+
+    RenderParams params(m_region, m_colors, m_antialiasing, m_coloring);
+    params.setFormula(m_formula);
+    params.setMaxIterations(m_currentIterations);
+    params.setThreadCount(m_threadCount);
+    params.setNiceness(m_niceness);
+
+    m_refining = true;
+    m_worker->refine(&m_frame->image, &m_frame->samples, &m_accumulator, params);
+
+    emit rendering();
 }
 
 void Canvas::refreshPreview()
 {
     QPixmap pixmap;
+    Trace::Span presentSpan("present");
 
     //TODO: blit completed lines of image to screen only rather than locking all render threads to copy entire image
 
     {
+        Trace::Span lockSpan("wait render threads");
         std::vector<std::unique_lock<std::mutex>> locks;
 
         for (int i = 0; i < m_worker->threadCount(); i++) {
             locks.emplace_back(m_worker->threadMutex(i));
         }
 
-        pixmap = QPixmap::fromImage(m_image);
+        lockSpan.end();
+
+        Trace::Span copySpan("copy to pixmap");
+        pixmap = QPixmap::fromImage(m_frame->image);
 
         /*QImage partialImage(m_image.data_ptr(), m_image.width(), m_linesCompleted, m_image.bytesPerLine(), m_image.format());
         pixmap = QPixmap::fromImage(partialImage);
@@ -238,6 +759,11 @@ void Canvas::refreshPreview()
     }
 }
 
+void Canvas::iterationLimitChanged(int maxIterations)
+{
+    m_currentIterations = maxIterations;
+}
+
 void Canvas::setAntialiasing ( int antialiasing ) {
     m_antialiasing = antialiasing;
     render();
@@ -247,11 +773,224 @@ int Canvas::antialiasing() {
     return m_antialiasing;
 }
 
+const ZoomRegion& Canvas::zoomRegion() {
+    return m_region;
+}
+
+void Canvas::setFormula ( const Formula& formula ) {
+    m_formula = formula;
+    updateJuliaInset();
+    render();
+}
+
+const Formula& Canvas::formula() {
+    return m_formula;
+}
+
 void Canvas::setColorScheme ( const ColorScheme& colors ) {
     m_colors = colors;
-    render();
+    updateJuliaInset();
+    recolor();
 }
 
 const ColorScheme& Canvas::colorScheme() {
     return m_colors;
 }
+
+void Canvas::setColoring ( ColorScheme::Coloring coloring ) {
+    m_coloring = coloring;
+    updateJuliaInset();
+    recolor();
+}
+
+ColorScheme::Coloring Canvas::coloring() {
+    return m_coloring;
+}
+
+void Canvas::setFilter ( Downsampler::Filter filter ) {
+    m_filter = filter;
+    recolor();
+}
+
+Downsampler::Filter Canvas::filter() {
+    return m_filter;
+}
+
+void Canvas::setProgressive ( bool progressive ) {
+    m_progressive = progressive;
+
+    if (progressive) {
+        refine();
+    } else if (m_refining) {
+        m_worker->cancel();
+    }
+}
+
+bool Canvas::progressive() {
+    return m_progressive;
+}
+
+void Canvas::setMaxIterations ( int maxIterations ) {
+    m_maxIterations = maxIterations;
+    updateJuliaInset();
+
+    if (m_samplesValid && maxIterations > m_currentIterations) {
+        resumeRender();
+    } else {
+        render();
+    }
+}
+
+int Canvas::maxIterations() {
+    return m_currentIterations;
+}
+
+void Canvas::setAutoIterations ( bool autoIterations ) {
+    m_autoIterations = autoIterations;
+
+    if (autoIterations && m_samplesValid) {
+        m_maxIterations = m_currentIterations;
+        resumeRender();
+    }
+}
+
+bool Canvas::autoIterations() {
+    return m_autoIterations;
+}
+
+void Canvas::setWorkerLimits ( int threadCount, int niceness ) {
+    m_threadCount = threadCount;
+    m_niceness = niceness;
+}
+
+void Canvas::setFrameTimeTarget ( double milliseconds ) {
+    m_frameBudget.setTarget(milliseconds);
+}
+
+void Canvas::setHistoryMemory ( std::size_t bytes ) {
+    m_history.setBudget(bytes);
+}
+
+void Canvas::setDensityMode ( bool enabled, DensityBuffer::Mode mode ) {
+    m_orbitDensity = enabled;
+    m_densityMode = mode;
+    m_raymarching = false;
+    updateJuliaInset();
+    render();
+}
+
+void Canvas::setRaymarchMode ( bool enabled, Raymarcher::Fractal fractal ) {
+    if (enabled && (!m_raymarching || fractal != m_scene.fractal)) {
+        m_scene = Raymarcher::Scene(fractal);
+        m_camera = m_scene.overview();
+    }
+
+    m_raymarching = enabled;
+    m_orbitDensity = false;
+    updateJuliaInset();
+    render();
+}
+
+bool Canvas::raymarching() {
+    return m_raymarching;
+}
+
+void Canvas::setJuliaInset ( bool enabled ) {
+    m_juliaInset = enabled;
+    updateJuliaInset();
+}
+
+bool Canvas::juliaInset() {
+    return m_juliaInset;
+}
+
+void Canvas::updateJuliaInset()
+{
+    bool visible = m_juliaInset && !m_raymarching && !m_formula.convergent();
+
+    //Without buttons held, mouse moves only arrive while tracking
+    this->setMouseTracking(visible);
+    m_juliaLabel->setVisible(visible);
+
+    if (visible) {
+        m_juliaPreview->setColors(m_colors, m_coloring, m_maxIterations);
+    }
+}
+
+void Canvas::juliaFrameReady()
+{
+    m_juliaLabel->setPixmap(QPixmap::fromImage(m_juliaPreview->image()));
+}
+
+bool Canvas::save ( const QString& fileName, bool storeSamples ) {
+    RenderFile::View view;
+    view.x1 = m_region.location().x();
+    view.y1 = m_region.location().y();
+    view.x2 = m_region.location().x() + m_region.width();
+    view.y2 = m_region.location().y() + m_region.height();
+    view.width = m_frame != nullptr ? m_frame->image.width() : this->width();
+    view.height = m_frame != nullptr ? m_frame->image.height() : this->height();
+    view.antialiasing = m_antialiasing;
+    view.colors = m_colors;
+    view.coloring = m_coloring;
+    view.filter = m_filter;
+    view.maxIterations = m_currentIterations;
+    view.autoIterations = m_autoIterations;
+    view.formula = m_formula;
+
+    //Refinement only reads the samples, so they can be written while it runs
+    const SampleBuffer* samples = storeSamples && m_samplesValid ? &m_frame->samples : nullptr;
+
+    //A view restored from the history keeps the antialiasing it was rendered at, whatever the current setting
+    if (samples != nullptr) {
+        view.antialiasing = samples->width() / m_frame->image.width();
+    }
+
+    return RenderFile::save(fileName.toLocal8Bit().constData(), view, samples);
+}
+
+bool Canvas::load ( const QString& fileName ) {
+    RenderFile file;
+
+    if (!file.open(fileName.toLocal8Bit().constData())) {
+        return false;
+    }
+
+    const RenderFile::View& view = file.view();
+
+    m_worker->cancel();
+
+    m_region = ZoomRegion(view.x1, view.y1, view.x2, view.y2);
+    m_colors = view.colors;
+    m_coloring = view.coloring;
+    m_filter = view.filter;
+    m_antialiasing = view.antialiasing;
+    m_maxIterations = view.maxIterations;
+    m_autoIterations = view.autoIterations;
+    m_formula = view.formula;
+    m_focusY = 0.5;
+
+    updateJuliaInset();
+
+    if (!file.hasSamples() || m_orbitDensity || m_raymarching) {
+        render();
+        return true;
+    }
+
+    //The mapped samples are only read as rows get colored; resuming continues any that were still pending
+    if (!acquireFrame(view.width, view.height, QImage::Format_RGB32)) {
+        m_samplesValid = false;
+        return false;
+    }
+
+    m_frameRegion = m_region;
+    file.attachSamples(m_frame->samples);
+
+    m_sketching = false;
+    m_samplesValid = true;
+    m_documentFrame = true;
+    m_currentIterations = view.maxIterations;
+
+    resumeRender();
+    return true;
+}
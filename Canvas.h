@@ -6,8 +6,18 @@
 
 #include "ZoomRegion.h"
 #include "ColorScheme.h"
+#include "Formula.h"
+#include "Downsampler.h"
+#include "FrameRing.h"
+#include "ViewHistory.h"
+#include "Accumulator.h"
+#include "FrameBudget.h"
+#include "DensityBuffer.h"
+#include "Raymarcher.h"
+#include "Camera.h"
 
 class BackgroundWorker;
+class JuliaPreview;
 
 class Canvas : public QLabel
 {
@@ -17,18 +27,86 @@ class Canvas : public QLabel
         QTimer* m_resizeTimer;
         QTimer* m_refreshTimer;
         ZoomRegion m_region;
+        Formula m_formula;
         ColorScheme m_colors;
+        ColorScheme::Coloring m_coloring;
+        Downsampler::Filter m_filter;
         int m_antialiasing;
+        int m_maxIterations;
+        int m_currentIterations;
+        bool m_autoIterations;
+        int m_threadCount;
+        int m_niceness;
         BackgroundWorker* m_worker;
-        QImage m_image;
+        FrameRing m_frames;
+        FrameRing::Frame* m_frame;
+
+        //The view the frame's samples were computed for
+        ZoomRegion m_frameRegion;
+        Accumulator m_accumulator;
+        bool m_sketching;
+        bool m_samplesValid;
+        bool m_progressive;
+        bool m_refining;
+        bool m_recoloring;
+
+        //The frame holds an opened document's render, sized for the document rather than the canvas
+        bool m_documentFrame;
+
+        ViewHistory m_history;
+
+        //The running job computes a view that goes into the history once it finishes
+        bool m_recordView;
+        FrameBudget m_frameBudget;
+
+        //Views are rendered as orbit densities instead of escape times
+        bool m_orbitDensity;
+        DensityBuffer::Mode m_densityMode;
+        DensityBuffer m_density;
+
+        //The histogram belongs to the frame and no job is adding to it
+        bool m_densityValid;
+
+        //Views are raymarched 3D fractals seen from the camera instead of regions of the plane
+        bool m_raymarching;
+        Raymarcher::Scene m_scene;
+        Camera m_camera;
+
+        //Raymarched sketches cost distance estimates rather than iterations, so they are budgeted on their own
+        FrameBudget m_raymarchBudget;
+
+        //Julia set of the point under the mouse, drawn over a corner of the view
+        bool m_juliaInset;
+        JuliaPreview* m_juliaPreview;
+        QLabel* m_juliaLabel;
 
         bool m_panning;
         bool m_zooming;
         QPoint m_dragLast;
         Point m_zoomPivot;
 
+        //Height of the last place the user pointed at, as a fraction of the canvas height
+        double m_focusY;
+
+        void setFocusPoint(const QPoint& pos);
+
+        //Makes m_frame a frame of the given size; false, leaving m_frame as it was, if there is not enough memory
+        bool acquireFrame(int width, int height, QImage::Format format, const FrameRing::Frame* keep = nullptr);
+
         void render();
+        void resumeRender();
+        bool extendRender();
+        void recolor();
+        void showView(const ViewHistory::Entry* entry);
         void renderSketch();
+        void renderDensity();
+        void renderRaymarch(bool sketch);
+
+        //Distance the camera can move without passing into the fractal
+        double cameraClearance();
+
+        //Shows the inset if it applies to the current mode and formula, with the view's colors
+        void updateJuliaInset();
 
     public:
         Canvas(QWidget* parent);
@@ -37,9 +115,52 @@ class Canvas : public QLabel
         BackgroundWorker* backgroundWorker() { return m_worker; }
 
         int antialiasing();
+        const ZoomRegion& zoomRegion();
+        const Formula& formula();
         const ColorScheme& colorScheme();
+        ColorScheme::Coloring coloring();
+        Downsampler::Filter filter();
+        int maxIterations();
+        bool autoIterations();
         void setAntialiasing(int antialiasing);
+
+        //Density renders keep drawing Mandelbrot orbits whatever the formula
+        void setFormula(const Formula& formula);
         void setColorScheme(const ColorScheme& colors);
+        void setColoring(ColorScheme::Coloring coloring);
+        void setFilter(Downsampler::Filter filter);
+        void setMaxIterations(int maxIterations);
+        void setAutoIterations(bool autoIterations);
+
+        //Keep supersampling a finished render while the view is idle
+        void setProgressive(bool progressive);
+        bool progressive();
+
+        //Render threads (0 for automatic) and nice value for full renders; takes effect on the next render
+        void setWorkerLimits(int threadCount, int niceness);
+
+        //Time a sketch may take while panning and zooming
+        void setFrameTimeTarget(double milliseconds);
+
+        //Memory the compressed samples of previous views may take
+        void setHistoryMemory(std::size_t bytes);
+
+        //Switches between escape time renders and one of the orbit density modes
+        void setDensityMode(bool enabled, DensityBuffer::Mode mode = DensityBuffer::Buddhabrot);
+
+        //Switches to raymarching a 3D fractal, starting from an overview of it when the fractal changes
+        void setRaymarchMode(bool enabled, Raymarcher::Fractal fractal = Raymarcher::Mandelbulb);
+        bool raymarching();
+
+        //Julia sets only exist for the Mandelbrot formula in the plane; the inset stays hidden otherwise
+        void setJuliaInset(bool enabled);
+        bool juliaInset();
+
+        //Stores the view and, if storeSamples is set and the current render has finished, its samples
+        bool save(const QString& fileName, bool storeSamples);
+
+        //Opens a document saved by save(); stored samples are shown and continued instead of rendered again
+        bool load(const QString& fileName);
 
     protected:
         virtual void resizeEvent(QResizeEvent* event);
@@ -50,10 +171,18 @@ class Canvas : public QLabel
         virtual void mouseReleaseEvent(QMouseEvent* event);
         virtual void mouseMoveEvent(QMouseEvent* event);
 
+    public slots:
+        //Return to the previous or next finished view, recoloring its kept samples if it still has them
+        void back();
+        void forward();
+
     private slots:
         void resizeTimerExpired();
         void renderComplete(bool canceled);
         void refreshPreview();
+        void iterationLimitChanged(int maxIterations);
+        void refine();
+        void juliaFrameReady();
 
     signals:
         void rendering();
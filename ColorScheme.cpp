@@ -1,5 +1,7 @@
 #include "ColorScheme.h"
+#include "SampleBuffer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <initializer_list>
 
@@ -22,8 +24,14 @@ QColor ColorScheme::calculateColor ( double index, int maxIterations ) const {
     //TODO: implement logarithmic color distribution
     //TODO: implement mandelbrot set color
 
-    double mappedIndex = index / (double) (maxIterations - 1) * (double) (m_colors.size() - 1) * 5;
+    return paletteColor(index * paletteScale(maxIterations));
+}
+
+double ColorScheme::paletteScale ( int maxIterations ) const {
+    return (double) (m_colors.size() - 1) / (double) (maxIterations - 1) * 5;
+}
 
+QColor ColorScheme::paletteColor ( double mappedIndex ) const {
     double intpart;
     //Add 0.5 for unbiased rounding
     double indexFrac = std::modf(mappedIndex, &intpart);
@@ -47,3 +55,90 @@ QColor ColorScheme::calculateColor ( double index, int maxIterations ) const {
     return QColor((int) red, (int) green, (int) blue);
 }
 
+
+void ColorScheme::indices ( Coloring coloring, const SampleBuffer& samples, std::size_t first, int count, int maxIterations, float* out ) {
+    //Palette span used by the colorings that are not iteration counts
+    const float band = (float) (maxIterations - 1) / 5.0f;
+
+    //One branch-free loop per coloring so that each one vectorizes
+    const int* iterations = samples.iterations() + first;
+
+    switch (coloring) {
+        case IterationCount:
+            for (int i = 0; i < count; i++) {
+                out[i] = (float) iterations[i];
+            }
+            break;
+
+        case SmoothCount: {
+            const float* smooth = samples.smoothIterations() + first;
+
+            for (int i = 0; i < count; i++) {
+                out[i] = smooth[i];
+            }
+            break;
+        }
+
+        case FinalMagnitude: {
+            //Escaped orbits land between the bailout radius and its square
+            const float* magnitude = samples.magnitude() + first;
+
+            for (int i = 0; i < count; i++) {
+                out[i] = iterations[i] >= 0 ? std::log2(magnitude[i] * 0.5f) * band : -1.0f;
+            }
+            break;
+        }
+
+        case OrbitTrapDistance: {
+            const float* orbitTrap = samples.orbitTrap() + first;
+
+            for (int i = 0; i < count; i++) {
+                out[i] = orbitTrap[i] * 0.5f * band;
+            }
+            break;
+        }
+
+        case InteriorPeriod: {
+            const int* period = samples.period() + first;
+
+            for (int i = 0; i < count; i++) {
+                float interior = period[i] > 0 ? (float) (period[i] - 1) * band * 0.25f : -1.0f;
+                out[i] = iterations[i] >= 0 ? (float) iterations[i] : interior;
+            }
+            break;
+        }
+
+        case ConvergedRoot: {
+            //Escape time samples have no root and use the first band
+            const int* root = samples.period() + first;
+
+            for (int i = 0; i < count; i++) {
+                float base = (float) std::max(root[i] - 1, 0) * band;
+                out[i] = iterations[i] >= 0 ? base + (float) iterations[i] : -1.0f;
+            }
+            break;
+        }
+    }
+}
+
+unsigned int ColorScheme::channels ( Coloring coloring ) {
+    switch (coloring) {
+        case IterationCount:
+            return SampleBuffer::Iterations;
+
+        case SmoothCount:
+            return SampleBuffer::Iterations | SampleBuffer::SmoothIterations;
+
+        case FinalMagnitude:
+            return SampleBuffer::Iterations | SampleBuffer::Magnitude;
+
+        case OrbitTrapDistance:
+            return SampleBuffer::Iterations | SampleBuffer::OrbitTrap;
+
+        case InteriorPeriod:
+        case ConvergedRoot:
+            return SampleBuffer::Iterations | SampleBuffer::Period;
+    }
+
+    return SampleBuffer::Iterations;
+}
@@ -1,11 +1,27 @@
 #ifndef ColorScheme_H
 #define ColorScheme_H
 
+#include <cstddef>
 #include <vector>
 #include <QColor>
 
+class SampleBuffer;
+
 class ColorScheme
 {
+    public:
+        //Which per-sample data a color is derived from
+        enum Coloring
+        {
+            IterationCount,
+            SmoothCount,
+            FinalMagnitude,
+            OrbitTrapDistance,
+            InteriorPeriod,
+            //Root finding formulas: a band of the palette per root, shaded by the steps to converge
+            ConvergedRoot
+        };
+
     private:
         std::vector<QColor> m_colors;
         QColor m_interiorColor;
@@ -24,6 +40,19 @@ class ColorScheme
 
         QColor calculateColor(double index, int maxIterations) const;
 
+        //Color at a position along the palette, in palette entries; positions wrap around after the last entry
+        QColor paletteColor(double position) const;
+        double paletteScale(int maxIterations) const;
+        int paletteSize() const                 { return m_colors.size(); }
+        const std::vector<QColor>& palette() const { return m_colors; }
+        const QColor& interiorColor() const     { return m_interiorColor; }
+        bool logarithmic() const                { return m_logarithmic; }
+        bool cycleColors() const                { return m_cycleColors; }
+
+        //Palette index of count samples starting at first; negative for interior samples
+        static void indices(Coloring coloring, const SampleBuffer& samples, std::size_t first, int count, int maxIterations, float* out);
+        static unsigned int channels(Coloring coloring);
+
         static ColorScheme Fire;
         static ColorScheme Ice;
         static ColorScheme Rainbow;
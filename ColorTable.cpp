@@ -0,0 +1,66 @@
+#include "ColorTable.h"
+#include "ColorScheme.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //Table entries per palette entry; finer than one step of an 8 bit channel
+    const int STEPS = 256;
+
+    //Samples looked up at a time; their entry indices stay on the stack, so rows never allocate
+    const int LOOKUP_CHUNK = 256;
+}
+
+ColorTable::ColorTable(const ColorScheme& colors, int maxIterations) :
+    m_scale(colors.paletteScale(maxIterations)),
+    m_paletteSize(colors.paletteSize())
+{
+    //The interior color goes into the entry past the palette
+    int entries = m_paletteSize * STEPS;
+
+    m_red.resize(entries + 1);
+    m_green.resize(entries + 1);
+    m_blue.resize(entries + 1);
+
+    for (int i = 0; i < entries; i++) {
+        QColor color = colors.paletteColor((double) i / (double) STEPS);
+        m_red[i] = color.red();
+        m_green[i] = color.green();
+        m_blue[i] = color.blue();
+    }
+
+    m_red[entries] = colors.interiorColor().red();
+    m_green[entries] = colors.interiorColor().green();
+    m_blue[entries] = colors.interiorColor().blue();
+}
+
+void ColorTable::lookup(const float* indices, int count, unsigned char* red, unsigned char* green, unsigned char* blue) const
+{
+    int entries = m_paletteSize * STEPS;
+    double size = m_paletteSize;
+    double recip_size = m_paletteSize > 0 ? 1.0 / size : 0.0;
+    int entryIndices[LOOKUP_CHUNK];
+
+    for (int first = 0; first < count; first += LOOKUP_CHUNK) {
+        int chunk = std::min(count - first, LOOKUP_CHUNK);
+        const float* chunkIndices = indices + first;
+
+        //Positions wrap around the palette the same way ColorScheme::paletteColor does
+        for (int i = 0; i < chunk; i++) {
+            double position = (double) chunkIndices[i] * m_scale;
+            position -= std::floor(position * recip_size) * size;
+
+            int slot = (int) (position * STEPS);
+            slot = slot < entries ? slot : entries - 1;
+            entryIndices[i] = chunkIndices[i] < 0.0f || entries == 0 ? entries : slot;
+        }
+
+        for (int i = 0; i < chunk; i++) {
+            red[first + i] = m_red[entryIndices[i]];
+            green[first + i] = m_green[entryIndices[i]];
+            blue[first + i] = m_blue[entryIndices[i]];
+        }
+    }
+}
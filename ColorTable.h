@@ -0,0 +1,30 @@
+#ifndef ColorTable_H
+#define ColorTable_H
+
+#include <vector>
+
+class ColorScheme;
+
+/*
+ * A color scheme sampled into a lookup table for one iteration limit, so that
+ * colorizing a sample is an index computation and a table read instead of a
+ * palette interpolation. Colors are stored in separate red, green and blue
+ * planes, as are the colorized samples.
+ */
+class ColorTable
+{
+    private:
+        std::vector<unsigned char> m_red;
+        std::vector<unsigned char> m_green;
+        std::vector<unsigned char> m_blue;
+        double m_scale;
+        int m_paletteSize;
+
+    public:
+        ColorTable(const ColorScheme& colors, int maxIterations);
+
+        //Colors for count palette indices as produced by ColorScheme::indices
+        void lookup(const float* indices, int count, unsigned char* red, unsigned char* green, unsigned char* blue) const;
+};
+
+#endif
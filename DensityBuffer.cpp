@@ -0,0 +1,111 @@
+#include "DensityBuffer.h"
+#include "ColorScheme.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QImage>
+
+namespace
+{
+    //Counts at or above this share of the lit pixels are shown at full brightness
+    const double WHITE_PERCENTILE = 0.995;
+
+    //Every this many pixels is looked at to find the percentile
+    const std::size_t PERCENTILE_STRIDE = 7;
+
+    const int LEVELS = 256;
+
+    double whitePoint(const DensityBuffer& density, int channel)
+    {
+        std::vector<std::uint64_t> lit;
+
+        for (std::size_t pixel = 0; pixel < density.size(); pixel += PERCENTILE_STRIDE) {
+            std::uint64_t hits = density.hits(channel, pixel);
+
+            if (hits > 0) {
+                lit.push_back(hits);
+            }
+        }
+
+        if (lit.empty()) {
+            return 1.0;
+        }
+
+        std::size_t rank = std::min(lit.size() - 1, (std::size_t) (WHITE_PERCENTILE * lit.size()));
+        std::nth_element(lit.begin(), lit.begin() + rank, lit.end());
+
+        return std::max(1.0, (double) lit[rank]);
+    }
+
+    int level(std::uint64_t hits, double white)
+    {
+        return (int) std::min((double) (LEVELS - 1), std::sqrt((double) hits / white) * (LEVELS - 1) + 0.5);
+    }
+}
+
+DensityBuffer::DensityBuffer() :
+    m_width(0),
+    m_height(0),
+    m_capacity(0)
+{ }
+
+void DensityBuffer::reset(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+
+    std::size_t counts = CHANNELS * size();
+
+    if (counts > m_capacity) {
+        m_hits.reset(new std::atomic<std::uint64_t>[counts]);
+        m_capacity = counts;
+    }
+
+    for (std::size_t i = 0; i < counts; i++) {
+        m_hits[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void DensityBuffer::resolve(Mode mode, const ColorScheme& colors, QImage& image) const
+{
+    if (mode == Nebulabrot) {
+        double white[CHANNELS];
+
+        for (int channel = 0; channel < CHANNELS; channel++) {
+            white[channel] = whitePoint(*this, channel);
+        }
+
+        for (int y = 0; y < m_height; y++) {
+            QRgb* out = (QRgb*) image.scanLine(y);
+
+            for (int x = 0; x < m_width; x++) {
+                std::size_t pixel = (std::size_t) y * m_width + x;
+                out[x] = qRgb(level(hits(0, pixel), white[0]), level(hits(1, pixel), white[1]), level(hits(2, pixel), white[2]));
+            }
+        }
+
+        return;
+    }
+
+    //Dark to bright along the palette, starting from the interior color
+    QRgb table[LEVELS];
+    double scale = colors.paletteSize() > 1 ? (double) (colors.paletteSize() - 1) / (LEVELS - 1) : 0.0;
+
+    table[0] = colors.interiorColor().rgb();
+
+    for (int i = 1; i < LEVELS; i++) {
+        table[i] = colors.paletteSize() > 0 ? colors.paletteColor(i * scale).rgb() : qRgb(i, i, i);
+    }
+
+    double white = whitePoint(*this, 0);
+
+    for (int y = 0; y < m_height; y++) {
+        QRgb* out = (QRgb*) image.scanLine(y);
+
+        for (int x = 0; x < m_width; x++) {
+            out[x] = table[level(hits(0, (std::size_t) y * m_width + x), white)];
+        }
+    }
+}
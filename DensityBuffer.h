@@ -0,0 +1,71 @@
+#ifndef DensityBuffer_H
+#define DensityBuffer_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class ColorScheme;
+class QImage;
+
+/*
+ * Histogram framebuffer for orbit density renders. Every render thread adds
+ * its orbits' hits straight into the shared counts with relaxed atomic adds:
+ * hits scatter over the whole image, so threads rarely touch the same cache
+ * line and no locking or merging is needed. Hits carry fixed point weights
+ * (WEIGHT_ONE for an orbit drawn uniformly) so importance sampled orbits can
+ * be weighted down.
+ */
+class DensityBuffer
+{
+    public:
+        enum Mode
+        {
+            //Orbits of points that escape
+            Buddhabrot,
+            //Orbits of points that never escape
+            AntiBuddhabrot,
+            //Escaping orbits in three channels with decreasing iteration limits, shown as red, green and blue
+            Nebulabrot
+        };
+
+        static const int CHANNELS = 3;
+        static const std::uint32_t WEIGHT_ONE = 1 << 16;
+
+    private:
+        int m_width;
+        int m_height;
+        std::size_t m_capacity;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> m_hits;
+
+    public:
+        DensityBuffer();
+
+        //Forgets all hits
+        void reset(int width, int height);
+
+        int width() const                   { return m_width; }
+        int height() const                  { return m_height; }
+        std::size_t size() const            { return (std::size_t) m_width * (std::size_t) m_height; }
+
+        void add(int channel, std::size_t pixel, std::uint32_t weight)
+        {
+            m_hits[channel * size() + pixel].fetch_add(weight, std::memory_order_relaxed);
+        }
+
+        std::uint64_t hits(int channel, std::size_t pixel) const
+        {
+            return m_hits[channel * size() + pixel].load(std::memory_order_relaxed);
+        }
+
+        /*
+         * Tone maps the histogram into image: counts are scaled against a
+         * high percentile, so a few very bright pixels do not darken the rest,
+         * and square rooted. Single channel modes are colored along the
+         * palette, the Nebulabrot maps its channels to red, green and blue.
+         */
+        void resolve(Mode mode, const ColorScheme& colors, QImage& image) const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "Downsampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace
+{
+    //Standard deviation of the gaussian filter, in pixels
+    const double GAUSSIAN_SIGMA = 0.3;
+
+    //Pixels filtered at a time; their sums stay on the stack, so rows never allocate
+    const int DOWNSAMPLE_CHUNK = 256;
+
+    double weight(Downsampler::Filter filter, double offset)
+    {
+        switch (filter) {
+            case Downsampler::Box:
+                return 1.0;
+
+            case Downsampler::Tent:
+                return 1.0 - std::abs(offset);
+
+            case Downsampler::Gaussian:
+                return std::exp(-offset * offset / (2.0 * GAUSSIAN_SIGMA * GAUSSIAN_SIGMA));
+        }
+
+        return 1.0;
+    }
+
+    //One color plane: horizontal pass per sample row, then accumulate the rows
+    void filterPlane(const unsigned char* samples, int sampleStride, int width, int antialiasing,
+                     const float* weights, float* row, float* out)
+    {
+        for (int x = 0; x < width; x++) {
+            out[x] = 0.0f;
+        }
+
+        for (int aay = 0; aay < antialiasing; aay++) {
+            const unsigned char* line = samples + aay * sampleStride;
+
+            for (int x = 0; x < width; x++) {
+                row[x] = 0.0f;
+            }
+
+            for (int aax = 0; aax < antialiasing; aax++) {
+                const unsigned char* column = line + aax;
+
+                for (int x = 0; x < width; x++) {
+                    row[x] += weights[aax] * (float) column[x * antialiasing];
+                }
+            }
+
+            for (int x = 0; x < width; x++) {
+                out[x] += weights[aay] * row[x];
+            }
+        }
+    }
+}
+
+Downsampler::Downsampler(Filter filter, int antialiasing) :
+    m_antialiasing(antialiasing),
+    m_weights(antialiasing)
+{
+    //Sample offsets from the pixel center match SampleGrid
+    double total = 0.0;
+
+    for (int i = 0; i < antialiasing; i++) {
+        m_weights[i] = weight(filter, ((double) i + 0.5) / (double) antialiasing - 0.5);
+        total += m_weights[i];
+    }
+
+    for (int i = 0; i < antialiasing; i++) {
+        m_weights[i] /= total;
+    }
+}
+
+void Downsampler::downsample(const unsigned char* red, const unsigned char* green, const unsigned char* blue,
+                             int sampleStride, int width, QRgb* out) const
+{
+    float row[DOWNSAMPLE_CHUNK];
+    float redSum[DOWNSAMPLE_CHUNK];
+    float greenSum[DOWNSAMPLE_CHUNK];
+    float blueSum[DOWNSAMPLE_CHUNK];
+
+    for (int first = 0; first < width; first += DOWNSAMPLE_CHUNK) {
+        int chunk = std::min(width - first, DOWNSAMPLE_CHUNK);
+        std::size_t offset = (std::size_t) first * m_antialiasing;
+
+        filterPlane(red + offset,   sampleStride, chunk, m_antialiasing, m_weights.data(), row, redSum);
+        filterPlane(green + offset, sampleStride, chunk, m_antialiasing, m_weights.data(), row, greenSum);
+        filterPlane(blue + offset,  sampleStride, chunk, m_antialiasing, m_weights.data(), row, blueSum);
+
+        for (int x = 0; x < chunk; x++) {
+            out[first + x] = qRgb((int) (redSum[x] + 0.5f), (int) (greenSum[x] + 0.5f), (int) (blueSum[x] + 0.5f));
+        }
+    }
+}
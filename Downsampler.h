@@ -0,0 +1,40 @@
+#ifndef Downsampler_H
+#define Downsampler_H
+
+#include <vector>
+
+#include <QColor>
+
+/*
+ * Reduces the antialiasing x antialiasing colorized samples of each pixel to
+ * one color. Filters weigh samples by their distance from the pixel center;
+ * weights are separable and normalized, so a flat area stays flat.
+ */
+class Downsampler
+{
+    public:
+        enum Filter
+        {
+            Box,
+            Tent,
+            Gaussian
+        };
+
+    private:
+        int m_antialiasing;
+        std::vector<float> m_weights;
+
+    public:
+        Downsampler(Filter filter, int antialiasing);
+
+        int antialiasing() const { return m_antialiasing; }
+
+        /*
+         * Samples of one pixel row: antialiasing rows of width * antialiasing
+         * samples per color plane, rows sampleStride apart.
+         */
+        void downsample(const unsigned char* red, const unsigned char* green, const unsigned char* blue,
+                        int sampleStride, int width, QRgb* out) const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "EscapeTime.h"
+
+namespace
+{
+    template<unsigned int Channels>
+    int mandelbrotRow(const double* reals, double imag, int count, int maxIters, double boundary,
+                      SampleBuffer& samples, std::size_t index, bool resume)
+    {
+        int escaped = 0;
+
+        for (int x = 0; x < count; x++) {
+            escaped += mandelbrot<Channels>(reals[x], imag, maxIters, boundary, samples, index + x, resume);
+        }
+
+        return escaped;
+    }
+
+    template<unsigned int Channels>
+    int mandelbrotPoints(const double* reals, const double* imags, int count, int maxIters, double boundary,
+                         SampleBuffer& samples, std::size_t index)
+    {
+        int escaped = 0;
+
+        for (int i = 0; i < count; i++) {
+            escaped += mandelbrot<Channels>(reals[i], imags[i], maxIters, boundary, samples, index + i);
+        }
+
+        return escaped;
+    }
+
+    template<unsigned int Channels>
+    int juliaSetRow(const double* reals, double imag, int count, double c_real, double c_imag, int maxIters,
+                    double boundary, SampleBuffer& samples, std::size_t index)
+    {
+        int escaped = 0;
+
+        for (int x = 0; x < count; x++) {
+            escaped += julia<Channels>(reals[x], imag, c_real, c_imag, maxIters, boundary, samples, index + x);
+        }
+
+        return escaped;
+    }
+
+    const unsigned int CHANNEL_COMBINATIONS = SampleBuffer::AllChannels + 1;
+
+    //Instantiates the row and point kernels for every channel combination
+    template<unsigned int Channels>
+    struct RowTable
+    {
+        static void fill(EscapeTimeRowFunction* table, EscapeTimePointsFunction* points, JuliaRowFunction* julias)
+        {
+            table[Channels] = &mandelbrotRow<Channels>;
+            points[Channels] = &mandelbrotPoints<Channels>;
+            julias[Channels] = &juliaSetRow<Channels>;
+            RowTable<Channels - 1>::fill(table, points, julias);
+        }
+    };
+
+    template<>
+    struct RowTable<0>
+    {
+        static void fill(EscapeTimeRowFunction* table, EscapeTimePointsFunction* points, JuliaRowFunction* julias)
+        {
+            table[0] = &mandelbrotRow<0>;
+            points[0] = &mandelbrotPoints<0>;
+            julias[0] = &juliaSetRow<0>;
+        }
+    };
+
+    struct RowDispatch
+    {
+        EscapeTimeRowFunction table[CHANNEL_COMBINATIONS];
+        EscapeTimePointsFunction points[CHANNEL_COMBINATIONS];
+        JuliaRowFunction julias[CHANNEL_COMBINATIONS];
+
+        RowDispatch()
+        {
+            RowTable<CHANNEL_COMBINATIONS - 1>::fill(table, points, julias);
+        }
+    };
+
+    const RowDispatch ROW_DISPATCH;
+}
+
+EscapeTimeRowFunction escapeTimeRow(unsigned int channels)
+{
+    return ROW_DISPATCH.table[channels & SampleBuffer::AllChannels];
+}
+
+EscapeTimePointsFunction escapeTimePoints(unsigned int channels)
+{
+    return ROW_DISPATCH.points[channels & SampleBuffer::AllChannels];
+}
+
+JuliaRowFunction juliaRow(unsigned int channels)
+{
+    return ROW_DISPATCH.julias[channels & SampleBuffer::AllChannels];
+}
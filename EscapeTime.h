@@ -0,0 +1,204 @@
+#ifndef EscapeTime_H
+#define EscapeTime_H
+
+#include <cmath>
+#include <cstddef>
+
+#include "SampleBuffer.h"
+
+/*
+ * Iterates z -> z^2 + c from z until it leaves the boundary or maxIters is
+ * reached, starting at iteration i with the orbit trap and, for samples
+ * already known to be interior, the period found so far, then stores the
+ * requested channels. Shared by the Mandelbrot and Julia kernels, which
+ * differ only in where the orbit starts.
+ */
+template<unsigned int Channels>
+inline bool escape(double z_real, double z_imag, const double c_real, const double c_imag, int i,
+                   double trap_sqr, int period, bool interior, const int maxIters, const double boundary,
+                   SampleBuffer& samples, const std::size_t index)
+{
+    const bool wantSmooth    = (Channels & SampleBuffer::SmoothIterations) != 0;
+    const bool wantMagnitude = (Channels & SampleBuffer::Magnitude) != 0;
+    const bool wantTrap      = (Channels & SampleBuffer::OrbitTrap) != 0;
+    const bool wantPeriod    = (Channels & SampleBuffer::Period) != 0;
+    const bool keepState     = (Channels & SampleBuffer::State) != 0;
+
+    int iterations = -1;
+    double z_mag_sqr = z_real * z_real + z_imag * z_imag;
+
+    if (!interior) {
+        const double boundarySqr = boundary * boundary;
+
+        //Brent style cycle detection, only used when the period is requested
+        double check_real = z_real;
+        double check_imag = z_imag;
+        int checkIter = i;
+        int checkInterval = 1;
+
+        for (; i < maxIters; i++) {
+            double z_real_sqr = z_real * z_real;
+            double z_imag_sqr = z_imag * z_imag;
+            double z_real_imag = z_real * z_imag;
+
+            z_mag_sqr = z_real_sqr + z_imag_sqr;
+
+            if (wantTrap && z_mag_sqr < trap_sqr) {
+                trap_sqr = z_mag_sqr;
+            }
+
+            if (z_mag_sqr > boundarySqr) {
+                iterations = i;
+                break;
+            }
+
+            z_real = z_real_sqr - z_imag_sqr + c_real;
+            z_imag = z_real_imag + z_real_imag + c_imag;
+
+            if (wantPeriod) {
+                if (std::abs(z_real - check_real) < 1e-13 && std::abs(z_imag - check_imag) < 1e-13) {
+                    period = i + 1 - checkIter;
+                    interior = true;
+                    break;
+                }
+
+                if (i + 1 - checkIter == checkInterval) {
+                    check_real = z_real;
+                    check_imag = z_imag;
+                    checkIter = i + 1;
+                    checkInterval *= 2;
+                }
+            }
+        }
+    }
+
+    if (Channels & SampleBuffer::Iterations) {
+        samples.iterations()[index] = iterations;
+    }
+
+    if (wantSmooth) {
+        float smooth = -1.0f;
+
+        if (iterations >= 0) {
+            //Normalized iteration count; continuous across escape bands
+            double log_z = 0.5 * std::log(z_mag_sqr) / std::log(boundary);
+            smooth = (float) (iterations + 1 - std::log2(log_z));
+        }
+
+        samples.smoothIterations()[index] = smooth;
+    }
+
+    if (wantMagnitude) {
+        samples.magnitude()[index] = (float) std::sqrt(z_mag_sqr);
+    }
+
+    if (wantTrap) {
+        samples.orbitTrap()[index] = (float) std::sqrt(trap_sqr);
+    }
+
+    if (wantPeriod) {
+        samples.period()[index] = iterations >= 0 ? 0 : period;
+    }
+
+    if (keepState) {
+        samples.zReal()[index] = z_real;
+        samples.zImag()[index] = z_imag;
+        samples.iterated()[index] = i;
+        samples.status()[index] = iterations >= 0 ? SampleBuffer::Escaped : (interior ? SampleBuffer::Interior : SampleBuffer::Pending);
+    }
+
+    return iterations >= 0;
+}
+
+/*
+ * Escape time kernel, templated on the set of SampleBuffer channels it has to
+ * produce. Channels is a compile time constant, so every test against it folds
+ * away and the bookkeeping for unused channels never reaches the inner loop.
+ *
+ * With the State channel, resume continues a sample from the z and iteration
+ * count stored by a previous pass with a lower limit; Uncomputed samples
+ * start from scratch as without resume. Returns whether the sample escaped
+ * during this call.
+ */
+template<unsigned int Channels>
+inline bool mandelbrot(const double c_real, const double c_imag, const int maxIters, const double boundary,
+                       SampleBuffer& samples, const std::size_t index, const bool resume = false)
+{
+    const bool wantTrap      = (Channels & SampleBuffer::OrbitTrap) != 0;
+    const bool keepState     = (Channels & SampleBuffer::State) != 0;
+
+    int period = 0;
+    bool interior = false;
+    double z_real = c_real;
+    double z_imag = c_imag;
+    double trap_sqr = 0.0;
+    int i = 0;
+
+    if (keepState && resume && samples.status()[index] != SampleBuffer::Uncomputed) {
+        //Escaped and settled samples keep their results; pending ones continue where they stopped
+        if (samples.status()[index] != SampleBuffer::Pending) {
+            return false;
+        }
+
+        z_real = samples.zReal()[index];
+        z_imag = samples.zImag()[index];
+        i = samples.iterated()[index];
+
+        if (wantTrap) {
+            trap_sqr = (double) samples.orbitTrap()[index] * (double) samples.orbitTrap()[index];
+        }
+    } else {
+        //Test if point is in main cardioid
+        double c_real_minus_quarter = c_real - 0.25;
+        double c_imag_square = c_imag * c_imag;
+        double q =  c_real_minus_quarter * c_real_minus_quarter + c_imag_square;
+        double c1_test = q * (q + c_real_minus_quarter);
+
+        //Test if point is in period 2 bulb
+        double c_real_plus_1 = c_real + 1;
+
+        if (c1_test < 0.25 * c_imag_square) {
+            period = 1;
+            interior = true;
+        } else if (c_real_plus_1 * c_real_plus_1 + c_imag_square < 1.0 / 16.0) {
+            period = 2;
+            interior = true;
+        }
+
+        trap_sqr = c_real * c_real + c_imag_square;
+    }
+
+    return escape<Channels>(z_real, z_imag, c_real, c_imag, i, trap_sqr, period, interior, maxIters, boundary, samples, index);
+}
+
+/*
+ * Julia set kernel: the orbit of z0 = (z_real, z_imag) under z -> z^2 + c
+ * for a fixed c. Produces the same channels as mandelbrot(), but never
+ * resumes, and has no closed form interior test to skip the iteration with.
+ */
+template<unsigned int Channels>
+inline bool julia(const double z_real, const double z_imag, const double c_real, const double c_imag, const int maxIters,
+                  const double boundary, SampleBuffer& samples, const std::size_t index)
+{
+    return escape<Channels>(z_real, z_imag, c_real, c_imag, 0, z_real * z_real + z_imag * z_imag, 0, false,
+                            maxIters, boundary, samples, index);
+}
+
+//Returns the number of samples in the row that escaped during this call
+typedef int (*EscapeTimeRowFunction)(const double* reals, double imag, int count, int maxIters, double boundary,
+                                     SampleBuffer& samples, std::size_t index, bool resume);
+
+//Same for arbitrary points, e.g. jittered samples; never resumes
+typedef int (*EscapeTimePointsFunction)(const double* reals, const double* imags, int count, int maxIters, double boundary,
+                                        SampleBuffer& samples, std::size_t index);
+
+//Same for a row of the Julia set of c
+typedef int (*JuliaRowFunction)(const double* reals, double imag, int count, double c_real, double c_imag, int maxIters,
+                                double boundary, SampleBuffer& samples, std::size_t index);
+
+//Returns the row kernel instantiated for exactly the given channel set
+EscapeTimeRowFunction escapeTimeRow(unsigned int channels);
+EscapeTimePointsFunction escapeTimePoints(unsigned int channels);
+JuliaRowFunction juliaRow(unsigned int channels);
+
+#endif
@@ -0,0 +1,403 @@
+#include "Formula.h"
+#include "SampleBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+    //Points are iterated in blocks of this many, one per SIMD lane; the loops over a block are branch free so that they vectorize
+    const int LANES = 8;
+
+    //An orbit has converged once its step is shorter than this
+    const double CONVERGENCE_EPSILON = 1e-6;
+
+    //Keeps the division finite where p'(z) vanishes; such orbits are thrown far off and take long to come back
+    const double MIN_DERIVATIVE_SQR = 1e-300;
+
+    //Nova orbits start at the critical point of the classic z^3 - 1 variant
+    const double NOVA_START = 1.0;
+
+    //Durand-Kerner iteration for the roots of the polynomial
+    const int ROOT_ITERATIONS = 1000;
+    const double ROOT_TOLERANCE = 1e-15;
+
+    //Coefficients split into planes, as the lane loops use them
+    struct Coefficients
+    {
+        int degree;
+        double real[Formula::MAX_DEGREE + 1];
+        double imag[Formula::MAX_DEGREE + 1];
+        double relaxationReal;
+        double relaxationImag;
+    };
+
+    int nearestRoot(const std::vector<std::complex<double>>& roots, std::complex<double> z)
+    {
+        int nearest = 0;
+
+        for (int i = 1; i < (int) roots.size(); i++) {
+            if (std::norm(z - roots[i]) < std::norm(z - roots[nearest])) {
+                nearest = i;
+            }
+        }
+
+        return nearest;
+    }
+
+    /*
+     * Iterates up to LANES points side by side until each one has converged
+     * or reached the limit. Settled samples are left alone when resuming.
+     * Returns the number of points that converged during this call.
+     */
+    int convergeBlock(const Formula& formula, const Coefficients& a, const double* cReal, const double* cImag, int count,
+                      int maxIters, SampleBuffer& samples, std::size_t index, bool resume)
+    {
+        const bool newton = formula.kind() == Formula::Newton;
+        const bool keepState = samples.hasChannels(SampleBuffer::State);
+        const double epsilonSqr = CONVERGENCE_EPSILON * CONVERGENCE_EPSILON;
+        const double addC = newton ? 0.0 : 1.0;
+
+        double cr[LANES];
+        double ci[LANES];
+        double zr[LANES];
+        double zi[LANES];
+        double stepSqr[LANES];
+        double trapSqr[LANES];
+        int iterated[LANES];
+        int converged[LANES];
+        int active[LANES];
+        bool settled[LANES];
+
+        int remaining = 0;
+
+        for (int l = 0; l < LANES; l++) {
+            bool present = l < count;
+
+            cr[l] = present ? cReal[l] : 0.0;
+            ci[l] = present ? cImag[l] : 0.0;
+            zr[l] = newton ? cr[l] : NOVA_START;
+            zi[l] = newton ? ci[l] : 0.0;
+            stepSqr[l] = std::numeric_limits<double>::infinity();
+            trapSqr[l] = zr[l] * zr[l] + zi[l] * zi[l];
+            iterated[l] = 0;
+            converged[l] = -1;
+            active[l] = present && maxIters > 0;
+            settled[l] = false;
+
+            if (present && keepState && resume && samples.status()[index + l] != SampleBuffer::Uncomputed) {
+                //Converged samples keep their results; pending ones continue where they stopped
+                if (samples.status()[index + l] != SampleBuffer::Pending) {
+                    settled[l] = true;
+                    active[l] = 0;
+                    continue;
+                }
+
+                zr[l] = samples.zReal()[index + l];
+                zi[l] = samples.zImag()[index + l];
+                iterated[l] = samples.iterated()[index + l];
+                active[l] = iterated[l] < maxIters;
+
+                if (samples.hasChannels(SampleBuffer::OrbitTrap)) {
+                    trapSqr[l] = (double) samples.orbitTrap()[index + l] * (double) samples.orbitTrap()[index + l];
+                }
+            }
+
+            remaining += active[l];
+        }
+
+        while (remaining > 0) {
+            double pr[LANES];
+            double pi[LANES];
+            double dr[LANES];
+            double di[LANES];
+
+            //p(z) and p'(z) together by Horner's rule
+            for (int l = 0; l < LANES; l++) {
+                pr[l] = a.real[0];
+                pi[l] = a.imag[0];
+                dr[l] = 0.0;
+                di[l] = 0.0;
+            }
+
+            for (int k = 1; k <= a.degree; k++) {
+                for (int l = 0; l < LANES; l++) {
+                    double nextDr = dr[l] * zr[l] - di[l] * zi[l] + pr[l];
+                    double nextDi = dr[l] * zi[l] + di[l] * zr[l] + pi[l];
+                    double nextPr = pr[l] * zr[l] - pi[l] * zi[l] + a.real[k];
+                    double nextPi = pr[l] * zi[l] + pi[l] * zr[l] + a.imag[k];
+
+                    dr[l] = nextDr;
+                    di[l] = nextDi;
+                    pr[l] = nextPr;
+                    pi[l] = nextPi;
+                }
+            }
+
+            remaining = 0;
+
+            for (int l = 0; l < LANES; l++) {
+                //p / p' as (p * conj(p')) / |p'|^2
+                double denominator = std::max(dr[l] * dr[l] + di[l] * di[l], MIN_DERIVATIVE_SQR);
+                double qr = (pr[l] * dr[l] + pi[l] * di[l]) / denominator;
+                double qi = (pi[l] * dr[l] - pr[l] * di[l]) / denominator;
+
+                double nextZr = zr[l] - (a.relaxationReal * qr - a.relaxationImag * qi) + addC * cr[l];
+                double nextZi = zi[l] - (a.relaxationReal * qi + a.relaxationImag * qr) + addC * ci[l];
+                double deltaSqr = (nextZr - zr[l]) * (nextZr - zr[l]) + (nextZi - zi[l]) * (nextZi - zi[l]);
+                double magnitudeSqr = nextZr * nextZr + nextZi * nextZi;
+
+                bool run = active[l] != 0;
+                zr[l] = run ? nextZr : zr[l];
+                zi[l] = run ? nextZi : zi[l];
+                stepSqr[l] = run ? deltaSqr : stepSqr[l];
+                trapSqr[l] = run ? std::min(trapSqr[l], magnitudeSqr) : trapSqr[l];
+                iterated[l] += run;
+
+                bool done = run && deltaSqr < epsilonSqr;
+                converged[l] = done ? iterated[l] : converged[l];
+                active[l] = run && !done && iterated[l] < maxIters;
+                remaining += active[l];
+            }
+        }
+
+        int convergedCount = 0;
+
+        for (int l = 0; l < count; l++) {
+            if (settled[l]) {
+                continue;
+            }
+
+            std::size_t at = index + l;
+            convergedCount += converged[l] >= 0;
+
+            if (samples.hasChannels(SampleBuffer::Iterations)) {
+                samples.iterations()[at] = converged[l];
+            }
+
+            if (samples.hasChannels(SampleBuffer::SmoothIterations)) {
+                float smooth = -1.0f;
+
+                if (converged[l] >= 0) {
+                    //Newton's method converges quadratically, so the log of the step roughly doubles with every iteration
+                    double ratio = std::log(std::max(stepSqr[l], MIN_DERIVATIVE_SQR)) / std::log(epsilonSqr);
+                    smooth = (float) (converged[l] + 1 - std::min(std::log2(ratio), 1.0));
+                }
+
+                samples.smoothIterations()[at] = smooth;
+            }
+
+            if (samples.hasChannels(SampleBuffer::Magnitude)) {
+                samples.magnitude()[at] = (float) std::sqrt(zr[l] * zr[l] + zi[l] * zi[l]);
+            }
+
+            if (samples.hasChannels(SampleBuffer::OrbitTrap)) {
+                samples.orbitTrap()[at] = (float) std::sqrt(trapSqr[l]);
+            }
+
+            if (samples.hasChannels(SampleBuffer::Period)) {
+                int root = 0;
+
+                if (converged[l] >= 0) {
+                    root = newton ? nearestRoot(formula.roots(), std::complex<double>(zr[l], zi[l])) + 1 : 1;
+                }
+
+                samples.period()[at] = root;
+            }
+
+            if (keepState) {
+                samples.zReal()[at] = zr[l];
+                samples.zImag()[at] = zi[l];
+                samples.iterated()[at] = iterated[l];
+                samples.status()[at] = converged[l] >= 0 ? SampleBuffer::Escaped : SampleBuffer::Pending;
+            }
+        }
+
+        return convergedCount;
+    }
+
+    Coefficients splitCoefficients(const Formula& formula)
+    {
+        Coefficients a;
+        a.degree = formula.degree();
+
+        for (int k = 0; k <= a.degree; k++) {
+            a.real[k] = formula.coefficients()[k].real();
+            a.imag[k] = formula.coefficients()[k].imag();
+        }
+
+        a.relaxationReal = formula.relaxation().real();
+        a.relaxationImag = formula.relaxation().imag();
+
+        return a;
+    }
+}
+
+Formula::Formula() :
+    m_kind(Mandelbrot),
+    m_relaxation(1.0)
+{ }
+
+Formula::Formula(Kind kind, const std::vector<std::complex<double>>& coefficients, std::complex<double> relaxation) :
+    m_kind(kind),
+    m_coefficients(coefficients),
+    m_relaxation(relaxation)
+{
+    while (!m_coefficients.empty() && m_coefficients.front() == 0.0) {
+        m_coefficients.erase(m_coefficients.begin());
+    }
+
+    assert(kind == Mandelbrot || (degree() >= 1 && degree() <= MAX_DEGREE));
+
+    if (kind == Mandelbrot) {
+        m_coefficients.clear();
+    } else {
+        findRoots();
+    }
+}
+
+void Formula::findRoots()
+{
+    int n = degree();
+    std::vector<std::complex<double>> monic(n + 1);
+
+    for (int k = 0; k <= n; k++) {
+        monic[k] = m_coefficients[k] / m_coefficients[0];
+    }
+
+    //Durand-Kerner: every estimate moves towards a root, pushed away from the others
+    m_roots.resize(n);
+
+    for (int i = 0; i < n; i++) {
+        m_roots[i] = std::pow(std::complex<double>(0.4, 0.9), i);
+    }
+
+    for (int iteration = 0; iteration < ROOT_ITERATIONS; iteration++) {
+        double change = 0.0;
+
+        for (int i = 0; i < n; i++) {
+            std::complex<double> value = monic[0];
+            std::complex<double> product = 1.0;
+
+            for (int k = 1; k <= n; k++) {
+                value = value * m_roots[i] + monic[k];
+            }
+
+            for (int j = 0; j < n; j++) {
+                if (j != i) {
+                    product *= m_roots[i] - m_roots[j];
+                }
+            }
+
+            if (product == 0.0) {
+                product = ROOT_TOLERANCE;
+            }
+
+            std::complex<double> step = value / product;
+            m_roots[i] -= step;
+            change = std::max(change, std::abs(step));
+        }
+
+        if (change < ROOT_TOLERANCE) {
+            break;
+        }
+    }
+}
+
+bool Formula::operator==(const Formula& other) const
+{
+    return m_kind == other.m_kind && m_coefficients == other.m_coefficients && m_relaxation == other.m_relaxation;
+}
+
+bool Formula::realAxisSymmetric() const
+{
+    if (m_kind == Mandelbrot) {
+        return true;
+    }
+
+    if (m_kind == Newton || m_relaxation.imag() != 0.0) {
+        return false;
+    }
+
+    for (const std::complex<double>& coefficient : m_coefficients) {
+        if (coefficient.imag() != 0.0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Formula::parseCoefficients(const std::string& text, std::vector<std::complex<double>>& coefficients)
+{
+    std::istringstream stream(text);
+    std::complex<double> value;
+
+    coefficients.clear();
+
+    while (stream >> value) {
+        if (!std::isfinite(value.real()) || !std::isfinite(value.imag())) {
+            return false;
+        }
+
+        //Leading zeros do not raise the degree
+        if (!coefficients.empty() || value != 0.0) {
+            coefficients.push_back(value);
+        }
+    }
+
+    return stream.eof() && coefficients.size() >= 2 && (int) coefficients.size() <= MAX_DEGREE + 1;
+}
+
+std::string Formula::coefficientText() const
+{
+    std::ostringstream text;
+
+    for (std::size_t k = 0; k < m_coefficients.size(); k++) {
+        if (k > 0) {
+            text << " ";
+        }
+
+        if (m_coefficients[k].imag() == 0.0) {
+            text << m_coefficients[k].real();
+        } else {
+            text << m_coefficients[k];
+        }
+    }
+
+    return text.str();
+}
+
+int Formula::row(const double* reals, double imag, int count, int maxIters, SampleBuffer& samples, std::size_t index, bool resume) const
+{
+    assert(convergent());
+
+    Coefficients a = splitCoefficients(*this);
+    double imags[LANES];
+    int converged = 0;
+
+    std::fill(imags, imags + LANES, imag);
+
+    for (int x = 0; x < count; x += LANES) {
+        converged += convergeBlock(*this, a, reals + x, imags, std::min(LANES, count - x), maxIters, samples, index + x, resume);
+    }
+
+    return converged;
+}
+
+int Formula::points(const double* reals, const double* imags, int count, int maxIters, SampleBuffer& samples, std::size_t index) const
+{
+    assert(convergent());
+
+    Coefficients a = splitCoefficients(*this);
+    int converged = 0;
+
+    for (int i = 0; i < count; i += LANES) {
+        converged += convergeBlock(*this, a, reals + i, imags + i, std::min(LANES, count - i), maxIters, samples, index + i, false);
+    }
+
+    return converged;
+}
@@ -0,0 +1,77 @@
+#ifndef Formula_H
+#define Formula_H
+
+#include <complex>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class SampleBuffer;
+
+/*
+ * What is iterated for every point of the plane: the escape time of the
+ * Mandelbrot set, or one of the root finding families, which run until the
+ * orbit converges instead of until it escapes.
+ *
+ * Newton iterates z - a p(z) / p'(z) from z = c and records which root of p
+ * the orbit settles on. Nova iterates z - a p(z) / p'(z) + c from z = 1; its
+ * fixed points move with c, so only the convergence time is meaningful.
+ *
+ * The convergent kernels fill the same SampleBuffer channels as the escape
+ * time one: Iterations is the step at which the orbit converged, -1 if it did
+ * not within the limit, and Period holds the root it converged to counting
+ * from 1, which ColorScheme::ConvergedRoot maps to a band of the palette.
+ * Pending samples keep their state and are continued like escape time ones.
+ */
+class Formula
+{
+    public:
+        enum Kind
+        {
+            Mandelbrot,
+            Newton,
+            Nova
+        };
+
+        static const int MAX_DEGREE = 10;
+
+    private:
+        Kind m_kind;
+
+        //Highest degree first, without leading zeros
+        std::vector<std::complex<double>> m_coefficients;
+        std::complex<double> m_relaxation;
+        std::vector<std::complex<double>> m_roots;
+
+        void findRoots();
+
+    public:
+        Formula();
+        Formula(Kind kind, const std::vector<std::complex<double>>& coefficients, std::complex<double> relaxation = 1.0);
+
+        Kind kind() const                                               { return m_kind; }
+        bool convergent() const                                         { return m_kind != Mandelbrot; }
+        const std::vector<std::complex<double>>& coefficients() const   { return m_coefficients; }
+        std::complex<double> relaxation() const                         { return m_relaxation; }
+        const std::vector<std::complex<double>>& roots() const          { return m_roots; }
+        int degree() const                                              { return (int) m_coefficients.size() - 1; }
+
+        bool operator==(const Formula& other) const;
+
+        /*
+         * Whether the image is symmetric about the real axis sample for
+         * sample, so that rows can be mirrored. Newton images are only
+         * symmetric up to the numbering of the roots, so they never are.
+         */
+        bool realAxisSymmetric() const;
+
+        //Coefficients highest degree first as real numbers or (real,imaginary) pairs, separated by spaces
+        static bool parseCoefficients(const std::string& text, std::vector<std::complex<double>>& coefficients);
+        std::string coefficientText() const;
+
+        //Convergent formulas only; same contracts as EscapeTimeRowFunction and EscapeTimePointsFunction
+        int row(const double* reals, double imag, int count, int maxIters, SampleBuffer& samples, std::size_t index, bool resume) const;
+        int points(const double* reals, const double* imags, int count, int maxIters, SampleBuffer& samples, std::size_t index) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "FrameBudget.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //Weight of the newest measurement in the running estimates
+    const double SMOOTHING = 0.3;
+
+    //Thread startup and presentation, not covered by the per iteration cost
+    const double FRAME_OVERHEAD = 2.0;
+
+    const double MAX_DIVISOR = 8.0;
+    const double DEFAULT_DIVISOR = 4.0;
+    const int MIN_ITERATIONS = 64;
+
+    //Measurements this small are dominated by overhead and say nothing about throughput
+    const long long MIN_MEASURED_SAMPLES = 1024;
+}
+
+FrameBudget::FrameBudget(double targetMilliseconds) :
+    m_targetMilliseconds(targetMilliseconds),
+    m_msPerIteration(0.0),
+    m_escapedMeanIterations(0.0),
+    m_interiorFraction(0.0),
+    m_measured(false)
+{ }
+
+void FrameBudget::update(const RenderStats& stats)
+{
+    if (stats.samples < MIN_MEASURED_SAMPLES || stats.iterations <= 0) {
+        return;
+    }
+
+    double computeTime = std::max(stats.milliseconds - FRAME_OVERHEAD, 0.1);
+    double msPerIteration = computeTime / (double) stats.iterations;
+    double interiorFraction = (double) stats.interiorSamples / (double) stats.samples;
+    double escapedSamples = (double) (stats.samples - stats.interiorSamples);
+    double escapedIterations = (double) stats.iterations - (double) stats.interiorSamples * stats.maxIterations;
+    double escapedMean = escapedSamples > 0.0 ? escapedIterations / escapedSamples : 0.0;
+
+    if (!m_measured) {
+        m_msPerIteration = msPerIteration;
+        m_interiorFraction = interiorFraction;
+        m_escapedMeanIterations = escapedMean;
+        m_measured = true;
+        return;
+    }
+
+    m_msPerIteration += (msPerIteration - m_msPerIteration) * SMOOTHING;
+
+    //The view changes from frame to frame, so its model follows the latest frame more closely
+    m_interiorFraction += (interiorFraction - m_interiorFraction) * 0.5;
+    m_escapedMeanIterations += (escapedMean - m_escapedMeanIterations) * 0.5;
+}
+
+void FrameBudget::choose(int width, int height, int maxIterations, int& sketchWidth, int& sketchHeight, int& sketchIterations) const
+{
+    double divisor = DEFAULT_DIVISOR;
+    sketchIterations = maxIterations;
+
+    if (m_measured) {
+        double budget = std::max(m_targetMilliseconds - FRAME_OVERHEAD, 1.0);
+        double pixels = (double) width * (double) height;
+
+        double escapedMean = std::min(m_escapedMeanIterations, (double) maxIterations);
+        double iterationsPerSample = (1.0 - m_interiorFraction) * escapedMean + m_interiorFraction * maxIterations;
+        double affordableSamples = budget / (std::max(iterationsPerSample, 1.0) * m_msPerIteration);
+
+        divisor = std::sqrt(pixels / affordableSamples);
+
+        if (divisor > MAX_DIVISOR) {
+            //Even the coarsest sketch is too slow; trade interior depth for frame rate
+            divisor = MAX_DIVISOR;
+
+            double affordablePerSample = budget / (pixels / (MAX_DIVISOR * MAX_DIVISOR) * m_msPerIteration);
+
+            if (m_interiorFraction > 0.0) {
+                double limit = (affordablePerSample - (1.0 - m_interiorFraction) * escapedMean) / m_interiorFraction;
+                sketchIterations = std::max(std::min((int) limit, maxIterations), std::min(MIN_ITERATIONS, maxIterations));
+            }
+        }
+
+        divisor = std::max(divisor, 1.0);
+    }
+
+    sketchWidth = std::max((int) (width / divisor), 2);
+    sketchHeight = std::max((int) (height / divisor), 2);
+}
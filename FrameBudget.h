@@ -0,0 +1,34 @@
+#ifndef FrameBudget_H
+#define FrameBudget_H
+
+struct RenderStats;
+
+/*
+ * Picks the resolution and iteration limit of interactive sketches so they
+ * fit a frame time target. Each finished (or canceled) sketch updates a
+ * running estimate of the time per iteration and a model of the current
+ * view: the mean iteration count of escaping samples and the fraction of
+ * samples that never escape, which cost the full limit.
+ */
+class FrameBudget
+{
+    private:
+        double m_targetMilliseconds;
+        double m_msPerIteration;
+        double m_escapedMeanIterations;
+        double m_interiorFraction;
+        bool m_measured;
+
+    public:
+        FrameBudget(double targetMilliseconds = 16.0);
+
+        void setTarget(double targetMilliseconds) { m_targetMilliseconds = targetMilliseconds; }
+        double target() const { return m_targetMilliseconds; }
+
+        void update(const RenderStats& stats);
+
+        //Largest sketch of a width x height view, at most maxIterations deep, predicted to fit the target
+        void choose(int width, int height, int maxIterations, int& sketchWidth, int& sketchHeight, int& sketchIterations) const;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "FrameRing.h"
+#include "PageAllocator.h"
+
+#include <cassert>
+
+FrameRing::Frame::Frame() :
+    m_pixels(nullptr),
+    m_capacity(0),
+    m_lastUse(0)
+{ }
+
+FrameRing::Frame::~Frame()
+{
+    //The image must not outlive the pixels it points to
+    image = QImage();
+    PageAllocator::release(m_pixels, m_capacity);
+}
+
+FrameRing::FrameRing(int size) :
+    m_uses(0)
+{
+    assert(size > 0);
+
+    for (int i = 0; i < size; i++) {
+        m_frames.emplace_back(new Frame());
+    }
+}
+
+FrameRing::Frame* FrameRing::acquire(int width, int height, QImage::Format format, const Frame* keep)
+{
+    assert(format == QImage::Format_RGB32 || format == QImage::Format_ARGB32);
+    assert(keep == nullptr || m_frames.size() > 1);
+
+    std::size_t bytes = (std::size_t) width * (std::size_t) height * 4;
+    Frame* chosen = nullptr;
+
+    for (const std::unique_ptr<Frame>& frame : m_frames) {
+        if (frame.get() != keep && frame->image.width() == width && frame->image.height() == height && frame->image.format() == format) {
+            chosen = frame.get();
+            break;
+        }
+    }
+
+    if (chosen == nullptr) {
+        for (const std::unique_ptr<Frame>& frame : m_frames) {
+            if (frame.get() != keep && frame->m_capacity >= bytes && (chosen == nullptr || frame->m_capacity < chosen->m_capacity)) {
+                chosen = frame.get();
+            }
+        }
+    }
+
+    if (chosen == nullptr) {
+        for (const std::unique_ptr<Frame>& frame : m_frames) {
+            if (frame.get() != keep && (chosen == nullptr || frame->m_lastUse < chosen->m_lastUse)) {
+                chosen = frame.get();
+            }
+        }
+
+        //The old pixels go only once the new ones are there, so a failure leaves every frame as it was
+        unsigned char* pixels = (unsigned char*) PageAllocator::allocate(bytes);
+
+        if (pixels == nullptr && bytes > 0) {
+            return nullptr;
+        }
+
+        chosen->image = QImage();
+        PageAllocator::release(chosen->m_pixels, chosen->m_capacity);
+        chosen->m_pixels = pixels;
+        chosen->m_capacity = pixels != nullptr ? bytes : 0;
+    }
+
+    if (chosen->image.width() != width || chosen->image.height() != height || chosen->image.format() != format) {
+        chosen->image = QImage(chosen->m_pixels, width, height, width * 4, format);
+    }
+
+    chosen->m_lastUse = ++m_uses;
+    return chosen;
+}
@@ -0,0 +1,62 @@
+#ifndef FrameRing_H
+#define FrameRing_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <QImage>
+
+#include "SampleBuffer.h"
+
+/*
+ * A few reusable frames, each an image and the samples it is rendered from.
+ * Interactive sketches and full renders alternate at mouse move rates with
+ * different sizes; handing each render a frame that already has room for it
+ * saves reallocating and faulting in large buffers every time. Image pixels
+ * come from PageAllocator and are not cleared between renders.
+ */
+class FrameRing
+{
+    public:
+        class Frame
+        {
+            friend class FrameRing;
+
+            private:
+                unsigned char* m_pixels;
+                std::size_t m_capacity;
+                unsigned long m_lastUse;
+
+                Frame(const Frame&);
+                Frame& operator=(const Frame&);
+
+            public:
+                Frame();
+                ~Frame();
+
+                //A view of the frame's pixels, valid until the frame is acquired again
+                QImage image;
+                SampleBuffer samples;
+        };
+
+    private:
+        std::vector<std::unique_ptr<Frame>> m_frames;
+        unsigned long m_uses;
+
+    public:
+        explicit FrameRing(int size = 2);
+
+        /*
+         * A frame whose image is width x height in the given 32 bit format,
+         * holding whatever the frame last contained. Prefers a frame of the
+         * same size, then the smallest one with room for it; only when none
+         * has room is the least recently used frame reallocated. Never hands
+         * out keep, so that its contents can be copied into the new frame.
+         * Returns null, with all frames untouched, if there is not enough
+         * memory for a new one.
+         */
+        Frame* acquire(int width, int height, QImage::Format format, const Frame* keep = nullptr);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "IterationCodec.h"
+
+#include <cstdint>
+
+namespace
+{
+    void writeVarint(std::uint64_t value, std::vector<unsigned char>& out)
+    {
+        while (value >= 0x80) {
+            out.push_back((unsigned char) (value | 0x80));
+            value >>= 7;
+        }
+
+        out.push_back((unsigned char) value);
+    }
+
+    bool readVarint(const unsigned char*& data, const unsigned char* end, std::uint64_t& value)
+    {
+        value = 0;
+
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (data == end) {
+                return false;
+            }
+
+            unsigned char byte = *data++;
+            value |= (std::uint64_t) (byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::uint64_t zigzag(std::int64_t value)
+    {
+        return ((std::uint64_t) value << 1) ^ (std::uint64_t) (value >> 63);
+    }
+
+    std::int64_t unzigzag(std::uint64_t value)
+    {
+        return (std::int64_t) (value >> 1) ^ -(std::int64_t) (value & 1);
+    }
+}
+
+void IterationCodec::compress(const int* values, std::size_t count, std::vector<unsigned char>& out)
+{
+    out.clear();
+
+    std::int64_t previous = 0;
+    std::size_t i = 0;
+
+    while (i < count) {
+        int value = values[i];
+        std::size_t run = 1;
+
+        while (i + run < count && values[i + run] == value) {
+            run++;
+        }
+
+        writeVarint(zigzag((std::int64_t) value - previous), out);
+        writeVarint(run - 1, out);
+
+        previous = value;
+        i += run;
+    }
+}
+
+bool IterationCodec::decompress(const unsigned char* data, std::size_t size, int* values, std::size_t count)
+{
+    const unsigned char* end = data + size;
+    std::int64_t previous = 0;
+    std::size_t i = 0;
+
+    while (data != end) {
+        std::uint64_t delta;
+        std::uint64_t run;
+
+        if (!readVarint(data, end, delta) || !readVarint(data, end, run)) {
+            return false;
+        }
+
+        if (run >= count - i) {
+            return false;
+        }
+
+        int value = (int) (previous + unzigzag(delta));
+
+        for (std::uint64_t r = 0; r <= run; r++) {
+            values[i++] = value;
+        }
+
+        previous = value;
+    }
+
+    return i == count;
+}
@@ -0,0 +1,21 @@
+#ifndef IterationCodec_H
+#define IterationCodec_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Lossless compression for planes of iteration counts. Neighbouring samples
+ * mostly share an escape band, so the data is stored as runs of equal values,
+ * each run as the zigzag varint difference to the previous run's value
+ * followed by a varint run length.
+ */
+namespace IterationCodec
+{
+    void compress(const int* values, std::size_t count, std::vector<unsigned char>& out);
+
+    //Returns false if the data is malformed or does not decode to exactly count values
+    bool decompress(const unsigned char* data, std::size_t size, int* values, std::size_t count);
+}
+
+#endif
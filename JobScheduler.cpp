@@ -0,0 +1,197 @@
+#include "JobScheduler.h"
+#include "Topology.h"
+#include "Trace.h"
+
+#include <cassert>
+
+JobScheduler::JobScheduler(int threads) :
+    m_stopping(false)
+{
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        m_waitingTiles[p] = 0;
+    }
+
+    reserve(threads > 0 ? threads : Topology::defaultWorkerCount());
+    m_laneThread = std::thread(&JobScheduler::threadLoop, this, Preview, Preview);
+}
+
+JobScheduler::~JobScheduler()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_workAvailable.notify_all();
+    }
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+
+    m_laneThread.join();
+}
+
+JobScheduler& JobScheduler::shared()
+{
+    static JobScheduler scheduler;
+    return scheduler;
+}
+
+void JobScheduler::reserve(int threads)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while ((int) m_threads.size() < threads) {
+        m_threads.emplace_back(&JobScheduler::threadLoop, this, Interactive, (Priority) (PRIORITY_COUNT - 1));
+    }
+}
+
+int JobScheduler::threadCount()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_threads.size();
+}
+
+JobScheduler::JobHandle JobScheduler::submit(Priority priority, int tiles, const TileFunction& run)
+{
+    assert(priority >= 0 && priority < PRIORITY_COUNT);
+    assert(tiles >= 0);
+
+    JobHandle job(new Job());
+    job->priority = priority;
+    job->run = run;
+    job->tiles = tiles;
+    job->nextTile = 0;
+    job->running = 0;
+    job->finished = 0;
+    job->canceled = false;
+    job->queued = true;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queues[priority].push_back(job);
+    m_waitingTiles[priority] += tiles;
+    m_workAvailable.notify_all();
+
+    return job;
+}
+
+void JobScheduler::cancel(const JobHandle& job)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (job->canceled) {
+        return;
+    }
+
+    //The job stays in its queue until a thread finds it has nothing left
+    m_waitingTiles[job->priority] -= (int) job->yielded.size() + job->tiles - job->nextTile;
+    job->canceled = true;
+    job->yielded.clear();
+    job->nextTile = job->tiles;
+    job->done.notify_all();
+}
+
+bool JobScheduler::wait(const JobHandle& job)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    job->done.wait(lock, [&job]() {
+        return job->running == 0 && !hasWork(*job);
+    });
+
+    return job->finished == job->tiles;
+}
+
+bool JobScheduler::preempted(Priority priority) const
+{
+    //Previews have the lane to themselves and never hold up pool threads
+    for (int p = Interactive; p < priority; p++) {
+        if (m_waitingTiles[p].load(std::memory_order_relaxed) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobScheduler::hasWork(const Job& job)
+{
+    return !job.canceled && (!job.yielded.empty() || job.nextTile < job.tiles);
+}
+
+bool JobScheduler::takeTile(JobHandle& job, int& tile, Priority highest, Priority lowest)
+{
+    for (int p = highest; p <= lowest; p++) {
+        std::deque<JobHandle>& queue = m_queues[p];
+
+        while (!queue.empty()) {
+            job = queue.front();
+            queue.pop_front();
+
+            if (!hasWork(*job)) {
+                job->queued = false;
+                continue;
+            }
+
+            //Tiles that made way for others go first, so their partial results do not pile up
+            if (!job->yielded.empty()) {
+                tile = job->yielded.front();
+                job->yielded.pop_front();
+            } else {
+                tile = job->nextTile++;
+            }
+
+            //Jobs of a class take turns one tile at a time
+            if (hasWork(*job)) {
+                queue.push_back(job);
+            } else {
+                job->queued = false;
+            }
+
+            job->running++;
+            m_waitingTiles[p]--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobScheduler::threadLoop(Priority highest, Priority lowest)
+{
+    Trace::nameThread(highest == Preview ? "preview lane" : "render pool");
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopping) {
+        JobHandle job;
+        int tile;
+
+        if (!takeTile(job, tile, highest, lowest)) {
+            m_workAvailable.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        bool finished = job->run(tile);
+        lock.lock();
+
+        job->running--;
+
+        if (finished) {
+            job->finished++;
+        } else if (!job->canceled) {
+            job->yielded.push_back(tile);
+            m_waitingTiles[job->priority]++;
+
+            if (!job->queued) {
+                m_queues[job->priority].push_back(job);
+                job->queued = true;
+            }
+
+            //The thread woken has to be one that takes this class
+            m_workAvailable.notify_all();
+        }
+
+        job->done.notify_all();
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef JobScheduler_H
+#define JobScheduler_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * One pool of render threads shared by every job in the process. A job is a
+ * number of tiles, run in any order by whichever pool threads are free.
+ * Threads always take a tile of the most urgent class that has any waiting;
+ * jobs of the same class take turns tile by tile, so none of them starves the
+ * others. A tile that is already running is never interrupted, but a long
+ * one can poll preempted() and return early; it is then queued again and
+ * picks up where it stopped the next time it runs.
+ *
+ * Render passes hold their threads for a whole pass, so besides the pool
+ * there is one lane thread that only ever runs Preview tiles, and the pool
+ * threads never do. Previews then start within one tile of being submitted
+ * however busy the pool is, and since they are kept to a few milliseconds
+ * per tile the lane costs the other jobs little.
+ */
+class JobScheduler
+{
+    public:
+        enum Priority
+        {
+            //Small views that follow the mouse, such as the Julia inset; tiles must be short
+            Preview,
+            //The view on screen: renders, refinement, orbit densities
+            Interactive,
+            //Exports, which may take minutes and can wait for everything else
+            Background,
+
+            PRIORITY_COUNT
+        };
+
+        //Runs one tile; returns false if it stopped early for more urgent work and has to be called again for the same tile
+        typedef std::function<bool(int tile)> TileFunction;
+
+    private:
+        struct Job
+        {
+            Priority priority;
+            TileFunction run;
+            int tiles;
+            int nextTile;
+            std::deque<int> yielded;
+            int running;
+            int finished;
+            bool canceled;
+            bool queued;
+            std::condition_variable done;
+        };
+
+    public:
+        typedef std::shared_ptr<Job> JobHandle;
+
+    private:
+        std::vector<std::thread> m_threads;
+        std::thread m_laneThread;
+        std::mutex m_mutex;
+        std::condition_variable m_workAvailable;
+        std::deque<JobHandle> m_queues[PRIORITY_COUNT];
+        std::atomic<int> m_waitingTiles[PRIORITY_COUNT];
+        bool m_stopping;
+
+        JobScheduler(const JobScheduler&);
+        JobScheduler& operator=(const JobScheduler&);
+
+        static bool hasWork(const Job& job);
+        //Only classes from highest to lowest are taken
+        bool takeTile(JobHandle& job, int& tile, Priority highest, Priority lowest);
+        void threadLoop(Priority highest, Priority lowest);
+
+    public:
+        //0 threads derives the count from CPU affinity and cgroup quota
+        explicit JobScheduler(int threads = 0);
+
+        //Jobs must have ended by now
+        ~JobScheduler();
+
+        //The pool everything renders on
+        static JobScheduler& shared();
+
+        //Grows the pool to at least this many threads, for jobs that were asked to use more; the lane thread is not counted
+        void reserve(int threads);
+        int threadCount();
+
+        JobHandle submit(Priority priority, int tiles, const TileFunction& run);
+
+        //Tiles that have not started are dropped; running ones still finish or yield
+        void cancel(const JobHandle& job);
+
+        //Blocks until no tile of the job is left to run; true if every tile finished
+        bool wait(const JobHandle& job);
+
+        //Whether tiles of a more urgent class than priority are waiting for a pool thread; Preview never counts. Cheap enough to poll per row
+        bool preempted(Priority priority) const;
+};
+
+#endif
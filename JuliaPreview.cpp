@@ -0,0 +1,298 @@
+#include "JuliaPreview.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    //Longest a slice may keep the lane, and the time target of the first sketch of a point
+    const double FRAME_BUDGET = 8.0;
+
+    //Width of the plane shown; every Julia set of a point in the Mandelbrot set fits within |z| <= 2
+    const double VIEW_WIDTH = 4.0;
+
+    //Coarsest sketch, as pixels per sample along each axis
+    const int MAX_BLOCK = 8;
+
+    //Samples computed between looks at the clock and the point; a slice overruns its budget by at most this many
+    const int COLUMN_CHUNK = 16;
+}
+
+JuliaPreview::JuliaPreview(int width, int height, QObject* parent) :
+    QObject(parent),
+    m_width(width),
+    m_height(height),
+    m_cReal(0.0),
+    m_cImag(0.0),
+    m_colors(ColorScheme::Fire),
+    m_coloring(ColorScheme::IterationCount),
+    m_maxIterations(256),
+    m_generation(0),
+    m_frameGeneration(-1),
+    m_frameReal(0.0),
+    m_frameImag(0.0),
+    m_block(1),
+    m_iterations(0),
+    m_nextRow(0),
+    m_nextColumn(0),
+    m_sketch(false),
+    m_sketchStats(),
+    m_work(),
+    m_computeRow(nullptr),
+    m_frameColoring(ColorScheme::IterationCount),
+    m_colorTable(),
+    m_samples(),
+    m_image(),
+    m_budget(FRAME_BUDGET),
+    m_job(),
+    m_busy(false),
+    m_stopping(false)
+{ }
+
+JuliaPreview::~JuliaPreview()
+{
+    JobScheduler::JobHandle job;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        job = m_job;
+    }
+
+    //A slice that sees m_stopping submits no other, so the last one submitted is the only one to wait for
+    if (job) {
+        JobScheduler::shared().wait(job);
+    }
+}
+
+void JuliaPreview::show(double cReal, double cImag)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cReal = cReal;
+    m_cImag = cImag;
+    m_generation++;
+
+    schedule();
+}
+
+void JuliaPreview::setColors(const ColorScheme& colors, ColorScheme::Coloring coloring, int maxIterations)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_colors = colors;
+    m_coloring = coloring;
+    m_maxIterations = maxIterations;
+    m_generation++;
+
+    //Only redraw a point that has been shown already
+    if (m_frameGeneration >= 0) {
+        schedule();
+    }
+}
+
+QImage JuliaPreview::image()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_image;
+}
+
+void JuliaPreview::schedule()
+{
+    //Called with m_mutex held; one slice at a time, which picks up the newest point when it starts
+    if (m_busy || m_stopping) {
+        return;
+    }
+
+    m_busy = true;
+    m_job = JobScheduler::shared().submit(JobScheduler::Preview, 1, [this](int) {
+        slice();
+        return true;
+    });
+}
+
+bool JuliaPreview::startFrame()
+{
+    m_frameGeneration = m_generation;
+    m_frameReal = m_cReal;
+    m_frameImag = m_cImag;
+    m_frameColoring = m_coloring;
+    m_sketch = true;
+    m_sketchStats = RenderStats();
+
+    if (m_work.width() != m_width || m_work.height() != m_height) {
+        m_work = QImage(m_width, m_height, QImage::Format_RGB32);
+    }
+
+    //The period is always found, so that interior samples stop at their cycle instead of the iteration limit
+    unsigned int channels = ColorScheme::channels(m_coloring) | SampleBuffer::Period;
+    m_computeRow = juliaRow(channels);
+
+    if (!m_samples.reset(m_width, 1, channels)) {
+        return false;
+    }
+
+    m_reals.resize(m_width);
+    m_indices.resize(m_width);
+    m_red.resize(m_width);
+    m_green.resize(m_width);
+    m_blue.resize(m_width);
+
+    //The budget only offers a size, so the sketch takes the smallest block that gets within it
+    int sketchWidth, sketchHeight, sketchIterations;
+    m_budget.choose(m_width, m_height, m_maxIterations, sketchWidth, sketchHeight, sketchIterations);
+
+    int block = 1;
+
+    while (block < MAX_BLOCK && m_width / block > sketchWidth) {
+        block *= 2;
+    }
+
+    startLevel(block, sketchIterations);
+    return true;
+}
+
+void JuliaPreview::startLevel(int block, int iterations)
+{
+    m_block = block;
+    m_iterations = iterations;
+    m_nextRow = 0;
+    m_nextColumn = 0;
+    m_colorTable.reset(new ColorTable(m_colors, iterations));
+}
+
+void JuliaPreview::computeSamples(int y, int first, int last, double cReal, double cImag, int block, int iterations, RenderStats& stats)
+{
+    double scale = VIEW_WIDTH / (double) m_width;
+
+    //Each sample sits in the middle of its block and colors all of it
+    for (int x = first; x < last; x++) {
+        m_reals[x] = ((double) (x * block) + block * 0.5 - m_width * 0.5) * scale;
+    }
+
+    double imag = ((double) (y * block) + block * 0.5 - m_height * 0.5) * scale;
+    m_computeRow(m_reals.data() + first, imag, last - first, cReal, cImag, iterations, 2.0, m_samples, first);
+
+    const int* rowIterations = m_samples.iterations();
+
+    for (int x = first; x < last; x++) {
+        if (rowIterations[x] >= 0) {
+            stats.iterations += rowIterations[x];
+        } else {
+            stats.iterations += iterations;
+            stats.interiorSamples++;
+        }
+    }
+
+    stats.samples += last - first;
+}
+
+void JuliaPreview::drawRow(int y, int block, int iterations)
+{
+    int count = (m_width + block - 1) / block;
+
+    ColorScheme::indices(m_frameColoring, m_samples, 0, count, iterations, m_indices.data());
+    m_colorTable->lookup(m_indices.data(), count, m_red.data(), m_green.data(), m_blue.data());
+
+    int lastLine = std::min((y + 1) * block, m_height);
+
+    for (int py = y * block; py < lastLine; py++) {
+        QRgb* line = (QRgb*) m_work.scanLine(py);
+
+        for (int px = 0; px < m_width; px++) {
+            int x = px / block;
+            line[px] = qRgb(m_red[x], m_green[x], m_blue[x]);
+        }
+    }
+}
+
+void JuliaPreview::slice()
+{
+    Trace::Span span("julia preview");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::microseconds((long long) (FRAME_BUDGET * 1000.0));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    //Without memory for a row there is nothing to draw until the next point
+    if (m_frameGeneration != m_generation && !startFrame()) {
+        m_busy = false;
+        return;
+    }
+
+    int generation = m_frameGeneration;
+    double cReal = m_frameReal;
+    double cImag = m_frameImag;
+    int block = m_block;
+    int iterations = m_iterations;
+    int rows = (m_height + block - 1) / block;
+    int columns = (m_width + block - 1) / block;
+    int y = m_nextRow;
+    int x = m_nextColumn;
+
+    lock.unlock();
+
+    //Always at least one chunk, so that a level finishes even if a chunk takes longer than the budget
+    RenderStats stats;
+
+    do {
+        int last = std::min(x + COLUMN_CHUNK, columns);
+        computeSamples(y, x, last, cReal, cImag, block, iterations, stats);
+        x = last;
+
+        if (x == columns) {
+            drawRow(y, block, iterations);
+            y++;
+            x = 0;
+        }
+    } while (y < rows && m_generation == generation && std::chrono::steady_clock::now() < deadline);
+
+    lock.lock();
+
+    bool levelDone = false;
+    bool refined = false;
+
+    if (generation == m_generation && !m_stopping) {
+        m_nextRow = y;
+        m_nextColumn = x;
+
+        if (m_sketch) {
+            m_sketchStats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            m_sketchStats.samples += stats.samples;
+            m_sketchStats.iterations += stats.iterations;
+            m_sketchStats.interiorSamples += stats.interiorSamples;
+        }
+
+        if (y == rows) {
+            levelDone = true;
+            m_image = m_work;
+
+            if (m_sketch) {
+                m_sketchStats.maxIterations = iterations;
+                m_budget.update(m_sketchStats);
+                m_sketch = false;
+            }
+
+            //Nothing is left to refine until the point changes
+            refined = block == 1 && iterations >= m_maxIterations;
+
+            if (!refined) {
+                startLevel(std::max(block / 2, 1), m_maxIterations);
+            }
+        }
+    }
+
+    m_busy = false;
+
+    if (!refined) {
+        schedule();
+    }
+
+    lock.unlock();
+
+    if (levelDone) {
+        emit frameReady();
+    }
+}
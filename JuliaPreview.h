@@ -0,0 +1,103 @@
+#ifndef JuliaPreview_H
+#define JuliaPreview_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QObject>
+#include <QImage>
+
+#include "ColorScheme.h"
+#include "ColorTable.h"
+#include "EscapeTime.h"
+#include "FrameBudget.h"
+#include "JobScheduler.h"
+#include "RenderStats.h"
+#include "SampleBuffer.h"
+
+/*
+ * Renders the Julia set of a point of the plane into a small image, for the
+ * inset that follows the mouse. Work runs on the scheduler's Preview lane,
+ * one slice at a time, in chunks of a few samples of a row; a slice stops at
+ * the first chunk boundary past the frame budget, and moving to another point
+ * abandons the frame in progress there too. Interior samples end at their
+ * orbit's cycle rather than the iteration limit, so no chunk runs long.
+ * Each point is first drawn as a sketch sized by a FrameBudget, then,
+ * while it stays put, refined level by level up to full resolution and the
+ * full iteration limit. frameReady() is emitted from the lane whenever a
+ * level is complete.
+ */
+class JuliaPreview : public QObject
+{
+    Q_OBJECT
+
+    private:
+        int m_width;
+        int m_height;
+
+        std::mutex m_mutex;
+
+        //What to draw; changing any of it starts a new frame
+        double m_cReal;
+        double m_cImag;
+        ColorScheme m_colors;
+        ColorScheme::Coloring m_coloring;
+        int m_maxIterations;
+        std::atomic<int> m_generation;
+
+        //The frame in progress: its level, as the size of the pixel blocks that share a sample, and how far it got
+        int m_frameGeneration;
+        double m_frameReal;
+        double m_frameImag;
+        int m_block;
+        int m_iterations;
+        int m_nextRow;
+        int m_nextColumn;
+        bool m_sketch;
+        RenderStats m_sketchStats;
+        QImage m_work;
+
+        //Scratch space set up for each frame; m_samples carries a partly computed row from one slice to the next
+        JuliaRowFunction m_computeRow;
+        ColorScheme::Coloring m_frameColoring;
+        std::unique_ptr<ColorTable> m_colorTable;
+        SampleBuffer m_samples;
+        std::vector<double> m_reals;
+        std::vector<float> m_indices;
+        std::vector<unsigned char> m_red;
+        std::vector<unsigned char> m_green;
+        std::vector<unsigned char> m_blue;
+
+        QImage m_image;
+        FrameBudget m_budget;
+        JobScheduler::JobHandle m_job;
+        bool m_busy;
+        bool m_stopping;
+
+        void schedule();
+        void slice();
+        bool startFrame();
+        void startLevel(int block, int iterations);
+        void computeSamples(int y, int first, int last, double cReal, double cImag, int block, int iterations, RenderStats& stats);
+        void drawRow(int y, int block, int iterations);
+
+    public:
+        JuliaPreview(int width, int height, QObject* parent = nullptr);
+
+        //Waits for the slice in progress, if any
+        virtual ~JuliaPreview();
+
+        //Starts drawing the Julia set of c
+        void show(double cReal, double cImag);
+        void setColors(const ColorScheme& colors, ColorScheme::Coloring coloring, int maxIterations);
+
+        //The last completed level
+        QImage image();
+
+    signals:
+        void frameReady();
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <thread>
 #include <complex>
+#include <algorithm>
 
 #include <KApplication>
 #include <KAction>
@@ -11,6 +12,11 @@
 #include <KStatusBar>
 #include <KToolBar>
 #include <KLocale>
+#include <KConfigGroup>
+#include <KGlobal>
+#include <KFileDialog>
+#include <KMessageBox>
+#include <KInputDialog>
 
 #include <QSignalMapper>
 #include <QProgressBar>
@@ -18,10 +24,38 @@
 #include <QTimer>
 #include <QImage>
 #include <QPixmap>
+#include <QStringList>
 
 #include "Wrapper.h"
 #include "RenderParams.h"
 #include "Canvas.h"
+#include "TileCoordinator.h"
+#include "ColorTable.h"
+#include "Downsampler.h"
+#include "TileImage.h"
+#include "TilePyramid.h"
+#include "PageAllocator.h"
+#include "Trace.h"
+
+namespace
+{
+    const int EXPORT_BAND_ROWS = 32;
+
+    //How often the status bar shows the progress of a render
+    const int PROGRESS_INTERVAL = 100;
+
+    //Render mode menu entry for escape time renders; the others are DensityBuffer modes
+    const int ESCAPE_TIME_MODE = -1;
+
+    //Render mode menu entries for raymarched views start here, offset by Raymarcher::Fractal
+    const int RAYMARCH_MODE = 100;
+
+    //Formula menu entries, indexed by Formula::Kind
+    const char* const FORMULA_ACTIONS[] = { "actionFormulaMandelbrot", "actionFormulaNewton", "actionFormulaNova" };
+
+    //Offered for a new root finding formula: z^3 - 1
+    const char* const DEFAULT_COEFFICIENTS = "1 0 0 -1";
+}
 
 MainWindow::MainWindow(QWidget* parent) :
     KXmlGuiWindow(parent),
@@ -29,9 +63,35 @@ MainWindow::MainWindow(QWidget* parent) :
     m_colorScheme(ColorScheme::Grey),
     m_zoomRegion(ZoomRegion(-2, -1, 1, 1)),
     m_canvas(nullptr),
-    m_progressBar(nullptr)
+    m_progressBar(nullptr),
+    m_progressTimer(nullptr),
+    m_exportThread(nullptr),
+    m_exportCanceled(false),
+    m_exportCoordinator(nullptr)
 {
     this->setupWidgets();
+
+    KConfigGroup config(KGlobal::config(), "Rendering");
+    m_canvas->backgroundWorker()->setNumaAware(config.readEntry("NumaAware", false));
+    m_canvas->setWorkerLimits(config.readEntry("Threads", 0), config.readEntry("Niceness", 0));
+    m_canvas->setFrameTimeTarget(config.readEntry("FrameTime", 16.0));
+    m_canvas->setProgressive(config.readEntry("Progressive", true));
+
+    //Huge pages for frame and sample buffers: "off", "transparent" or "explicit" (needs a hugetlbfs pool)
+    QString hugePages = config.readEntry("HugePages", QString("transparent"));
+
+    if (hugePages == "off") {
+        PageAllocator::setMode(PageAllocator::NormalPages);
+    } else if (hugePages == "explicit") {
+        PageAllocator::setMode(PageAllocator::ExplicitHugePages);
+    } else {
+        PageAllocator::setMode(PageAllocator::TransparentHugePages);
+    }
+
+    //Memory for the samples of previous views, in MiB
+    KConfigGroup navigation(KGlobal::config(), "Navigation");
+    m_canvas->setHistoryMemory((std::size_t) navigation.readEntry("HistoryMemory", 256) * 1024 * 1024);
+
     this->setupActions();
     this->setupGUI(Default, "fractal-viewerui.rc");
 
@@ -39,11 +99,20 @@ MainWindow::MainWindow(QWidget* parent) :
 
     connect(m_canvas, SIGNAL(rendering()), this, SLOT(previewStart()));
     connect(m_canvas->backgroundWorker(), SIGNAL(taskComplete(bool)), this, SLOT(previewComplete(bool)));
-    connect(m_canvas->backgroundWorker(), SIGNAL(progressUpdate(int)), m_progressBar, SLOT(setValue(int)));
+    connect(m_progressTimer, SIGNAL(timeout()), this, SLOT(updateProgress()));
+    connect(this, SIGNAL(exportProgress(int)), m_progressBar, SLOT(setValue(int)), Qt::QueuedConnection);
+    connect(this, SIGNAL(exportDone(bool)), this, SLOT(exportComplete(bool)), Qt::QueuedConnection);
 }
 
 MainWindow::~MainWindow()
 {
+    if (m_exportThread != nullptr) {
+        m_exportCanceled = true;
+        m_exportThread->join();
+        delete m_exportThread;
+    }
+
+    delete m_exportCoordinator;
 }
 
 void MainWindow::setupWidgets()
@@ -56,6 +125,10 @@ void MainWindow::setupWidgets()
     m_progressBar->setVisible(false);
     this->statusBar()->addPermanentWidget(m_progressBar, 0);
 
+    //Render threads only count their work; it is picked up from here at a fixed rate
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(PROGRESS_INTERVAL);
+
     this->statusBar()->showMessage("Test");
     this->statusBar()->setSizeGripEnabled(true);
 
@@ -66,15 +139,29 @@ void MainWindow::setupWidgets()
 void MainWindow::setupActions()
 {
     KAction* actionQuit = KStandardAction::quit(kapp, SLOT(quit()), this->actionCollection());
+    KAction* actionOpen = KStandardAction::open(this, SLOT(open()), this->actionCollection());
+    actionOpen->setStatusTip("Opens a saved view, along with its render if one was stored.");
     KAction* actionSaveAs = KStandardAction::saveAs(this, SLOT(saveAs()), this->actionCollection());
     actionSaveAs->setStatusTip("Saves parameters to a file for later viewing.");
 
+    KAction* actionBack = KStandardAction::back(m_canvas, SLOT(back()), this->actionCollection());
+    actionBack->setStatusTip("Returns to the previous view.");
+    KAction* actionForward = KStandardAction::forward(m_canvas, SLOT(forward()), this->actionCollection());
+    actionForward->setStatusTip("Goes forward to the next view.");
+
     KAction* actionRender = new KAction(this);
     actionRender->setText(i18n("&Render"));
     actionRender->setIcon(KIcon ("document-save"));
     actionRender->setShortcut(Qt::CTRL + Qt::Key_R);
     actionRender->setStatusTip("Renders the fractal with the current parameters to an image file.");
     this->actionCollection()->addAction("actionRender", actionRender);
+    connect(actionRender, SIGNAL(triggered(bool)), this, SLOT(render()));
+
+    KAction* actionExportPyramid = new KAction(this);
+    actionExportPyramid->setText(i18n("Export Tile &Pyramid..."));
+    actionExportPyramid->setStatusTip("Renders the current view as a Deep Zoom tile pyramid for web viewers.");
+    this->actionCollection()->addAction("actionExportPyramid", actionExportPyramid);
+    connect(actionExportPyramid, SIGNAL(triggered(bool)), this, SLOT(exportPyramid()));
 
     KAction* actionStop = new KAction(this);
     actionStop->setText(i18n("&Stop"));
@@ -84,6 +171,20 @@ void MainWindow::setupActions()
     this->actionCollection()->addAction("actionStop", actionStop);
     connect(actionStop, SIGNAL(triggered(bool)), this, SLOT(stop()));
 
+    KAction* actionRecordTrace = new KAction(this);
+    actionRecordTrace->setText(i18n("Record &Timeline"));
+    actionRecordTrace->setCheckable(true);
+    actionRecordTrace->setChecked(Trace::enabled());
+    actionRecordTrace->setStatusTip("Records what every render thread spends its time on.");
+    this->actionCollection()->addAction("actionRecordTrace", actionRecordTrace);
+    connect(actionRecordTrace, SIGNAL(triggered(bool)), this, SLOT(changeTracing(bool)));
+
+    KAction* actionSaveTrace = new KAction(this);
+    actionSaveTrace->setText(i18n("Save Time&line..."));
+    actionSaveTrace->setStatusTip("Saves the recorded timeline for chrome://tracing or Perfetto.");
+    this->actionCollection()->addAction("actionSaveTrace", actionSaveTrace);
+    connect(actionSaveTrace, SIGNAL(triggered(bool)), this, SLOT(saveTrace()));
+
     KAction* actionZoomIn = new KAction(this);
     actionZoomIn->setText(i18n("Zoom &In"));
     actionZoomIn->setIcon(KIcon ("zoom-in"));
@@ -103,6 +204,45 @@ void MainWindow::setupActions()
     this->actionCollection()->addAction("actionZoomReset", actionZoomReset);
     this->connect(actionZoomReset, SIGNAL(triggered(bool)), this, SLOT(zoomReset()));
 
+    KAction* actionMoreIterations = new KAction(this);
+    actionMoreIterations->setText(i18n("&More Iterations"));
+    actionMoreIterations->setShortcut(Qt::CTRL + Qt::Key_I);
+    actionMoreIterations->setStatusTip("Doubles the iteration limit, continuing only the points that have not escaped yet.");
+    this->actionCollection()->addAction("actionMoreIterations", actionMoreIterations);
+    this->connect(actionMoreIterations, SIGNAL(triggered(bool)), this, SLOT(moreIterations()));
+
+    KAction* actionFewerIterations = new KAction(this);
+    actionFewerIterations->setText(i18n("&Fewer Iterations"));
+    actionFewerIterations->setShortcut(Qt::CTRL + Qt::SHIFT + Qt::Key_I);
+    actionFewerIterations->setStatusTip("Halves the iteration limit.");
+    this->actionCollection()->addAction("actionFewerIterations", actionFewerIterations);
+    this->connect(actionFewerIterations, SIGNAL(triggered(bool)), this, SLOT(fewerIterations()));
+
+    KAction* actionAutoIterations = new KAction(this);
+    actionAutoIterations->setText(i18n("&Automatic Iterations"));
+    actionAutoIterations->setCheckable(true);
+    actionAutoIterations->setChecked(m_canvas->autoIterations());
+    actionAutoIterations->setStatusTip("Keeps raising the iteration limit while it still reveals detail.");
+    this->actionCollection()->addAction("actionAutoIterations", actionAutoIterations);
+    this->connect(actionAutoIterations, SIGNAL(triggered(bool)), this, SLOT(changeAutoIterations(bool)));
+
+    KAction* actionProgressive = new KAction(this);
+    actionProgressive->setText(i18n("&Progressive Refinement"));
+    actionProgressive->setCheckable(true);
+    actionProgressive->setChecked(m_canvas->progressive());
+    actionProgressive->setStatusTip("Keeps adding samples to a finished image while the view is idle.");
+    this->actionCollection()->addAction("actionProgressive", actionProgressive);
+    this->connect(actionProgressive, SIGNAL(triggered(bool)), this, SLOT(changeProgressive(bool)));
+
+    KAction* actionJuliaInset = new KAction(this);
+    actionJuliaInset->setText(i18n("&Julia Set Inset"));
+    actionJuliaInset->setCheckable(true);
+    actionJuliaInset->setChecked(m_canvas->juliaInset());
+    actionJuliaInset->setShortcut(Qt::Key_J);
+    actionJuliaInset->setStatusTip("Shows the Julia set of the point under the mouse in a corner of the view.");
+    this->actionCollection()->addAction("actionJuliaInset", actionJuliaInset);
+    this->connect(actionJuliaInset, SIGNAL(triggered(bool)), this, SLOT(changeJuliaInset(bool)));
+
     QSignalMapper* colorMapper = new QSignalMapper(this);
 
     KAction* actionColorFire = new KAction(this);
@@ -251,28 +391,458 @@ void MainWindow::setupActions()
     actionAntialiasing->setMenu(antialiasingMenu);
     actionAntialiasing->setStatusTip("Select the rendering quality.");
     this->actionCollection()->addAction("actionAntialiasing", actionAntialiasing);
+
+    QSignalMapper* coloringMapper = new QSignalMapper(this);
+
+    KAction* actionColoringIterations = new KAction(this);
+    actionColoringIterations->setText(i18n("&Iteration Count"));
+    actionColoringIterations->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringIterations", actionColoringIterations);
+    this->connect(actionColoringIterations, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    KAction* actionColoringSmooth = new KAction(this);
+    actionColoringSmooth->setText(i18n("&Smooth Iteration Count"));
+    actionColoringSmooth->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringSmooth", actionColoringSmooth);
+    this->connect(actionColoringSmooth, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    KAction* actionColoringMagnitude = new KAction(this);
+    actionColoringMagnitude->setText(i18n("Final &Magnitude"));
+    actionColoringMagnitude->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringMagnitude", actionColoringMagnitude);
+    this->connect(actionColoringMagnitude, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    KAction* actionColoringOrbitTrap = new KAction(this);
+    actionColoringOrbitTrap->setText(i18n("&Orbit Trap"));
+    actionColoringOrbitTrap->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringOrbitTrap", actionColoringOrbitTrap);
+    this->connect(actionColoringOrbitTrap, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    KAction* actionColoringPeriod = new KAction(this);
+    actionColoringPeriod->setText(i18n("Interior &Period"));
+    actionColoringPeriod->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringPeriod", actionColoringPeriod);
+    this->connect(actionColoringPeriod, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    KAction* actionColoringRoot = new KAction(this);
+    actionColoringRoot->setText(i18n("Converged &Root"));
+    actionColoringRoot->setCheckable(true);
+    this->actionCollection()->addAction("actionColoringRoot", actionColoringRoot);
+    this->connect(actionColoringRoot, SIGNAL(triggered(bool)), coloringMapper, SLOT(map()));
+
+    coloringMapper->setMapping(actionColoringIterations, ColorScheme::IterationCount);
+    coloringMapper->setMapping(actionColoringSmooth, ColorScheme::SmoothCount);
+    coloringMapper->setMapping(actionColoringMagnitude, ColorScheme::FinalMagnitude);
+    coloringMapper->setMapping(actionColoringOrbitTrap, ColorScheme::OrbitTrapDistance);
+    coloringMapper->setMapping(actionColoringPeriod, ColorScheme::InteriorPeriod);
+    coloringMapper->setMapping(actionColoringRoot, ColorScheme::ConvergedRoot);
+
+    connect(coloringMapper, SIGNAL(mapped(int)), this, SLOT(changeColoring(int)));
+
+    QActionGroup* coloringGroup = new QActionGroup(this);
+    coloringGroup->addAction(actionColoringIterations);
+    coloringGroup->addAction(actionColoringSmooth);
+    coloringGroup->addAction(actionColoringMagnitude);
+    coloringGroup->addAction(actionColoringOrbitTrap);
+    coloringGroup->addAction(actionColoringPeriod);
+    coloringGroup->addAction(actionColoringRoot);
+    actionColoringIterations->setChecked(true);
+
+    KMenu* coloringMenu = new KMenu("Coloring");
+    coloringMenu->addAction(actionColoringIterations);
+    coloringMenu->addAction(actionColoringSmooth);
+    coloringMenu->addAction(actionColoringMagnitude);
+    coloringMenu->addAction(actionColoringOrbitTrap);
+    coloringMenu->addAction(actionColoringPeriod);
+    coloringMenu->addAction(actionColoringRoot);
+
+    KAction* actionColoring = new KAction(this);
+    actionColoring->setText("Colo&ring");
+    actionColoring->setMenu(coloringMenu);
+    actionColoring->setStatusTip("Select which per-sample data the colors are derived from.");
+    this->actionCollection()->addAction("actionColoring", actionColoring);
+
+    QSignalMapper* filterMapper = new QSignalMapper(this);
+
+    KAction* actionFilterBox = new KAction(this);
+    actionFilterBox->setText(i18n("&Box"));
+    actionFilterBox->setCheckable(true);
+    this->actionCollection()->addAction("actionFilterBox", actionFilterBox);
+    this->connect(actionFilterBox, SIGNAL(triggered(bool)), filterMapper, SLOT(map()));
+
+    KAction* actionFilterTent = new KAction(this);
+    actionFilterTent->setText(i18n("&Tent"));
+    actionFilterTent->setCheckable(true);
+    this->actionCollection()->addAction("actionFilterTent", actionFilterTent);
+    this->connect(actionFilterTent, SIGNAL(triggered(bool)), filterMapper, SLOT(map()));
+
+    KAction* actionFilterGaussian = new KAction(this);
+    actionFilterGaussian->setText(i18n("&Gaussian"));
+    actionFilterGaussian->setCheckable(true);
+    this->actionCollection()->addAction("actionFilterGaussian", actionFilterGaussian);
+    this->connect(actionFilterGaussian, SIGNAL(triggered(bool)), filterMapper, SLOT(map()));
+
+    filterMapper->setMapping(actionFilterBox, Downsampler::Box);
+    filterMapper->setMapping(actionFilterTent, Downsampler::Tent);
+    filterMapper->setMapping(actionFilterGaussian, Downsampler::Gaussian);
+
+    connect(filterMapper, SIGNAL(mapped(int)), this, SLOT(changeFilter(int)));
+
+    QActionGroup* filterGroup = new QActionGroup(this);
+    filterGroup->addAction(actionFilterBox);
+    filterGroup->addAction(actionFilterTent);
+    filterGroup->addAction(actionFilterGaussian);
+    actionFilterBox->setChecked(true);
+
+    KMenu* filterMenu = new KMenu("Filter");
+    filterMenu->addAction(actionFilterBox);
+    filterMenu->addAction(actionFilterTent);
+    filterMenu->addAction(actionFilterGaussian);
+
+    KAction* actionFilter = new KAction(this);
+    actionFilter->setText("Antialiasing &Filter");
+    actionFilter->setMenu(filterMenu);
+    actionFilter->setStatusTip("Select how the samples of a pixel are weighted.");
+    this->actionCollection()->addAction("actionFilter", actionFilter);
+
+    QSignalMapper* renderModeMapper = new QSignalMapper(this);
+
+    KAction* actionModeEscapeTime = new KAction(this);
+    actionModeEscapeTime->setText(i18n("&Escape Time"));
+    actionModeEscapeTime->setCheckable(true);
+    this->actionCollection()->addAction("actionModeEscapeTime", actionModeEscapeTime);
+    this->connect(actionModeEscapeTime, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    KAction* actionModeBuddhabrot = new KAction(this);
+    actionModeBuddhabrot->setText(i18n("&Buddhabrot"));
+    actionModeBuddhabrot->setCheckable(true);
+    this->actionCollection()->addAction("actionModeBuddhabrot", actionModeBuddhabrot);
+    this->connect(actionModeBuddhabrot, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    KAction* actionModeAntiBuddhabrot = new KAction(this);
+    actionModeAntiBuddhabrot->setText(i18n("&Anti-Buddhabrot"));
+    actionModeAntiBuddhabrot->setCheckable(true);
+    this->actionCollection()->addAction("actionModeAntiBuddhabrot", actionModeAntiBuddhabrot);
+    this->connect(actionModeAntiBuddhabrot, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    KAction* actionModeNebulabrot = new KAction(this);
+    actionModeNebulabrot->setText(i18n("&Nebulabrot"));
+    actionModeNebulabrot->setCheckable(true);
+    this->actionCollection()->addAction("actionModeNebulabrot", actionModeNebulabrot);
+    this->connect(actionModeNebulabrot, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    KAction* actionModeMandelbulb = new KAction(this);
+    actionModeMandelbulb->setText(i18n("Mandel&bulb"));
+    actionModeMandelbulb->setCheckable(true);
+    this->actionCollection()->addAction("actionModeMandelbulb", actionModeMandelbulb);
+    this->connect(actionModeMandelbulb, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    KAction* actionModeMandelbox = new KAction(this);
+    actionModeMandelbox->setText(i18n("Mandelbo&x"));
+    actionModeMandelbox->setCheckable(true);
+    this->actionCollection()->addAction("actionModeMandelbox", actionModeMandelbox);
+    this->connect(actionModeMandelbox, SIGNAL(triggered(bool)), renderModeMapper, SLOT(map()));
+
+    renderModeMapper->setMapping(actionModeEscapeTime, ESCAPE_TIME_MODE);
+    renderModeMapper->setMapping(actionModeBuddhabrot, DensityBuffer::Buddhabrot);
+    renderModeMapper->setMapping(actionModeAntiBuddhabrot, DensityBuffer::AntiBuddhabrot);
+    renderModeMapper->setMapping(actionModeNebulabrot, DensityBuffer::Nebulabrot);
+    renderModeMapper->setMapping(actionModeMandelbulb, RAYMARCH_MODE + Raymarcher::Mandelbulb);
+    renderModeMapper->setMapping(actionModeMandelbox, RAYMARCH_MODE + Raymarcher::Mandelbox);
+
+    connect(renderModeMapper, SIGNAL(mapped(int)), this, SLOT(changeRenderMode(int)));
+
+    QActionGroup* renderModeGroup = new QActionGroup(this);
+    renderModeGroup->addAction(actionModeEscapeTime);
+    renderModeGroup->addAction(actionModeBuddhabrot);
+    renderModeGroup->addAction(actionModeAntiBuddhabrot);
+    renderModeGroup->addAction(actionModeNebulabrot);
+    renderModeGroup->addAction(actionModeMandelbulb);
+    renderModeGroup->addAction(actionModeMandelbox);
+    actionModeEscapeTime->setChecked(true);
+
+    KMenu* renderModeMenu = new KMenu("Render Mode");
+    renderModeMenu->addAction(actionModeEscapeTime);
+    renderModeMenu->addAction(actionModeBuddhabrot);
+    renderModeMenu->addAction(actionModeAntiBuddhabrot);
+    renderModeMenu->addAction(actionModeNebulabrot);
+    renderModeMenu->addSeparator();
+    renderModeMenu->addAction(actionModeMandelbulb);
+    renderModeMenu->addAction(actionModeMandelbox);
+
+    KAction* actionRenderMode = new KAction(this);
+    actionRenderMode->setText("Render &Mode");
+    actionRenderMode->setMenu(renderModeMenu);
+    actionRenderMode->setStatusTip("Draw escape times, the density of the orbits or a 3D fractal.");
+    this->actionCollection()->addAction("actionRenderMode", actionRenderMode);
+
+    QSignalMapper* formulaMapper = new QSignalMapper(this);
+
+    KAction* actionFormulaMandelbrot = new KAction(this);
+    actionFormulaMandelbrot->setText(i18n("&Mandelbrot"));
+    actionFormulaMandelbrot->setCheckable(true);
+    this->actionCollection()->addAction(FORMULA_ACTIONS[Formula::Mandelbrot], actionFormulaMandelbrot);
+    this->connect(actionFormulaMandelbrot, SIGNAL(triggered(bool)), formulaMapper, SLOT(map()));
+
+    KAction* actionFormulaNewton = new KAction(this);
+    actionFormulaNewton->setText(i18n("&Newton..."));
+    actionFormulaNewton->setCheckable(true);
+    this->actionCollection()->addAction(FORMULA_ACTIONS[Formula::Newton], actionFormulaNewton);
+    this->connect(actionFormulaNewton, SIGNAL(triggered(bool)), formulaMapper, SLOT(map()));
+
+    KAction* actionFormulaNova = new KAction(this);
+    actionFormulaNova->setText(i18n("N&ova..."));
+    actionFormulaNova->setCheckable(true);
+    this->actionCollection()->addAction(FORMULA_ACTIONS[Formula::Nova], actionFormulaNova);
+    this->connect(actionFormulaNova, SIGNAL(triggered(bool)), formulaMapper, SLOT(map()));
+
+    formulaMapper->setMapping(actionFormulaMandelbrot, Formula::Mandelbrot);
+    formulaMapper->setMapping(actionFormulaNewton, Formula::Newton);
+    formulaMapper->setMapping(actionFormulaNova, Formula::Nova);
+
+    connect(formulaMapper, SIGNAL(mapped(int)), this, SLOT(changeFormula(int)));
+
+    QActionGroup* formulaGroup = new QActionGroup(this);
+    formulaGroup->addAction(actionFormulaMandelbrot);
+    formulaGroup->addAction(actionFormulaNewton);
+    formulaGroup->addAction(actionFormulaNova);
+    actionFormulaMandelbrot->setChecked(true);
+
+    KMenu* formulaMenu = new KMenu("Formula");
+    formulaMenu->addAction(actionFormulaMandelbrot);
+    formulaMenu->addAction(actionFormulaNewton);
+    formulaMenu->addAction(actionFormulaNova);
+
+    KAction* actionFormula = new KAction(this);
+    actionFormula->setText("F&ormula");
+    actionFormula->setMenu(formulaMenu);
+    actionFormula->setStatusTip("Iterate until escape, or find the roots of a polynomial.");
+    this->actionCollection()->addAction("actionFormula", actionFormula);
+}
+
+bool MainWindow::startExportWorkers()
+{
+    //Frames are computed by the configured tile worker processes, local ones spawned for this export if asked
+    //for, or otherwise on the render pool, where exploring the view always goes first
+    KConfigGroup config(KGlobal::config(), "Export");
+    bool localProcesses = config.readEntry("LocalProcesses", false);
+    int localWorkers = config.readEntry("LocalWorkers", 2);
+    int niceness = config.readEntry("Niceness", 10);
+    QStringList workers = config.readEntry("Workers", QStringList());
+
+    m_exportCoordinator = new TileCoordinator();
+
+    for (const QString& worker : workers) {
+        m_exportCoordinator->addWorker(worker.toLocal8Bit().constData());
+    }
+
+    if (workers.isEmpty() && !localProcesses) {
+        m_exportCoordinator->useLocalPool();
+    } else if (workers.isEmpty() && !m_exportCoordinator->spawnLocalWorkers(localWorkers, niceness)) {
+        delete m_exportCoordinator;
+        m_exportCoordinator = nullptr;
+        KMessageBox::error(this, i18n("Could not start the tile worker processes."));
+        return false;
+    }
+
+    return true;
+}
+
+TileJob MainWindow::exportFrame(int scale, int antialiasing)
+{
+    const ZoomRegion& region = m_canvas->zoomRegion();
+
+    TileJob frame;
+    frame.id = 0;
+    frame.x1 = region.location().x();
+    frame.y1 = region.location().y();
+    frame.x2 = region.location().x() + region.width();
+    frame.y2 = region.location().y() + region.height();
+    frame.frameWidth = m_canvas->width() * scale;
+    frame.frameHeight = m_canvas->height() * scale;
+    frame.firstRow = 0;
+    frame.rowCount = frame.frameHeight;
+    frame.firstColumn = 0;
+    frame.columnCount = frame.frameWidth;
+    frame.antialiasing = antialiasing;
+    frame.formula = TileJob::Mandelbrot;
+    frame.maxIterations = m_canvas->maxIterations();
+
+    return frame;
 }
 
 void MainWindow::render()
 {
+    if (m_exportThread != nullptr) {
+        return;
+    }
+
+    if (m_canvas->formula().convergent() || m_canvas->raymarching()) {
+        KMessageBox::sorry(this, i18n("Exports can only render the Mandelbrot set."));
+        return;
+    }
+
+    QString fileName = KFileDialog::getSaveFileName(KUrl(), "*.png|PNG Images", this, i18n("Render to Image"));
+
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    KConfigGroup config(KGlobal::config(), "Export");
+    int scale = config.readEntry("Scale", 4);
+    int antialiasing = config.readEntry("Antialiasing", 2);
+
+    if (!startExportWorkers()) {
+        return;
+    }
+
+    TileJob frame = exportFrame(scale, antialiasing);
+    ColorScheme colors = m_canvas->colorScheme();
+    Downsampler::Filter filter = m_canvas->filter();
+
+    m_exportImage = QImage(frame.frameWidth, frame.frameHeight, QImage::Format_RGB32);
+    m_exportFileName = fileName;
+    m_exportCanceled = false;
+
+    m_exportThread = new std::thread([this, frame, colors, filter]() {
+        int bands = (frame.frameHeight + EXPORT_BAND_ROWS - 1) / EXPORT_BAND_ROWS;
+        int bandsDone = 0;
+
+        ColorTable colorTable(colors, frame.maxIterations);
+        Downsampler downsampler(filter, frame.antialiasing);
+
+        bool succeeded = m_exportCoordinator->render(frame, EXPORT_BAND_ROWS, [&](const TileJob& job, const TileResult& result) {
+            TileImage::colorize(job, result, colorTable, downsampler, m_exportImage, 0, job.firstRow);
+            emit exportProgress(++bandsDone * 100 / bands);
+        }, m_exportCanceled);
+
+        emit exportDone(succeeded);
+    });
+
+    m_progressBar->setValue(0);
+    m_progressBar->setVisible(true);
+    this->stateChanged("rendering");
+}
+
+void MainWindow::exportPyramid()
+{
+    if (m_exportThread != nullptr) {
+        return;
+    }
+
+    if (m_canvas->formula().convergent() || m_canvas->raymarching()) {
+        KMessageBox::sorry(this, i18n("Exports can only render the Mandelbrot set."));
+        return;
+    }
+
+    QString fileName = KFileDialog::getSaveFileName(KUrl(), "*.dzi|Deep Zoom Images", this, i18n("Export Tile Pyramid"));
 
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    //Exporting to the same file again keeps the tiles already written for this view
+    KConfigGroup config(KGlobal::config(), "Export");
+    int scale = config.readEntry("PyramidScale", 16);
+    int antialiasing = config.readEntry("Antialiasing", 2);
+    int tileSize = config.readEntry("PyramidTileSize", 256);
+
+    if (!startExportWorkers()) {
+        return;
+    }
+
+    TileJob frame = exportFrame(scale, antialiasing);
+    ColorScheme colors = m_canvas->colorScheme();
+    Downsampler::Filter filter = m_canvas->filter();
+    std::string path = fileName.toLocal8Bit().constData();
+
+    m_exportImage = QImage();
+    m_exportFileName = fileName;
+    m_exportCanceled = false;
+
+    m_exportThread = new std::thread([this, frame, colors, filter, path, tileSize]() {
+        TilePyramid pyramid(path, frame.frameWidth, frame.frameHeight, tileSize);
+
+        bool succeeded = pyramid.render(*m_exportCoordinator, frame, colors, filter, [this](int done, int total) {
+            emit exportProgress((int) ((long long) done * 100 / total));
+        }, m_exportCanceled);
+
+        emit exportDone(succeeded);
+    });
+
+    m_progressBar->setValue(0);
+    m_progressBar->setVisible(true);
+    this->stateChanged("rendering");
+}
+
+void MainWindow::exportComplete(bool succeeded)
+{
+    m_exportThread->join();
+    delete m_exportThread;
+    m_exportThread = nullptr;
+
+    //Also terminates any worker processes spawned for the export
+    delete m_exportCoordinator;
+    m_exportCoordinator = nullptr;
+
+    //Tile pyramids are written as they go; only single images are saved here
+    if (succeeded) {
+        if (!m_exportImage.isNull() && !m_exportImage.save(m_exportFileName)) {
+            KMessageBox::error(this, i18n("Could not write %1.", m_exportFileName));
+        }
+    } else if (!m_exportCanceled) {
+        KMessageBox::error(this, i18n("Rendering failed: no tile worker could complete the image."));
+    }
+
+    m_exportImage = QImage();
+    m_progressBar->setVisible(false);
+    this->stateChanged("idle");
 }
 
 void MainWindow::stop()
 {
+    m_exportCanceled = true;
     m_canvas->backgroundWorker()->cancel();
 }
 
 void MainWindow::previewStart()
 {
+    //An export owns the progress bar until it finishes
+    if (m_exportThread != nullptr) {
+        return;
+    }
+
+    m_progressBar->setValue(0);
     m_progressBar->setVisible(true);
+    m_progressTimer->start();
     this->stateChanged("calculatingPreview");
 }
 
 void MainWindow::previewComplete(bool canceled)
 {
+    if (m_exportThread != nullptr) {
+        return;
+    }
+
+    m_progressTimer->stop();
     m_progressBar->setVisible(false);
     this->stateChanged("idle");
+
+    if (!canceled) {
+        this->statusBar()->showMessage(QString::fromStdString(m_canvas->backgroundWorker()->stats().summary()));
+    }
+}
+
+void MainWindow::updateProgress()
+{
+    const RenderProgress& progress = m_canvas->backgroundWorker()->progress();
+    double remaining = progress.remainingSeconds();
+
+    m_progressBar->setValue((int) (progress.fraction() * 100));
+
+    if (remaining >= 0.0) {
+        this->statusBar()->showMessage(i18n("Rendering, %1 left", KGlobal::locale()->prettyFormatDuration((unsigned long) (remaining * 1000))));
+    }
 }
 
 void MainWindow::customColorScheme()
@@ -280,9 +850,56 @@ void MainWindow::customColorScheme()
     //TODO: create color scheme dialog
 }
 
+void MainWindow::open()
+{
+    QString fileName = KFileDialog::getOpenFileName(KUrl(), "*.fkt|Fractal Documents", this, i18n("Open"));
+
+    if (!fileName.isEmpty()) {
+        openFile(fileName);
+    }
+}
+
+bool MainWindow::openFile(const QString& fileName)
+{
+    if (!m_canvas->load(fileName)) {
+        KMessageBox::error(this, i18n("Could not open %1.", fileName));
+        return false;
+    }
+
+    this->actionCollection()->action("actionAutoIterations")->setChecked(m_canvas->autoIterations());
+    this->actionCollection()->action(FORMULA_ACTIONS[m_canvas->formula().kind()])->setChecked(true);
+    return true;
+}
+
 void MainWindow::saveAs()
 {
+    QString fileName = KFileDialog::getSaveFileName(KUrl(), "*.fkt|Fractal Documents", this, i18n("Save As"));
 
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    //Storing the samples lets the document reopen without rendering, at the cost of a much larger file
+    KConfigGroup config(KGlobal::config(), "Files");
+
+    if (!m_canvas->save(fileName, config.readEntry("StoreSamples", true))) {
+        KMessageBox::error(this, i18n("Could not write %1.", fileName));
+    }
+}
+
+void MainWindow::changeTracing(bool enabled)
+{
+    Trace::setEnabled(enabled);
+    Trace::nameThread("gui");
+}
+
+void MainWindow::saveTrace()
+{
+    QString fileName = KFileDialog::getSaveFileName(KUrl(), "*.json|Chrome Trace Files", this, i18n("Save Timeline"));
+
+    if (!fileName.isEmpty() && !Trace::write(fileName.toLocal8Bit().constData())) {
+        KMessageBox::error(this, i18n("Could not write %1.", fileName));
+    }
 }
 
 void MainWindow::zoomIn()
@@ -300,11 +917,88 @@ void MainWindow::zoomReset()
     //TODO: wire up zoom reset button
 }
 
+void MainWindow::moreIterations()
+{
+    m_canvas->setMaxIterations(m_canvas->maxIterations() * 2);
+}
+
+void MainWindow::fewerIterations()
+{
+    m_canvas->setMaxIterations(std::max(m_canvas->maxIterations() / 2, 16));
+}
+
+void MainWindow::changeAutoIterations ( bool enabled )
+{
+    m_canvas->setAutoIterations(enabled);
+}
+
+void MainWindow::changeProgressive ( bool enabled )
+{
+    m_canvas->setProgressive(enabled);
+}
+
+void MainWindow::changeJuliaInset ( bool enabled )
+{
+    m_canvas->setJuliaInset(enabled);
+}
+
 void MainWindow::changeAntiAliasing ( int amount )
 {
     m_canvas->setAntialiasing(amount);
 }
 
+void MainWindow::changeColoring ( int coloring )
+{
+    m_canvas->setColoring((ColorScheme::Coloring) coloring);
+}
+
+void MainWindow::changeFilter ( int filter )
+{
+    m_canvas->setFilter((Downsampler::Filter) filter);
+}
+
+void MainWindow::changeRenderMode ( int mode )
+{
+    if (mode == ESCAPE_TIME_MODE) {
+        m_canvas->setDensityMode(false);
+    } else if (mode >= RAYMARCH_MODE) {
+        m_canvas->setRaymarchMode(true, (Raymarcher::Fractal) (mode - RAYMARCH_MODE));
+    } else {
+        m_canvas->setDensityMode(true, (DensityBuffer::Mode) mode);
+    }
+}
+
+void MainWindow::changeFormula ( int kind )
+{
+    if (kind == Formula::Mandelbrot) {
+        m_canvas->setFormula(Formula());
+        return;
+    }
+
+    const Formula& current = m_canvas->formula();
+    QString text = current.convergent() ? QString::fromLocal8Bit(current.coefficientText().c_str()) : QString(DEFAULT_COEFFICIENTS);
+    bool accepted = false;
+
+    text = KInputDialog::getText(i18n("Formula"),
+                                 i18n("Polynomial coefficients, highest degree first (up to degree %1):", Formula::MAX_DEGREE),
+                                 text, &accepted, this);
+
+    std::vector<std::complex<double>> coefficients;
+
+    if (accepted && !Formula::parseCoefficients(text.toLocal8Bit().constData(), coefficients)) {
+        KMessageBox::error(this, i18n("Enter between 2 and %1 numbers, complex ones as (real,imaginary).", Formula::MAX_DEGREE + 1));
+        accepted = false;
+    }
+
+    //Keep the menu on the formula that is still shown
+    if (!accepted) {
+        this->actionCollection()->action(FORMULA_ACTIONS[current.kind()])->setChecked(true);
+        return;
+    }
+
+    m_canvas->setFormula(Formula((Formula::Kind) kind, coefficients));
+}
+
 void MainWindow::changeColorScheme ( QObject* colors )
 {
     Wrapper<ColorScheme>* colorSchemeWrapper = dynamic_cast<Wrapper<ColorScheme>*>(colors);
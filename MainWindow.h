@@ -2,20 +2,24 @@
 #define MainWindow_H
 
 #include <thread>
+#include <atomic>
 
 #include <KXmlGuiWindow>
+#include <QImage>
+#include <QString>
 
 #include "ColorScheme.h"
 #include "Wrapper.h"
 #include "BackgroundWorker.h"
 #include "Point.h"
 #include "ZoomRegion.h"
+#include "TileProtocol.h"
 
 class QWidget;
 class QLabel;
 class Canvas;
 class QProgressBar;
-class QImage;
+class TileCoordinator;
 
 class MainWindow : public KXmlGuiWindow
 {
@@ -28,33 +32,63 @@ class MainWindow : public KXmlGuiWindow
 
         Canvas* m_canvas;
         QProgressBar* m_progressBar;
+        QTimer* m_progressTimer;
         QTimer* m_refreshTimer;
         QImage* m_image;
         BackgroundWorker* m_backgroundWorker;
 
+        std::thread* m_exportThread;
+        std::atomic<bool> m_exportCanceled;
+        TileCoordinator* m_exportCoordinator;
+        QImage m_exportImage;
+        QString m_exportFileName;
+
         void setupActions();
         void setupWidgets();
         void setColorScheme();
         void renderPreview();
+        bool startExportWorkers();
+        TileJob exportFrame(int scale, int antialiasing);
 
         friend class BackgroundWorker;
 
+    signals:
+        void exportProgress(int);
+        void exportDone(bool);
+
     public:
         MainWindow(QWidget* parent = nullptr);
         virtual ~MainWindow();
 
+        bool openFile(const QString& fileName);
+
     private slots:
         void render();
+        void exportPyramid();
+        void open();
         void saveAs();
+        void changeTracing(bool enabled);
+        void saveTrace();
         void zoomIn();
         void zoomOut();
         void zoomReset();
         void stop();
+        void moreIterations();
+        void fewerIterations();
+        void changeAutoIterations(bool enabled);
+        void changeProgressive(bool enabled);
+        void changeJuliaInset(bool enabled);
         void changeAntiAliasing(int amount);
         void changeColorScheme(QObject* colors);
+        void changeColoring(int coloring);
+        void changeFilter(int filter);
+        void changeRenderMode(int mode);
+        void changeFormula(int kind);
         void customColorScheme();
         void previewStart();
         void previewComplete(bool canceled);
+        void updateProgress();
+        void exportComplete(bool succeeded);
 };
 
 #endif
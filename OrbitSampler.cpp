@@ -0,0 +1,88 @@
+#include "OrbitSampler.h"
+#include "DensityBuffer.h"
+
+#include <algorithm>
+
+namespace
+{
+    const double LEFT = -2.0;
+    const double SIZE = 4.0;
+    const double CELL_WIDTH = SIZE / OrbitSampler::COLUMNS;
+    const double CELL_HEIGHT = SIZE / 2.0 / OrbitSampler::ROWS;
+
+    //Every cell keeps at least this share of the mean cell's probability, so nothing the early passes missed is left out for good
+    const double MINIMUM_SHARE = 0.05;
+}
+
+OrbitSampler::OrbitSampler() :
+    m_cumulative(CELLS),
+    m_weights(CELLS)
+{
+    reset();
+}
+
+void OrbitSampler::reset()
+{
+    m_statistics = Statistics();
+
+    for (int cell = 0; cell < CELLS; cell++) {
+        m_cumulative[cell] = (double) (cell + 1) / CELLS;
+        m_weights[cell] = DensityBuffer::WEIGHT_ONE;
+    }
+}
+
+void OrbitSampler::update(const Statistics& statistics)
+{
+    std::vector<double> density(CELLS);
+    double sum = 0.0;
+    int sampled = 0;
+
+    for (int cell = 0; cell < CELLS; cell++) {
+        m_statistics.hits[cell] += statistics.hits[cell];
+        m_statistics.samples[cell] += statistics.samples[cell];
+
+        if (m_statistics.samples[cell] > 0.0) {
+            density[cell] = m_statistics.hits[cell] / m_statistics.samples[cell];
+            sum += density[cell];
+            sampled++;
+        }
+    }
+
+    if (sum <= 0.0) {
+        return;
+    }
+
+    //Cells that were never drawn get the average
+    double mean = sum / sampled;
+    double floor = MINIMUM_SHARE * mean;
+    double total = 0.0;
+
+    for (int cell = 0; cell < CELLS; cell++) {
+        double value = m_statistics.samples[cell] > 0.0 ? density[cell] : mean;
+        density[cell] = std::max(value, floor);
+        total += density[cell];
+    }
+
+    double running = 0.0;
+
+    for (int cell = 0; cell < CELLS; cell++) {
+        running += density[cell];
+        m_cumulative[cell] = running / total;
+
+        //Uniform probability over this cell's probability
+        double weight = total / (CELLS * density[cell]) * DensityBuffer::WEIGHT_ONE;
+        m_weights[cell] = (std::uint32_t) std::max(1.0, weight + 0.5);
+    }
+
+    m_cumulative[CELLS - 1] = 1.0;
+}
+
+void OrbitSampler::sample(std::uint64_t& state, double& real, double& imag, int& cell, std::uint32_t& weight) const
+{
+    double u = uniform(state);
+    cell = std::min((int) (std::upper_bound(m_cumulative.begin(), m_cumulative.end(), u) - m_cumulative.begin()), CELLS - 1);
+    weight = m_weights[cell];
+
+    real = LEFT + ((cell % COLUMNS) + uniform(state)) * CELL_WIDTH;
+    imag = ((cell / COLUMNS) + uniform(state)) * CELL_HEIGHT;
+}
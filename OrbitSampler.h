@@ -0,0 +1,62 @@
+#ifndef OrbitSampler_H
+#define OrbitSampler_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Picks starting points c for orbit density renders. The upper half of the
+ * square [-2, 2] x [-2, 2] is split into cells; at first every cell is equally
+ * likely, later cells are drawn in proportion to how many visible orbit
+ * points their samples produced so far, which concentrates the work near the
+ * boundary of the set and on the parts of it that reach the view. Each point
+ * comes with a fixed point weight (DensityBuffer::WEIGHT_ONE for the uniform
+ * distribution) that undoes the bias. Orbits of the lower half are the
+ * mirror images of the upper half's, so callers add both.
+ */
+class OrbitSampler
+{
+    public:
+        static const int COLUMNS = 256;
+        static const int ROWS = 128;
+        static const int CELLS = COLUMNS * ROWS;
+
+        //Visible orbit points and samples taken per cell
+        struct Statistics
+        {
+            std::vector<double> hits;
+            std::vector<double> samples;
+
+            Statistics() : hits(CELLS, 0.0), samples(CELLS, 0.0) { }
+        };
+
+    private:
+        std::vector<double> m_cumulative;
+        std::vector<std::uint32_t> m_weights;
+        Statistics m_statistics;
+
+    public:
+        OrbitSampler();
+
+        //Back to the uniform distribution
+        void reset();
+
+        //Adds what a pass has learnt and rebuilds the distribution from everything seen so far
+        void update(const Statistics& statistics);
+
+        //Draws a point and the cell it came from; state is the caller's random number generator
+        void sample(std::uint64_t& state, double& real, double& imag, int& cell, std::uint32_t& weight) const;
+
+        //splitmix64, in [0, 1)
+        static double uniform(std::uint64_t& state)
+        {
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            z ^= z >> 31;
+
+            return (double) (z >> 11) * (1.0 / 9007199254740992.0);
+        }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "PageAllocator.h"
+
+#include <atomic>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+namespace
+{
+    const std::size_t SMALL_PAGE_SIZE = 4096;
+    const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    std::atomic<int> g_mode(PageAllocator::TransparentHugePages);
+
+    //Every allocation is made at this size, so release can compute it from the requested one
+    std::size_t mappedSize(std::size_t bytes)
+    {
+        std::size_t unit = bytes < HUGE_PAGE_SIZE ? SMALL_PAGE_SIZE : HUGE_PAGE_SIZE;
+        return (bytes + unit - 1) / unit * unit;
+    }
+
+    void* mapAnonymous(std::size_t bytes, int flags)
+    {
+        void* data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+        return data == MAP_FAILED ? nullptr : data;
+    }
+
+    //Over-maps by one huge page and trims the ends so the buffer starts on a huge page boundary
+    void* mapAligned(std::size_t bytes)
+    {
+        char* data = (char*) mapAnonymous(bytes + HUGE_PAGE_SIZE, 0);
+
+        if (data == nullptr) {
+            return nullptr;
+        }
+
+        std::uintptr_t address = (std::uintptr_t) data;
+        std::size_t head = (HUGE_PAGE_SIZE - address % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+
+        if (head > 0) {
+            ::munmap(data, head);
+        }
+
+        ::munmap(data + head + bytes, HUGE_PAGE_SIZE - head);
+
+        return data + head;
+    }
+}
+
+void PageAllocator::setMode(Mode mode)
+{
+    g_mode = mode;
+}
+
+PageAllocator::Mode PageAllocator::mode()
+{
+    return (Mode) g_mode.load();
+}
+
+void* PageAllocator::allocate(std::size_t bytes)
+{
+    if (bytes == 0) {
+        return nullptr;
+    }
+
+    std::size_t size = mappedSize(bytes);
+    Mode current = mode();
+
+    if (current == NormalPages || bytes < HUGE_PAGE_SIZE) {
+        return mapAnonymous(size, 0);
+    }
+
+#ifdef MAP_HUGETLB
+    if (current == ExplicitHugePages) {
+        void* data = mapAnonymous(size, MAP_HUGETLB);
+
+        if (data != nullptr) {
+            return data;
+        }
+    }
+#endif
+
+    void* data = mapAligned(size);
+
+#ifdef MADV_HUGEPAGE
+    if (data != nullptr) {
+        ::madvise(data, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return data;
+}
+
+void PageAllocator::release(void* data, std::size_t bytes)
+{
+    if (data != nullptr) {
+        ::munmap(data, mappedSize(bytes));
+    }
+}
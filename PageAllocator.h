@@ -0,0 +1,33 @@
+#ifndef PageAllocator_H
+#define PageAllocator_H
+
+#include <cstddef>
+
+/*
+ * Allocations for large, long lived buffers: sample planes and frame images.
+ * Memory comes straight from mmap and is never cleared by us; the kernel
+ * maps zero pages on first touch. Buffers of at least one huge page can be
+ * backed by transparent huge pages (2 MB aligned and advised) or by explicit
+ * ones from the hugetlbfs pool, falling back to transparent huge pages when
+ * the pool is empty. Huge pages cut TLB misses when sweeping whole planes
+ * but coarsen NUMA first touch placement to 2 MB.
+ */
+namespace PageAllocator
+{
+    enum Mode
+    {
+        NormalPages,
+        TransparentHugePages,
+        ExplicitHugePages
+    };
+
+    //Applies to allocations made afterwards
+    void setMode(Mode mode);
+    Mode mode();
+
+    //Returns nullptr if out of memory; release needs the same size
+    void* allocate(std::size_t bytes);
+    void release(void* data, std::size_t bytes);
+}
+
+#endif
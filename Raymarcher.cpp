@@ -0,0 +1,598 @@
+#include "Raymarcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+    const int LANES = Raymarcher::LANES;
+
+    //Steps before a ray that is still approaching the surface is taken to have hit it
+    const int MAX_STEPS = 256;
+
+    //A ray hits once it is closer to the surface than this fraction of a pixel
+    const float DETAIL = 0.5f;
+
+    //Squared orbit radius at which iteration stops; generous, as the distance estimate gets better with it
+    const float BULB_BAILOUT = 256.0f;
+    const float BOX_BAILOUT = 1024.0f;
+
+    //Mandelbox sphere fold: points inside the minimum radius are scaled by the ratio, up to the fixed radius inverted
+    const float BOX_MIN_RADIUS_SQR = 0.25f;
+    const float BOX_FIXED_RADIUS_SQR = 1.0f;
+
+    //Ambient occlusion samples along the normal, spaced by this fraction of the distance to the camera
+    const int AO_SAMPLES = 5;
+    const float AO_SPACING = 0.02f;
+
+    //Soft shadows: the larger the softness, the harder the shadow edges
+    const int SHADOW_STEPS = 64;
+    const float SHADOW_SOFTNESS = 16.0f;
+    const float SHADOW_MIN = 0.02f;
+
+    const float AMBIENT = 0.3f;
+    const float DIFFUSE = 0.8f;
+
+    //Light direction in camera coordinates: from above, left of and behind the camera
+    const double LIGHT_RIGHT = -0.5;
+    const double LIGHT_UP = 0.8;
+    const double LIGHT_FORWARD = -0.35;
+
+    //Views where the fractal looks best from its sides
+    const double OVERVIEW_YAW = 0.6;
+    const double OVERVIEW_PITCH = -0.45;
+
+    //Camera distance from the origin of the overviews, in radii of the fractal
+    const double OVERVIEW_DISTANCE = 2.8;
+
+    void store(const Vector3& vector, float* out)
+    {
+        out[0] = (float) vector.x();
+        out[1] = (float) vector.y();
+        out[2] = (float) vector.z();
+    }
+
+    /*
+     * Power 8 in triplex algebra without trigonometry: the spherical
+     * coordinate formulas multiplied out into polynomials of x, y and z.
+     * The axis is y, as for the general power path.
+     */
+    void bulbPower8(const float* cx, const float* cy, const float* cz, float* zx, float* zy, float* zz,
+                    float* derivative, float* radiusSqr, float* trap, int iterations)
+    {
+        for (int i = 0; i < iterations; i++) {
+            int remaining = 0;
+
+            for (int l = 0; l < LANES; l++) {
+                float x = zx[l];
+                float y = zy[l];
+                float z = zz[l];
+                float x2 = x * x;
+                float y2 = y * y;
+                float z2 = z * z;
+                float x4 = x2 * x2;
+                float y4 = y2 * y2;
+                float z4 = z2 * z2;
+
+                //Points on the axis would divide by zero
+                float k3 = std::max(x2 + z2, 1e-12f);
+                float k2 = 1.0f / (k3 * k3 * k3 * std::sqrt(k3));
+                float k1 = x4 + y4 + z4 - 6.0f * y2 * z2 - 6.0f * x2 * y2 + 2.0f * z2 * x2;
+                float k4 = x2 - y2 + z2;
+
+                float nextX = cx[l] + 64.0f * x * y * z * (x2 - z2) * k4 * (x4 - 6.0f * x2 * z2 + z4) * k1 * k2;
+                float nextY = cy[l] + -16.0f * y2 * k3 * k4 * k4 + k1 * k1;
+                float nextZ = cz[l] + -8.0f * y * k4 * (x4 * x4 - 28.0f * x4 * x2 * z2 + 70.0f * x4 * z4 - 28.0f * x2 * z2 * z4 + z4 * z4) * k1 * k2;
+
+                float r2 = radiusSqr[l];
+                float nextDerivative = 8.0f * r2 * r2 * r2 * std::sqrt(r2) * derivative[l] + 1.0f;
+                float nextRadiusSqr = nextX * nextX + nextY * nextY + nextZ * nextZ;
+
+                bool run = r2 < BULB_BAILOUT;
+                zx[l] = run ? nextX : x;
+                zy[l] = run ? nextY : y;
+                zz[l] = run ? nextZ : z;
+                derivative[l] = run ? nextDerivative : derivative[l];
+                radiusSqr[l] = run ? nextRadiusSqr : r2;
+                trap[l] = run ? std::min(trap[l], nextRadiusSqr) : trap[l];
+                remaining += run;
+            }
+
+            if (remaining == 0) {
+                break;
+            }
+        }
+    }
+
+    void bulbPower(int power, const float* cx, const float* cy, const float* cz, float* zx, float* zy, float* zz,
+                   float* derivative, float* radiusSqr, float* trap, int iterations)
+    {
+        for (int i = 0; i < iterations; i++) {
+            int remaining = 0;
+
+            for (int l = 0; l < LANES; l++) {
+                float r2 = radiusSqr[l];
+                float r = std::sqrt(r2);
+                float theta = power * std::acos(std::max(std::min(zy[l] / std::max(r, 1e-20f), 1.0f), -1.0f));
+                float phi = power * std::atan2(zx[l], zz[l]);
+                float rPower = std::pow(r, (float) power);
+
+                float nextX = cx[l] + rPower * std::sin(theta) * std::sin(phi);
+                float nextY = cy[l] + rPower * std::cos(theta);
+                float nextZ = cz[l] + rPower * std::sin(theta) * std::cos(phi);
+                float nextDerivative = power * rPower / std::max(r, 1e-20f) * derivative[l] + 1.0f;
+                float nextRadiusSqr = nextX * nextX + nextY * nextY + nextZ * nextZ;
+
+                bool run = r2 < BULB_BAILOUT;
+                zx[l] = run ? nextX : zx[l];
+                zy[l] = run ? nextY : zy[l];
+                zz[l] = run ? nextZ : zz[l];
+                derivative[l] = run ? nextDerivative : derivative[l];
+                radiusSqr[l] = run ? nextRadiusSqr : r2;
+                trap[l] = run ? std::min(trap[l], nextRadiusSqr) : trap[l];
+                remaining += run;
+            }
+
+            if (remaining == 0) {
+                break;
+            }
+        }
+    }
+
+    //Box fold, then sphere fold, then scale and add c; all of it min, max and multiplies
+    void box(float scale, const float* cx, const float* cy, const float* cz, float* zx, float* zy, float* zz,
+             float* derivative, float* radiusSqr, float* trap, int iterations)
+    {
+        const float absScale = std::abs(scale);
+        const float maxFold = BOX_FIXED_RADIUS_SQR / BOX_MIN_RADIUS_SQR;
+
+        for (int i = 0; i < iterations; i++) {
+            int remaining = 0;
+
+            for (int l = 0; l < LANES; l++) {
+                float x = std::max(std::min(zx[l], 1.0f), -1.0f) * 2.0f - zx[l];
+                float y = std::max(std::min(zy[l], 1.0f), -1.0f) * 2.0f - zy[l];
+                float z = std::max(std::min(zz[l], 1.0f), -1.0f) * 2.0f - zz[l];
+
+                float r2 = x * x + y * y + z * z;
+                float fold = std::max(std::min(BOX_FIXED_RADIUS_SQR / std::max(r2, 1e-20f), maxFold), 1.0f);
+
+                float nextX = x * fold * scale + cx[l];
+                float nextY = y * fold * scale + cy[l];
+                float nextZ = z * fold * scale + cz[l];
+                float nextDerivative = derivative[l] * fold * absScale + 1.0f;
+                float nextRadiusSqr = nextX * nextX + nextY * nextY + nextZ * nextZ;
+
+                bool run = radiusSqr[l] < BOX_BAILOUT;
+                zx[l] = run ? nextX : zx[l];
+                zy[l] = run ? nextY : zy[l];
+                zz[l] = run ? nextZ : zz[l];
+                derivative[l] = run ? nextDerivative : derivative[l];
+                radiusSqr[l] = run ? nextRadiusSqr : radiusSqr[l];
+                trap[l] = run ? std::min(trap[l], nextRadiusSqr) : trap[l];
+                remaining += run;
+            }
+
+            if (remaining == 0) {
+                break;
+            }
+        }
+    }
+}
+
+Raymarcher::Scene::Scene(Fractal fractal) :
+    fractal(fractal),
+    power(8),
+    scale(2.0),
+    iterations(fractal == Mandelbulb ? 10 : 12)
+{ }
+
+double Raymarcher::Scene::boundingRadius() const
+{
+    if (fractal == Mandelbulb) {
+        return 2.0;
+    }
+
+    //Box folds keep every coordinate within 2 (|scale| + 1) / (|scale| - 1)
+    double absScale = std::max(std::abs(scale), 1.5);
+    return 2.0 * (absScale + 1.0) / (absScale - 1.0) * std::sqrt(3.0);
+}
+
+Camera Raymarcher::Scene::overview() const
+{
+    double radius = fractal == Mandelbulb ? 1.2 : boundingRadius();
+    return Camera(radius * OVERVIEW_DISTANCE, OVERVIEW_YAW, OVERVIEW_PITCH);
+}
+
+Raymarcher::Raymarcher(const Scene& scene, const Camera& camera, const ColorScheme& colors, int width, int height, bool shadows) :
+    m_scene(scene),
+    m_width(width),
+    m_height(height),
+    m_shadows(shadows),
+    m_pixelSize((float) camera.pixelSize(height)),
+    m_far((float) (camera.position().length() + scene.boundingRadius())),
+    m_blocksX((width + BLOCK - 1) / BLOCK),
+    m_blocksY((height + BLOCK - 1) / BLOCK),
+    m_startDepth((std::size_t) m_blocksX * m_blocksY, 0.0f)
+{
+    store(camera.position(), m_origin);
+    store(camera.forward(), m_forward);
+    store(camera.right(), m_right);
+    store(camera.up(), m_up);
+    store((camera.right() * LIGHT_RIGHT + camera.up() * LIGHT_UP + camera.forward() * LIGHT_FORWARD).normalized(), m_light);
+
+    //The palette is sampled once, so that shading never touches QColor
+    const std::vector<QColor>& palette = colors.palette();
+
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        QColor color = colors.paletteColor((double) i / (PALETTE_SIZE - 1) * (double) (palette.size() - 1));
+
+        m_palette[i][0] = (float) color.red();
+        m_palette[i][1] = (float) color.green();
+        m_palette[i][2] = (float) color.blue();
+    }
+
+    m_background[0] = (float) colors.interiorColor().red();
+    m_background[1] = (float) colors.interiorColor().green();
+    m_background[2] = (float) colors.interiorColor().blue();
+}
+
+int Raymarcher::tileCount() const
+{
+    return ((m_width + TILE - 1) / TILE) * ((m_height + TILE - 1) / TILE);
+}
+
+void Raymarcher::distances(const Scene& scene, const float* x, const float* y, const float* z, int count,
+                           float* distance, float* trap)
+{
+    assert(count <= LANES);
+
+    float cx[LANES];
+    float cy[LANES];
+    float cz[LANES];
+    float zx[LANES];
+    float zy[LANES];
+    float zz[LANES];
+    float derivative[LANES];
+    float radiusSqr[LANES];
+    float minRadiusSqr[LANES];
+
+    for (int l = 0; l < LANES; l++) {
+        cx[l] = l < count ? x[l] : 0.0f;
+        cy[l] = l < count ? y[l] : 0.0f;
+        cz[l] = l < count ? z[l] : 0.0f;
+        zx[l] = cx[l];
+        zy[l] = cy[l];
+        zz[l] = cz[l];
+        derivative[l] = 1.0f;
+        radiusSqr[l] = cx[l] * cx[l] + cy[l] * cy[l] + cz[l] * cz[l];
+        minRadiusSqr[l] = radiusSqr[l];
+    }
+
+    if (scene.fractal == Mandelbox) {
+        box((float) scene.scale, cx, cy, cz, zx, zy, zz, derivative, radiusSqr, minRadiusSqr, scene.iterations);
+
+        for (int l = 0; l < count; l++) {
+            distance[l] = std::sqrt(radiusSqr[l]) / std::abs(derivative[l]);
+            trap[l] = minRadiusSqr[l];
+        }
+
+        return;
+    }
+
+    if (scene.power == 8) {
+        bulbPower8(cx, cy, cz, zx, zy, zz, derivative, radiusSqr, minRadiusSqr, scene.iterations);
+    } else {
+        bulbPower(scene.power, cx, cy, cz, zx, zy, zz, derivative, radiusSqr, minRadiusSqr, scene.iterations);
+    }
+
+    //Interior points end up with a radius below 1, so a negative distance
+    for (int l = 0; l < count; l++) {
+        float r = std::sqrt(radiusSqr[l]);
+        distance[l] = 0.5f * std::log(std::max(r, 1e-20f)) * r / derivative[l];
+        trap[l] = minRadiusSqr[l];
+    }
+}
+
+double Raymarcher::distance(const Scene& scene, const Vector3& point)
+{
+    float x = (float) point.x();
+    float y = (float) point.y();
+    float z = (float) point.z();
+    float distance;
+    float trap;
+
+    distances(scene, &x, &y, &z, 1, &distance, &trap);
+    return distance;
+}
+
+void Raymarcher::directions(const float* x, const float* y, float* dx, float* dy, float* dz) const
+{
+    for (int l = 0; l < LANES; l++) {
+        float u = (x[l] - m_width * 0.5f) * m_pixelSize;
+        float v = (y[l] - m_height * 0.5f) * m_pixelSize;
+
+        float rx = m_forward[0] + m_right[0] * u - m_up[0] * v;
+        float ry = m_forward[1] + m_right[1] * u - m_up[1] * v;
+        float rz = m_forward[2] + m_right[2] * u - m_up[2] * v;
+        float scale = 1.0f / std::sqrt(rx * rx + ry * ry + rz * rz);
+
+        dx[l] = rx * scale;
+        dy[l] = ry * scale;
+        dz[l] = rz * scale;
+    }
+}
+
+/*
+ * Marches count rays from their distances t until they get closer to the
+ * surface than hitSlope * t or leave the bounding sphere. Each step is the
+ * distance estimate less coneSlope * t, so that a cone of that slope around
+ * the ray stays clear of the surface. Rays that leave end beyond m_far.
+ * Returns the number of distance estimates.
+ */
+long long Raymarcher::march(const float* dx, const float* dy, const float* dz, float* t, int count, float coneSlope, float hitSlope) const
+{
+    float px[LANES];
+    float py[LANES];
+    float pz[LANES];
+    float distance[LANES] = { };
+    float trap[LANES];
+    int active[LANES];
+    int remaining = 0;
+    long long steps = 0;
+
+    for (int l = 0; l < LANES; l++) {
+        active[l] = l < count && t[l] <= m_far;
+        remaining += active[l];
+    }
+
+    for (int step = 0; step < MAX_STEPS && remaining > 0; step++) {
+        for (int l = 0; l < LANES; l++) {
+            px[l] = m_origin[0] + dx[l] * t[l];
+            py[l] = m_origin[1] + dy[l] * t[l];
+            pz[l] = m_origin[2] + dz[l] * t[l];
+        }
+
+        distances(m_scene, px, py, pz, count, distance, trap);
+        steps += remaining;
+        remaining = 0;
+
+        for (int l = 0; l < LANES; l++) {
+            bool hit = distance[l] < hitSlope * t[l];
+            bool run = active[l] && !hit;
+
+            t[l] = run ? t[l] + (distance[l] - coneSlope * t[l]) : t[l];
+            active[l] = run && t[l] <= m_far;
+            remaining += active[l];
+        }
+    }
+
+    return steps;
+}
+
+//Colors rays that ended at distances t, writing count pixels to out; returns the distance estimates it took
+long long Raymarcher::shade(const float* dx, const float* dy, const float* dz, const float* t, int count, QRgb* out) const
+{
+    float px[LANES];
+    float py[LANES];
+    float pz[LANES];
+    float nx[LANES];
+    float ny[LANES];
+    float nz[LANES];
+    float offset[LANES];
+    float sx[LANES];
+    float sy[LANES];
+    float sz[LANES];
+    float distance[LANES] = { };
+    float trap[LANES];
+    float surfaceTrap[LANES] = { };
+    long long steps = 0;
+    bool anyHit = false;
+
+    for (int l = 0; l < LANES; l++) {
+        px[l] = m_origin[0] + dx[l] * t[l];
+        py[l] = m_origin[1] + dy[l] * t[l];
+        pz[l] = m_origin[2] + dz[l] * t[l];
+        offset[l] = std::max(t[l] * m_pixelSize * DETAIL, 1e-6f);
+        nx[l] = 0.0f;
+        ny[l] = 0.0f;
+        nz[l] = 0.0f;
+        anyHit |= l < count && t[l] <= m_far;
+    }
+
+    if (anyHit) {
+        //Normals from the tetrahedron of estimates around the hit point
+        static const float corners[4][3] = { { 1.0f, -1.0f, -1.0f }, { -1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } };
+
+        distances(m_scene, px, py, pz, count, distance, surfaceTrap);
+        steps += count;
+
+        for (int corner = 0; corner < 4; corner++) {
+            for (int l = 0; l < LANES; l++) {
+                sx[l] = px[l] + corners[corner][0] * offset[l];
+                sy[l] = py[l] + corners[corner][1] * offset[l];
+                sz[l] = pz[l] + corners[corner][2] * offset[l];
+            }
+
+            distances(m_scene, sx, sy, sz, count, distance, trap);
+            steps += count;
+
+            for (int l = 0; l < LANES; l++) {
+                nx[l] += corners[corner][0] * distance[l];
+                ny[l] += corners[corner][1] * distance[l];
+                nz[l] += corners[corner][2] * distance[l];
+            }
+        }
+
+        for (int l = 0; l < LANES; l++) {
+            float length = std::sqrt(nx[l] * nx[l] + ny[l] * ny[l] + nz[l] * nz[l]);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+            nx[l] *= scale;
+            ny[l] *= scale;
+            nz[l] *= scale;
+        }
+    }
+
+    float occlusion[LANES];
+    float shadow[LANES];
+
+    for (int l = 0; l < LANES; l++) {
+        occlusion[l] = 0.0f;
+        shadow[l] = 1.0f;
+    }
+
+    if (anyHit) {
+        //Ambient occlusion: how much closer the surface is than the distance walked out along the normal
+        float weight = 1.0f;
+
+        for (int i = 1; i <= AO_SAMPLES; i++) {
+            float spacing[LANES];
+
+            for (int l = 0; l < LANES; l++) {
+                spacing[l] = AO_SPACING * t[l] * i + offset[l];
+                sx[l] = px[l] + nx[l] * spacing[l];
+                sy[l] = py[l] + ny[l] * spacing[l];
+                sz[l] = pz[l] + nz[l] * spacing[l];
+            }
+
+            distances(m_scene, sx, sy, sz, count, distance, trap);
+            steps += count;
+
+            for (int l = 0; l < LANES; l++) {
+                occlusion[l] += weight * std::max(spacing[l] - distance[l], 0.0f) / spacing[l];
+            }
+
+            weight *= 0.5f;
+        }
+    }
+
+    if (anyHit && m_shadows) {
+        //Soft shadows: the nearest the surface came to the ray towards the light, relative to how far along it was
+        float s[LANES];
+        int active[LANES];
+        int remaining = 0;
+
+        for (int l = 0; l < LANES; l++) {
+            s[l] = offset[l] * 4.0f;
+            active[l] = l < count && t[l] <= m_far && nx[l] * m_light[0] + ny[l] * m_light[1] + nz[l] * m_light[2] > 0.0f;
+            remaining += active[l];
+        }
+
+        for (int step = 0; step < SHADOW_STEPS && remaining > 0; step++) {
+            for (int l = 0; l < LANES; l++) {
+                sx[l] = px[l] + nx[l] * offset[l] * 2.0f + m_light[0] * s[l];
+                sy[l] = py[l] + ny[l] * offset[l] * 2.0f + m_light[1] * s[l];
+                sz[l] = pz[l] + nz[l] * offset[l] * 2.0f + m_light[2] * s[l];
+            }
+
+            distances(m_scene, sx, sy, sz, count, distance, trap);
+            steps += remaining;
+            remaining = 0;
+
+            for (int l = 0; l < LANES; l++) {
+                bool run = active[l] != 0;
+
+                shadow[l] = run ? std::min(shadow[l], SHADOW_SOFTNESS * distance[l] / s[l]) : shadow[l];
+                s[l] = run ? s[l] + std::max(distance[l], offset[l]) : s[l];
+                active[l] = run && shadow[l] > SHADOW_MIN && s[l] < m_far;
+                remaining += active[l];
+            }
+        }
+    }
+
+    for (int l = 0; l < count; l++) {
+        if (t[l] > m_far) {
+            out[l] = qRgb((int) m_background[0], (int) m_background[1], (int) m_background[2]);
+            continue;
+        }
+
+        float diffuse = std::max(nx[l] * m_light[0] + ny[l] * m_light[1] + nz[l] * m_light[2], 0.0f) * std::max(shadow[l], 0.0f);
+        float ambient = std::max(1.0f - occlusion[l], 0.0f);
+        float light = AMBIENT * ambient + DIFFUSE * diffuse;
+
+        //Squared orbit trap radii map onto the palette from 0 towards 1
+        int index = (int) (surfaceTrap[l] / (1.0f + surfaceTrap[l]) * (PALETTE_SIZE - 1));
+        index = std::max(std::min(index, PALETTE_SIZE - 1), 0);
+
+        out[l] = qRgb(std::min((int) (m_palette[index][0] * light), 255),
+                      std::min((int) (m_palette[index][1] * light), 255),
+                      std::min((int) (m_palette[index][2] * light), 255));
+    }
+
+    return steps;
+}
+
+void Raymarcher::coneRow(int blockRow, Statistics& statistics)
+{
+    //Half the diagonal of a block, so the cone holds every ray in it
+    const float coneSlope = m_pixelSize * BLOCK * 0.7072f;
+
+    float x[LANES];
+    float y[LANES];
+    float dx[LANES];
+    float dy[LANES];
+    float dz[LANES];
+    float t[LANES];
+
+    for (int first = 0; first < m_blocksX; first += LANES) {
+        int count = std::min(LANES, m_blocksX - first);
+
+        for (int l = 0; l < LANES; l++) {
+            x[l] = (first + l + 0.5f) * BLOCK;
+            y[l] = (blockRow + 0.5f) * BLOCK;
+            t[l] = 0.0f;
+        }
+
+        directions(x, y, dx, dy, dz);
+
+        //Stops once the cone is about to touch the surface, which the block's rays then approach on their own
+        statistics.steps += march(dx, dy, dz, t, count, coneSlope, coneSlope * 2.0f);
+
+        for (int l = 0; l < count; l++) {
+            m_startDepth[(std::size_t) blockRow * m_blocksX + first + l] = t[l];
+        }
+    }
+}
+
+void Raymarcher::renderTile(int tile, QImage& image, Statistics& statistics) const
+{
+    int tilesX = (m_width + TILE - 1) / TILE;
+    int left = tile % tilesX * TILE;
+    int top = tile / tilesX * TILE;
+    int right = std::min(left + TILE, m_width);
+    int bottom = std::min(top + TILE, m_height);
+
+    float x[LANES];
+    float y[LANES];
+    float dx[LANES];
+    float dy[LANES];
+    float dz[LANES];
+    float t[LANES];
+    QRgb pixels[LANES];
+
+    for (int row = top; row < bottom; row++) {
+        QRgb* line = (QRgb*) image.scanLine(row);
+
+        for (int first = left; first < right; first += LANES) {
+            int count = std::min(LANES, right - first);
+
+            for (int l = 0; l < LANES; l++) {
+                int column = std::min(first + l, right - 1);
+
+                x[l] = column + 0.5f;
+                y[l] = row + 0.5f;
+                t[l] = m_startDepth[(std::size_t) (row / BLOCK) * m_blocksX + column / BLOCK];
+            }
+
+            directions(x, y, dx, dy, dz);
+
+            statistics.steps += march(dx, dy, dz, t, count, 0.0f, m_pixelSize * DETAIL);
+            statistics.steps += shade(dx, dy, dz, t, count, pixels);
+            statistics.rays += count;
+
+            std::copy(pixels, pixels + count, line + first);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef Raymarcher_H
+#define Raymarcher_H
+
+#include <vector>
+
+#include <QImage>
+
+#include "Camera.h"
+#include "ColorScheme.h"
+
+/*
+ * Renders 3D fractals by sphere tracing their distance estimates. Rays are
+ * marched in packets of LANES neighbouring pixels whose steps run side by
+ * side in branch free loops over lane arrays, in single precision so that a
+ * vector register holds as many rays as possible.
+ *
+ * A frame is rendered in two passes. The depth pass marches one cone per
+ * BLOCK x BLOCK pixels, wide enough to hold all of their rays, until it gets
+ * close to the surface; the distance it got is free of surface for every
+ * ray in the block, so the image pass starts them there instead of at the
+ * camera. The image pass renders TILE x TILE pixel tiles: surface color from
+ * the palette by orbit trap, lit by a light that moves with the camera, with
+ * ambient occlusion and, unless asked not to, soft shadows.
+ *
+ * coneRow() and renderTile() may run concurrently for different rows and
+ * tiles; every tile has to wait for the whole depth pass.
+ */
+class Raymarcher
+{
+    public:
+        enum Fractal
+        {
+            Mandelbulb,
+            Mandelbox
+        };
+
+        struct Scene
+        {
+            Fractal fractal;
+
+            //Mandelbulb exponent; the usual 8 takes a path without trigonometry
+            int power;
+
+            //Mandelbox fold scale
+            double scale;
+
+            int iterations;
+
+            explicit Scene(Fractal fractal = Mandelbulb);
+
+            //Radius of a sphere around the origin that holds the whole fractal
+            double boundingRadius() const;
+
+            //A view of the whole fractal
+            Camera overview() const;
+        };
+
+        struct Statistics
+        {
+            long long rays;
+
+            //Distance estimates, each one scene iterations deep
+            long long steps;
+
+            Statistics() : rays(0), steps(0) { }
+        };
+
+        static const int LANES = 8;
+        static const int BLOCK = 8;
+        static const int TILE = 32;
+
+    private:
+        static const int PALETTE_SIZE = 256;
+
+        Scene m_scene;
+        int m_width;
+        int m_height;
+        bool m_shadows;
+
+        //The camera in single precision
+        float m_origin[3];
+        float m_forward[3];
+        float m_right[3];
+        float m_up[3];
+        float m_light[3];
+        float m_pixelSize;
+        float m_far;
+
+        int m_blocksX;
+        int m_blocksY;
+        std::vector<float> m_startDepth;
+
+        float m_palette[PALETTE_SIZE][3];
+        float m_background[3];
+
+        void directions(const float* x, const float* y, float* dx, float* dy, float* dz) const;
+        long long march(const float* dx, const float* dy, const float* dz, float* t, int count, float coneSlope, float hitSlope) const;
+        long long shade(const float* dx, const float* dy, const float* dz, const float* t, int count, QRgb* out) const;
+
+    public:
+        Raymarcher(const Scene& scene, const Camera& camera, const ColorScheme& colors, int width, int height, bool shadows);
+
+        int blockRows() const       { return m_blocksY; }
+        int tileCount() const;
+
+        //Depth pass for one row of blocks
+        void coneRow(int blockRow, Statistics& statistics);
+
+        //Pixels of a tile, once the depth pass is complete
+        void renderTile(int tile, QImage& image, Statistics& statistics) const;
+
+        /*
+         * Distance estimates of count <= LANES points. Negative or tiny
+         * distances are on or inside the surface. trap receives the
+         * smallest squared orbit radius of each point, for coloring.
+         */
+        static void distances(const Scene& scene, const float* x, const float* y, const float* z, int count,
+                              float* distance, float* trap);
+        static double distance(const Scene& scene, const Vector3& point);
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "RenderEngine.h"
+#include "SampleBuffer.h"
+#include "SampleGrid.h"
+#include "EscapeTime.h"
+#include "ColorScheme.h"
+#include "ColorTable.h"
+#include "Downsampler.h"
+#include "Topology.h"
+
+#include <cstring>
+
+namespace
+{
+    const int MAX_ANTIALIASING = 32;
+
+    bool valid(const RenderEngine::Request& request)
+    {
+        if (request.width < 2 || request.height < 2 || request.maxIterations <= 0 || request.buffer == nullptr ||
+            request.antialiasing < 1 || request.antialiasing > MAX_ANTIALIASING || request.threads < 0) {
+            return false;
+        }
+
+        //Row sizes in ptrdiff_t, since wide requests overflow int
+        if (request.output == RenderEngine::Iterations) {
+            return request.stride >= (std::ptrdiff_t) request.width * request.antialiasing * (std::ptrdiff_t) sizeof(std::int32_t);
+        }
+
+        return request.output == RenderEngine::Rgba &&
+               request.stride >= (std::ptrdiff_t) request.width * 4 &&
+               !request.palette.empty() &&
+               request.coloring >= RenderEngine::IterationCount && request.coloring <= RenderEngine::InteriorPeriod &&
+               request.filter >= RenderEngine::Box && request.filter <= RenderEngine::Gaussian;
+    }
+
+    QColor color(std::uint32_t rgb)
+    {
+        return QColor((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+    }
+}
+
+RenderEngine::Request::Request() :
+    x1(-2.0),
+    y1(-1.0),
+    x2(1.0),
+    y2(1.0),
+    width(0),
+    height(0),
+    antialiasing(1),
+    maxIterations(256),
+    output(Rgba),
+    buffer(nullptr),
+    stride(0),
+    interiorColor(0x000000),
+    coloring(IterationCount),
+    filter(Box),
+    threads(0)
+{ }
+
+RenderEngine::RenderEngine()
+{ }
+
+RenderEngine::~RenderEngine()
+{
+    reapJobs(true);
+}
+
+void RenderEngine::reapJobs(bool all)
+{
+    std::unique_lock<std::mutex> lock(m_jobsMutex);
+
+    for (std::size_t i = 0; i < m_jobs.size(); ) {
+        if (all || m_jobs[i].done->load()) {
+            m_jobs[i].thread.join();
+            m_jobs.erase(m_jobs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+std::future<RenderEngine::Status> RenderEngine::submit(const Request& request, const CancelToken& token, const Callback& callback)
+{
+    //Threads of jobs that ended since the last submission are joined here, so they do not pile up
+    reapJobs(false);
+
+    std::shared_ptr<std::promise<Status>> promise(new std::promise<Status>());
+    std::future<Status> future = promise->get_future();
+
+    Job job;
+    job.done.reset(new std::atomic<bool>(false));
+
+    std::shared_ptr<std::atomic<bool>> done = job.done;
+
+    job.thread = std::thread([request, token, callback, promise, done]() {
+        Status status = render(request, token);
+
+        if (callback) {
+            callback(status);
+        }
+
+        promise->set_value(status);
+        done->store(true);
+    });
+
+    std::unique_lock<std::mutex> lock(m_jobsMutex);
+    m_jobs.push_back(std::move(job));
+
+    return future;
+}
+
+RenderEngine::Status RenderEngine::render(const Request& request, const CancelToken& token)
+{
+    if (!valid(request)) {
+        return Invalid;
+    }
+
+    int width = request.width;
+    int height = request.height;
+    int antialiasing = request.antialiasing;
+    int sampleWidth = width * antialiasing;
+    bool rgba = request.output == Rgba;
+    int threads = request.threads > 0 ? request.threads : Topology::defaultWorkerCount();
+
+    SampleGrid grid(ZoomRegion(request.x1, request.y1, request.x2, request.y2), width, height, antialiasing);
+    ColorScheme::Coloring coloring = (ColorScheme::Coloring) request.coloring;
+    unsigned int channels = rgba ? ColorScheme::channels(coloring) : (unsigned int) SampleBuffer::Iterations;
+    EscapeTimeRowFunction computeRow = escapeTimeRow(channels);
+
+    std::vector<QColor> palette;
+
+    for (std::uint32_t rgb : request.palette) {
+        palette.push_back(color(rgb));
+    }
+
+    std::unique_ptr<ColorTable> colorTable(rgba ? new ColorTable(ColorScheme(palette, color(request.interiorColor)), request.maxIterations) : nullptr);
+    Downsampler downsampler((Downsampler::Filter) request.filter, antialiasing);
+
+    //Real coordinates are the same for every sample row
+    std::vector<double> reals(sampleWidth);
+
+    for (int sx = 0; sx < sampleWidth; sx++) {
+        reals[sx] = grid.real(sx);
+    }
+
+    std::atomic<int> nextRow(0);
+    std::atomic<int> rowsDone(0);
+    std::atomic<bool> outOfMemory(false);
+    std::vector<std::thread> workers;
+
+    //Each thread computes whole pixel rows into its own scratch space and writes them out itself
+    auto rowTask = [&]() {
+        SampleBuffer samples;
+
+        //One thread without scratch space stops them all; the host gets a status rather than a crash
+        if (!samples.reset(sampleWidth, antialiasing, channels)) {
+            outOfMemory = true;
+            return;
+        }
+
+        std::vector<float> indices(sampleWidth);
+        std::vector<unsigned char> red(rgba ? samples.size() : 0);
+        std::vector<unsigned char> green(rgba ? samples.size() : 0);
+        std::vector<unsigned char> blue(rgba ? samples.size() : 0);
+        std::vector<QRgb> pixels(rgba ? width : 0);
+        int y;
+
+        while (!token.canceled() && !outOfMemory && (y = nextRow++) < height) {
+            for (int aay = 0; aay < antialiasing; aay++) {
+                computeRow(reals.data(), grid.imag(y * antialiasing + aay), sampleWidth, request.maxIterations, 2.0,
+                           samples, samples.index(0, aay), false);
+            }
+
+            if (!rgba) {
+                for (int aay = 0; aay < antialiasing; aay++) {
+                    unsigned char* row = (unsigned char*) request.buffer + (std::ptrdiff_t) (y * antialiasing + aay) * request.stride;
+                    std::memcpy(row, samples.iterations() + samples.index(0, aay), sampleWidth * sizeof(std::int32_t));
+                }
+
+                rowsDone++;
+                continue;
+            }
+
+            for (int aay = 0; aay < antialiasing; aay++) {
+                std::size_t rowStart = samples.index(0, aay);
+
+                ColorScheme::indices(coloring, samples, rowStart, sampleWidth, request.maxIterations, indices.data());
+                colorTable->lookup(indices.data(), sampleWidth, &red[rowStart], &green[rowStart], &blue[rowStart]);
+            }
+
+            downsampler.downsample(red.data(), green.data(), blue.data(), sampleWidth, width, pixels.data());
+
+            unsigned char* out = (unsigned char*) request.buffer + (std::ptrdiff_t) y * request.stride;
+
+            for (int x = 0; x < width; x++) {
+                out[x * 4] = qRed(pixels[x]);
+                out[x * 4 + 1] = qGreen(pixels[x]);
+                out[x * 4 + 2] = qBlue(pixels[x]);
+                out[x * 4 + 3] = 0xff;
+            }
+
+            rowsDone++;
+        }
+    };
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(rowTask);
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    if (outOfMemory) {
+        return OutOfMemory;
+    }
+
+    return rowsDone == height ? Finished : Canceled;
+}
@@ -0,0 +1,137 @@
+#ifndef RenderEngine_H
+#define RenderEngine_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Renderer for embedding, without the GUI: no QObject, no event loop and no
+ * QImage. A job describes a view and a buffer owned by the caller, and the
+ * rows are written straight into that buffer as they finish. Jobs run on
+ * their own threads, several at a time if submitted so; each can be limited
+ * to a number of threads and canceled through its token.
+ *
+ * This header needs nothing but the standard library, but the library itself
+ * colors through the viewer's QColor based palettes and so links QtGui; it
+ * has to be available at run time, though no QApplication is needed.
+ */
+class RenderEngine
+{
+    public:
+        enum Status
+        {
+            Finished,
+            Canceled,
+            //The request does not describe a renderable job; nothing was written
+            Invalid,
+            //A render thread could not get its scratch space; the buffer may be partly written
+            OutOfMemory
+        };
+
+        enum Output
+        {
+            //Four bytes per pixel, red, green, blue and alpha in memory order
+            Rgba,
+            //The iteration count of every sample as int32_t, -1 for samples that did not escape;
+            //width * antialiasing by height * antialiasing of them
+            Iterations
+        };
+
+        //Same values as ColorScheme::Coloring and Downsampler::Filter
+        enum Coloring
+        {
+            IterationCount,
+            SmoothCount,
+            FinalMagnitude,
+            OrbitTrapDistance,
+            InteriorPeriod
+        };
+
+        enum Filter
+        {
+            Box,
+            Tent,
+            Gaussian
+        };
+
+        struct Request
+        {
+            //Corners of the view in the complex plane, at the centers of the corner pixels
+            double x1;
+            double y1;
+            double x2;
+            double y2;
+            int width;
+            int height;
+            int antialiasing;
+            int maxIterations;
+
+            Output output;
+            void* buffer;
+            //Bytes from the start of one row to the next: pixel rows for Rgba, sample rows for Iterations
+            std::ptrdiff_t stride;
+
+            //Rgba only: palette as 0xRRGGBB, and how samples are mapped onto it
+            std::vector<std::uint32_t> palette;
+            std::uint32_t interiorColor;
+            Coloring coloring;
+            Filter filter;
+
+            //Render threads of this job; 0 derives the count from CPU affinity and cgroup quota
+            int threads;
+
+            Request();
+        };
+
+        //Shared between the caller and the job; canceling stops the job after the rows in progress
+        class CancelToken
+        {
+            private:
+                std::shared_ptr<std::atomic<bool>> m_canceled;
+
+            public:
+                CancelToken() : m_canceled(new std::atomic<bool>(false)) { }
+
+                void cancel()                   { m_canceled->store(true); }
+                bool canceled() const           { return m_canceled->load(std::memory_order_relaxed); }
+        };
+
+        //Called on the job's thread once it ends, before its future becomes ready
+        typedef std::function<void(Status)> Callback;
+
+    private:
+        struct Job
+        {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+
+        std::mutex m_jobsMutex;
+        std::vector<Job> m_jobs;
+
+        RenderEngine(const RenderEngine&);
+        RenderEngine& operator=(const RenderEngine&);
+
+        void reapJobs(bool all);
+
+    public:
+        RenderEngine();
+
+        //Waits for all submitted jobs
+        ~RenderEngine();
+
+        //Starts a job in the background; the request's buffer must stay valid until it ends
+        std::future<Status> submit(const Request& request, const CancelToken& token = CancelToken(), const Callback& callback = Callback());
+
+        //Starts the request's threads and blocks the calling thread until they are done
+        static Status render(const Request& request, const CancelToken& token = CancelToken());
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "RenderEngineC.h"
+#include "RenderEngine.h"
+
+struct fraktal_engine
+{
+    RenderEngine engine;
+};
+
+struct fraktal_job
+{
+    RenderEngine::CancelToken token;
+    std::shared_future<RenderEngine::Status> status;
+};
+
+fraktal_engine* fraktal_engine_create(void)
+{
+    return new fraktal_engine();
+}
+
+void fraktal_engine_destroy(fraktal_engine* engine)
+{
+    delete engine;
+}
+
+fraktal_job* fraktal_submit(fraktal_engine* engine, const fraktal_request* request, fraktal_callback callback, void* user_data)
+{
+    RenderEngine::Request job;
+    job.x1 = request->x1;
+    job.y1 = request->y1;
+    job.x2 = request->x2;
+    job.y2 = request->y2;
+    job.width = request->width;
+    job.height = request->height;
+    job.antialiasing = request->antialiasing;
+    job.maxIterations = request->max_iterations;
+    job.output = (RenderEngine::Output) request->output;
+    job.buffer = request->buffer;
+    job.stride = request->stride;
+    job.interiorColor = request->interior_color;
+    job.coloring = (RenderEngine::Coloring) request->coloring;
+    job.filter = (RenderEngine::Filter) request->filter;
+    job.threads = request->threads;
+
+    if (request->palette != nullptr && request->palette_size > 0) {
+        job.palette.assign(request->palette, request->palette + request->palette_size);
+    }
+
+    RenderEngine::Callback done;
+
+    if (callback != nullptr) {
+        done = [callback, user_data](RenderEngine::Status status) {
+            callback((int) status, user_data);
+        };
+    }
+
+    fraktal_job* handle = new fraktal_job();
+    handle->status = engine->engine.submit(job, handle->token, done).share();
+    return handle;
+}
+
+void fraktal_cancel(fraktal_job* job)
+{
+    job->token.cancel();
+}
+
+int fraktal_wait(fraktal_job* job)
+{
+    return (int) job->status.get();
+}
+
+void fraktal_job_release(fraktal_job* job)
+{
+    delete job;
+}
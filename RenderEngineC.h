@@ -0,0 +1,80 @@
+#ifndef RenderEngineC_H
+#define RenderEngineC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C interface to RenderEngine. Enum values and field meanings are the same
+ * as in RenderEngine::Request; every submitted job must be released once the
+ * caller is done with it, which does not cancel it. Like RenderEngine, the
+ * library links QtGui.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fraktal_engine fraktal_engine;
+typedef struct fraktal_job fraktal_job;
+
+enum
+{
+    FRAKTAL_FINISHED = 0,
+    FRAKTAL_CANCELED = 1,
+    FRAKTAL_INVALID = 2,
+    FRAKTAL_OUT_OF_MEMORY = 3
+};
+
+enum
+{
+    FRAKTAL_OUTPUT_RGBA = 0,
+    FRAKTAL_OUTPUT_ITERATIONS = 1
+};
+
+typedef struct fraktal_request
+{
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+    int width;
+    int height;
+    int antialiasing;
+    int max_iterations;
+
+    int output;
+    void* buffer;
+    ptrdiff_t stride;
+
+    const uint32_t* palette;
+    int palette_size;
+    uint32_t interior_color;
+    int coloring;
+    int filter;
+
+    int threads;
+} fraktal_request;
+
+//Called on the job's thread with one of the status values above
+typedef void (*fraktal_callback)(int status, void* user_data);
+
+fraktal_engine* fraktal_engine_create(void);
+
+//Waits for all jobs submitted to the engine
+void fraktal_engine_destroy(fraktal_engine* engine);
+
+//The request and its palette are copied; its buffer must stay valid until the job ends. The callback may be null
+fraktal_job* fraktal_submit(fraktal_engine* engine, const fraktal_request* request, fraktal_callback callback, void* user_data);
+
+void fraktal_cancel(fraktal_job* job);
+
+//Blocks until the job ends and returns its status
+int fraktal_wait(fraktal_job* job);
+
+void fraktal_job_release(fraktal_job* job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
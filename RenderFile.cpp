@@ -0,0 +1,409 @@
+#include "RenderFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::uint32_t MAGIC = 0x52544b46; // "FKTR"
+    //Version 2 appends the formula after the palette; version 1 documents are Mandelbrot renders
+    const std::uint32_t VERSION = 2;
+
+    //Written as raw bytes, so it reads back differently on a machine of the other byte order
+    const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    //The header fills the first page and every plane starts on a page boundary
+    const std::size_t PAGE = 4096;
+    const int MAX_PALETTE = 256;
+
+    const int COLORING_COUNT = ColorScheme::ConvergedRoot + 1;
+    const int FILTER_COUNT = Downsampler::Gaussian + 1;
+
+    std::size_t pageAlign(std::size_t offset)
+    {
+        return (offset + PAGE - 1) / PAGE * PAGE;
+    }
+
+    class HeaderWriter
+    {
+        private:
+            std::vector<unsigned char>& m_data;
+
+        public:
+            HeaderWriter(std::vector<unsigned char>& data) :
+                m_data(data)
+            { }
+
+            void u32(std::uint32_t value)
+            {
+                for (int i = 0; i < 4; i++) {
+                    m_data.push_back((unsigned char) (value >> (i * 8)));
+                }
+            }
+
+            void u64(std::uint64_t value)
+            {
+                u32((std::uint32_t) value);
+                u32((std::uint32_t) (value >> 32));
+            }
+
+            void f64(double value)
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                u64(bits);
+            }
+
+            void raw(std::uint32_t value)
+            {
+                const unsigned char* bytes = (const unsigned char*) &value;
+                m_data.insert(m_data.end(), bytes, bytes + sizeof(value));
+            }
+    };
+
+    class HeaderReader
+    {
+        private:
+            const unsigned char* m_data;
+            std::size_t m_pos;
+
+        public:
+            HeaderReader(const unsigned char* data) :
+                m_data(data),
+                m_pos(0)
+            { }
+
+            //Reads stay inside the header page; a truncated header reads as zeros
+            std::uint32_t u32()
+            {
+                std::uint32_t value = 0;
+
+                for (int i = 0; i < 4 && m_pos < PAGE; i++) {
+                    value |= (std::uint32_t) m_data[m_pos++] << (i * 8);
+                }
+
+                return value;
+            }
+
+            std::uint64_t u64()
+            {
+                std::uint64_t value = u32();
+                return value | (std::uint64_t) u32() << 32;
+            }
+
+            double f64()
+            {
+                std::uint64_t bits = u64();
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+
+            std::uint32_t raw()
+            {
+                std::uint32_t value = 0;
+
+                if (m_pos + sizeof(value) <= PAGE) {
+                    std::memcpy(&value, m_data + m_pos, sizeof(value));
+                    m_pos += sizeof(value);
+                }
+
+                return value;
+            }
+    };
+
+    struct Mapping
+    {
+        void* data;
+        std::size_t size;
+
+        Mapping(void* data, std::size_t size) : data(data), size(size) { }
+        ~Mapping() { ::munmap(data, size); }
+    };
+}
+
+RenderFile::RenderFile() :
+    m_view(),
+    m_mapping(),
+    m_sampleWidth(0),
+    m_sampleHeight(0),
+    m_channels(SampleBuffer::NoChannels)
+{
+    std::memset(m_planeOffsets, 0, sizeof(m_planeOffsets));
+}
+
+bool RenderFile::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    struct stat status;
+    void* data = MAP_FAILED;
+
+    if (::fstat(fd, &status) == 0 && (std::size_t) status.st_size >= PAGE) {
+        //Private and writable: samples attached from the mapping can be iterated further in memory
+        data = ::mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << std::endl;
+        return false;
+    }
+
+    std::size_t fileSize = status.st_size;
+    std::shared_ptr<Mapping> mapping = std::make_shared<Mapping>(data, fileSize);
+    HeaderReader reader((const unsigned char*) data);
+    View view;
+
+    std::uint32_t magic = reader.u32();
+    std::uint32_t version = reader.u32();
+
+    if (magic != MAGIC || version < 1 || version > VERSION) {
+        std::cerr << path << " is not a fractal document" << std::endl;
+        return false;
+    }
+
+    bool sameByteOrder = reader.raw() == BYTE_ORDER_MARK;
+
+    view.x1 = reader.f64();
+    view.y1 = reader.f64();
+    view.x2 = reader.f64();
+    view.y2 = reader.f64();
+    view.width = (std::int32_t) reader.u32();
+    view.height = (std::int32_t) reader.u32();
+    view.antialiasing = (std::int32_t) reader.u32();
+    int coloring = (std::int32_t) reader.u32();
+    int filter = (std::int32_t) reader.u32();
+    view.maxIterations = (std::int32_t) reader.u32();
+    view.autoIterations = reader.u32() != 0;
+
+    int sampleWidth = (std::int32_t) reader.u32();
+    int sampleHeight = (std::int32_t) reader.u32();
+    unsigned int channels = reader.u32();
+    std::uint64_t offsets[SampleBuffer::PLANE_COUNT];
+    std::uint64_t sizes[SampleBuffer::PLANE_COUNT];
+
+    for (int i = 0; i < SampleBuffer::PLANE_COUNT; i++) {
+        offsets[i] = reader.u64();
+        sizes[i] = reader.u64();
+    }
+
+    bool logarithmic = reader.u32() != 0;
+    bool cycleColors = reader.u32() != 0;
+    QRgb interior = reader.u32();
+    int paletteSize = (std::int32_t) reader.u32();
+
+    if (!(view.x2 > view.x1 && view.y2 > view.y1) ||
+        view.width <= 0 || view.height <= 0 ||
+        view.antialiasing <= 0 || view.antialiasing > 32 ||
+        coloring < 0 || coloring >= COLORING_COUNT ||
+        filter < 0 || filter >= FILTER_COUNT ||
+        view.maxIterations <= 0 ||
+        paletteSize <= 0 || paletteSize > MAX_PALETTE) {
+        std::cerr << path << " has invalid view parameters" << std::endl;
+        return false;
+    }
+
+    std::vector<QColor> palette;
+
+    for (int i = 0; i < paletteSize; i++) {
+        QRgb color = reader.u32();
+        palette.push_back(QColor(qRed(color), qGreen(color), qBlue(color)));
+    }
+
+    if (version >= 2) {
+        int kind = (std::int32_t) reader.u32();
+        double relaxationReal = reader.f64();
+        double relaxationImag = reader.f64();
+        int coefficientCount = (std::int32_t) reader.u32();
+        std::vector<std::complex<double>> coefficients;
+
+        for (int i = 0; i < coefficientCount && i <= Formula::MAX_DEGREE; i++) {
+            double real = reader.f64();
+            coefficients.push_back(std::complex<double>(real, reader.f64()));
+        }
+
+        if (kind < Formula::Mandelbrot || kind > Formula::Nova ||
+            (kind != Formula::Mandelbrot && (coefficientCount < 2 || coefficientCount > Formula::MAX_DEGREE + 1 || coefficients[0] == 0.0))) {
+            std::cerr << path << " has an invalid formula" << std::endl;
+            return false;
+        }
+
+        view.formula = Formula((Formula::Kind) kind, coefficients, std::complex<double>(relaxationReal, relaxationImag));
+    }
+
+    view.coloring = (ColorScheme::Coloring) coloring;
+    view.filter = (Downsampler::Filter) filter;
+    view.colors = ColorScheme(palette, QColor(qRed(interior), qGreen(interior), qBlue(interior)), logarithmic, cycleColors);
+
+    //Samples must cover the image evenly at the stored antialiasing, and every plane of their channels has to lie inside the file
+    bool samplesValid = channels != SampleBuffer::NoChannels && (channels & ~SampleBuffer::AllChannels) == 0 &&
+                        sampleWidth > 0 && sampleHeight > 0 &&
+                        sampleWidth % view.width == 0 && sampleHeight % view.height == 0 &&
+                        sampleWidth / view.width == view.antialiasing && sampleHeight / view.height == view.antialiasing;
+
+    std::size_t samples = samplesValid ? (std::size_t) sampleWidth * (std::size_t) sampleHeight : 0;
+
+    for (int i = 0; i < SampleBuffer::PLANE_COUNT && samplesValid; i++) {
+        if ((channels & SampleBuffer::planeChannel(i)) == 0) {
+            offsets[i] = 0;
+            continue;
+        }
+
+        samplesValid = offsets[i] % PAGE == 0 && offsets[i] >= PAGE &&
+                       sizes[i] == samples * SampleBuffer::planeElementSize(i) &&
+                       offsets[i] <= fileSize && sizes[i] <= fileSize - offsets[i];
+    }
+
+    if (channels != SampleBuffer::NoChannels && !samplesValid) {
+        std::cerr << path << " has invalid samples, opening the view only" << std::endl;
+    } else if (samplesValid && !sameByteOrder) {
+        std::cerr << path << " was written on a machine of a different byte order, opening the view only" << std::endl;
+        samplesValid = false;
+    }
+
+    m_view = view;
+
+    if (samplesValid) {
+        m_mapping = mapping;
+        m_sampleWidth = sampleWidth;
+        m_sampleHeight = sampleHeight;
+        m_channels = channels;
+
+        for (int i = 0; i < SampleBuffer::PLANE_COUNT; i++) {
+            m_planeOffsets[i] = offsets[i];
+        }
+    } else {
+        m_mapping.reset();
+        m_channels = SampleBuffer::NoChannels;
+    }
+
+    return true;
+}
+
+void RenderFile::attachSamples(SampleBuffer& samples) const
+{
+    assert(hasSamples());
+
+    unsigned char* base = (unsigned char*) static_cast<Mapping*>(m_mapping.get())->data;
+    void* planes[SampleBuffer::PLANE_COUNT];
+
+    for (int i = 0; i < SampleBuffer::PLANE_COUNT; i++) {
+        planes[i] = m_planeOffsets[i] != 0 ? base + m_planeOffsets[i] : nullptr;
+    }
+
+    samples.attach(m_sampleWidth, m_sampleHeight, m_channels, planes, m_mapping);
+}
+
+bool RenderFile::save(const std::string& path, const View& view, const SampleBuffer* samples)
+{
+    std::vector<unsigned char> header;
+    HeaderWriter writer(header);
+
+    writer.u32(MAGIC);
+    writer.u32(VERSION);
+    writer.raw(BYTE_ORDER_MARK);
+    writer.f64(view.x1);
+    writer.f64(view.y1);
+    writer.f64(view.x2);
+    writer.f64(view.y2);
+    writer.u32(view.width);
+    writer.u32(view.height);
+    writer.u32(view.antialiasing);
+    writer.u32(view.coloring);
+    writer.u32(view.filter);
+    writer.u32(view.maxIterations);
+    writer.u32(view.autoIterations ? 1 : 0);
+
+    writer.u32(samples != nullptr ? samples->width() : 0);
+    writer.u32(samples != nullptr ? samples->height() : 0);
+    writer.u32(samples != nullptr ? samples->channels() : (unsigned int) SampleBuffer::NoChannels);
+
+    std::size_t offset = PAGE;
+    std::size_t offsets[SampleBuffer::PLANE_COUNT];
+
+    for (int i = 0; i < SampleBuffer::PLANE_COUNT; i++) {
+        std::size_t bytes = samples != nullptr ? samples->planeBytes(i) : 0;
+        offsets[i] = bytes > 0 ? offset : 0;
+        offset = pageAlign(offset + bytes);
+
+        writer.u64(offsets[i]);
+        writer.u64(bytes);
+    }
+
+    const std::vector<QColor>& palette = view.colors.palette();
+    int paletteSize = std::min((int) palette.size(), MAX_PALETTE);
+
+    writer.u32(view.colors.logarithmic() ? 1 : 0);
+    writer.u32(view.colors.cycleColors() ? 1 : 0);
+    writer.u32(view.colors.interiorColor().rgb());
+    writer.u32(paletteSize);
+
+    for (int i = 0; i < paletteSize; i++) {
+        writer.u32(palette[i].rgb());
+    }
+
+    const std::vector<std::complex<double>>& coefficients = view.formula.coefficients();
+
+    writer.u32(view.formula.kind());
+    writer.f64(view.formula.relaxation().real());
+    writer.f64(view.formula.relaxation().imag());
+    writer.u32(coefficients.size());
+
+    for (const std::complex<double>& coefficient : coefficients) {
+        writer.f64(coefficient.real());
+        writer.f64(coefficient.imag());
+    }
+
+    assert(header.size() <= PAGE);
+    header.resize(PAGE, 0);
+
+    std::string partial = path + ".part";
+
+    {
+        std::ofstream file(partial.c_str(), std::ios::binary | std::ios::trunc);
+        file.write((const char*) header.data(), header.size());
+
+        for (int i = 0; i < SampleBuffer::PLANE_COUNT && file.good(); i++) {
+            std::size_t bytes = samples != nullptr ? samples->planeBytes(i) : 0;
+
+            if (bytes == 0) {
+                continue;
+            }
+
+            file.seekp(offsets[i]);
+            file.write((const char*) samples->plane(i), bytes);
+        }
+
+        if (!file.good()) {
+            std::cerr << "Cannot write " << partial << std::endl;
+            std::remove(partial.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::cerr << "Cannot replace " << path << std::endl;
+        std::remove(partial.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef RenderFile_H
+#define RenderFile_H
+
+#include <memory>
+#include <string>
+
+#include "ColorScheme.h"
+#include "Downsampler.h"
+#include "Formula.h"
+#include "SampleBuffer.h"
+
+/*
+ * .fkt documents: the view parameters in a one page header, optionally
+ * followed by the planes of a finished render's SampleBuffer, each starting
+ * on a page boundary. Opening a file maps it instead of reading it, and the
+ * planes are handed to a SampleBuffer in place; pages are only read when a
+ * render touches them. The mapping is private, so continuing iterations on
+ * the attached samples never writes back to the file.
+ *
+ * Header integers are little endian and doubles IEEE 754 bit patterns, as in
+ * TileProtocol. Planes are stored in the byte order of the machine that
+ * wrote them; files from a machine of the other byte order open without
+ * their samples.
+ */
+class RenderFile
+{
+    public:
+        struct View
+        {
+            double x1;
+            double y1;
+            double x2;
+            double y2;
+
+            //Size of the image the samples were rendered for
+            int width;
+            int height;
+
+            int antialiasing;
+            ColorScheme colors;
+            ColorScheme::Coloring coloring;
+            Downsampler::Filter filter;
+            int maxIterations;
+            bool autoIterations;
+            Formula formula;
+        };
+
+    private:
+        View m_view;
+        std::shared_ptr<void> m_mapping;
+        int m_sampleWidth;
+        int m_sampleHeight;
+        unsigned int m_channels;
+        std::size_t m_planeOffsets[SampleBuffer::PLANE_COUNT];
+
+    public:
+        RenderFile();
+
+        bool open(const std::string& path);
+
+        const View& view() const        { return m_view; }
+        bool hasSamples() const         { return m_channels != 0; }
+
+        //Hands the mapped planes to samples, which keeps the file mapped for as long as it uses them
+        void attachSamples(SampleBuffer& samples) const;
+
+        //Writes atomically; samples may be null to store only the view
+        static bool save(const std::string& path, const View& view, const SampleBuffer* samples);
+};
+
+#endif
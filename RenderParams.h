@@ -1,23 +1,84 @@
 #ifndef RenderParams_H
 #define RenderParams_H
 
+#include "ColorScheme.h"
+#include "Downsampler.h"
+#include "ZoomRegion.h"
+#include "Formula.h"
+
 class RenderParams
 {
     private:
         ColorScheme m_colors;
         ZoomRegion m_region;
+        Formula m_formula;
         int m_antialiasing;
+        ColorScheme::Coloring m_coloring;
+        unsigned int m_extraChannels;
+        int m_maxIterations;
+        bool m_autoIterations;
+        int m_threadCount;
+        int m_niceness;
+        bool m_interactive;
+        Downsampler::Filter m_filter;
+        double m_focusY;
 
     public:
-        RenderParams(ZoomRegion region, ColorScheme colors, int antialiasing = 1) :
+        RenderParams(ZoomRegion region, ColorScheme colors, int antialiasing = 1,
+                     ColorScheme::Coloring coloring = ColorScheme::IterationCount, unsigned int extraChannels = 0) :
             m_colors(colors),
             m_region(region),
-            m_antialiasing(antialiasing)
+            m_formula(),
+            m_antialiasing(antialiasing),
+            m_coloring(coloring),
+            m_extraChannels(extraChannels),
+            m_maxIterations(256),
+            m_autoIterations(false),
+            m_threadCount(0),
+            m_niceness(0),
+            m_interactive(false),
+            m_filter(Downsampler::Box),
+            m_focusY(0.5)
         { }
 
+        void setFormula(const Formula& formula) { m_formula = formula; }
+        void setMaxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+        void setAutoIterations(bool autoIterations) { m_autoIterations = autoIterations; }
+        void setThreadCount(int threadCount) { m_threadCount = threadCount; }
+        void setNiceness(int niceness) { m_niceness = niceness; }
+        void setInteractive(bool interactive) { m_interactive = interactive; }
+        void setFilter(Downsampler::Filter filter) { m_filter = filter; }
+        void setFocusY(double y) { m_focusY = y; }
+
         const ColorScheme& colorScheme() const { return m_colors; }
         const ZoomRegion& zoomRegion() const { return m_region; }
+
+        //What is iterated; the Mandelbrot set unless set otherwise. Density renders always draw Mandelbrot orbits
+        const Formula& formula() const { return m_formula; }
         int antialiasing() const { return m_antialiasing; }
+        ColorScheme::Coloring coloring() const { return m_coloring; }
+        int maxIterations() const { return m_maxIterations; }
+
+        //Keep raising the iteration limit while enough pending samples escape per step
+        bool autoIterations() const { return m_autoIterations; }
+
+        //Render threads for this job; 0 derives the count from CPU affinity and cgroup quota
+        int threadCount() const { return m_threadCount; }
+
+        //Nice value the render threads lower themselves to; 0 leaves their priority alone and runs them on the shared pool
+        int niceness() const { return m_niceness; }
+
+        //Sketches shown while navigating; rendered with exactly antialiasing() samples per axis
+        bool interactive() const { return m_interactive; }
+
+        //Filter reducing each pixel's samples to its color
+        Downsampler::Filter filter() const { return m_filter; }
+
+        //Height the user is looking at, as a fraction of the image height; rows there are rendered first
+        double focusY() const { return m_focusY; }
+
+        //Channels computed in the iteration pass: the ones the coloring needs plus any requested extras
+        unsigned int channels() const { return ColorScheme::channels(m_coloring) | m_extraChannels; }
 };
 
 #endif
@@ -0,0 +1,62 @@
+#include "RenderProgress.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    //Estimates from the first few milliseconds are mostly thread startup
+    const double MIN_MEASURED_SECONDS = 0.05;
+
+    long long now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    double estimatedWork(long long totalSamples, long long samples, long long work)
+    {
+        if (samples <= 0) {
+            return 0.0;
+        }
+
+        return (double) work + (double) std::max(totalSamples - samples, 0LL) * ((double) work / (double) samples);
+    }
+}
+
+RenderProgress::RenderProgress() :
+    m_totalSamples(0),
+    m_samples(0),
+    m_work(0),
+    m_startNanoseconds(0)
+{ }
+
+void RenderProgress::start(long long totalSamples)
+{
+    m_samples.store(0, std::memory_order_relaxed);
+    m_work.store(0, std::memory_order_relaxed);
+    m_totalSamples.store(totalSamples, std::memory_order_relaxed);
+    m_startNanoseconds.store(now(), std::memory_order_relaxed);
+}
+
+double RenderProgress::fraction() const
+{
+    long long samples = m_samples.load(std::memory_order_relaxed);
+    long long work = m_work.load(std::memory_order_relaxed);
+    double estimate = estimatedWork(m_totalSamples.load(std::memory_order_relaxed), samples, work);
+
+    return estimate > 0.0 ? std::min((double) work / estimate, 1.0) : 0.0;
+}
+
+double RenderProgress::remainingSeconds() const
+{
+    long long samples = m_samples.load(std::memory_order_relaxed);
+    long long work = m_work.load(std::memory_order_relaxed);
+    double estimate = estimatedWork(m_totalSamples.load(std::memory_order_relaxed), samples, work);
+    double elapsed = (double) (now() - m_startNanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+
+    if (work <= 0 || estimate <= 0.0 || elapsed < MIN_MEASURED_SECONDS) {
+        return -1.0;
+    }
+
+    return std::max(estimate - (double) work, 0.0) / ((double) work / elapsed);
+}
@@ -0,0 +1,40 @@
+#ifndef RenderProgress_H
+#define RenderProgress_H
+
+#include <atomic>
+
+/*
+ * Progress of the running job. Render threads only add to relaxed atomic
+ * counters, the GUI polls it at its own pace. Work is counted in iterations,
+ * so a row deep in the set weighs more than one that escapes at once; the
+ * work still ahead is estimated from the mean work per sample so far, which
+ * is fair because rows are not computed in image order.
+ */
+class RenderProgress
+{
+    private:
+        std::atomic<long long> m_totalSamples;
+        std::atomic<long long> m_samples;
+        std::atomic<long long> m_work;
+        std::atomic<long long> m_startNanoseconds;
+
+    public:
+        RenderProgress();
+
+        //Starts counting towards totalSamples samples
+        void start(long long totalSamples);
+
+        void add(long long samples, long long work)
+        {
+            m_samples.fetch_add(samples, std::memory_order_relaxed);
+            m_work.fetch_add(work, std::memory_order_relaxed);
+        }
+
+        //Done share of the estimated work, between 0 and 1
+        double fraction() const;
+
+        //Time left at the throughput measured since start(); negative while there is nothing to go by
+        double remainingSeconds() const;
+};
+
+#endif
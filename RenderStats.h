@@ -0,0 +1,79 @@
+#ifndef RenderStats_H
+#define RenderStats_H
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Summary of the last job run by a BackgroundWorker
+struct RenderStats
+{
+    double milliseconds;
+    int threads;
+    int maxIterations;
+    bool pinned;
+
+    //Rows computed by threads of each NUMA node, and how many of those belonged to another node
+    std::vector<int> nodeRows;
+    int remoteRows;
+
+    //Rows copied from their reflection across the real axis instead of computed
+    int mirroredRows;
+
+    //Passes of progressive refinement, if this job refined a finished render
+    int refinePasses;
+
+    //Passes of an orbit density render
+    int densityPasses;
+
+    //Work done, also for canceled jobs; samples that never escaped count the full limit
+    long long samples;
+    long long iterations;
+    long long interiorSamples;
+
+    RenderStats() :
+        milliseconds(0.0),
+        threads(0),
+        maxIterations(0),
+        pinned(false),
+        remoteRows(0),
+        mirroredRows(0),
+        refinePasses(0),
+        densityPasses(0),
+        samples(0),
+        iterations(0),
+        interiorSamples(0)
+    { }
+
+    std::string summary() const
+    {
+        std::ostringstream text;
+        text << milliseconds << " ms, " << threads << " threads, " << maxIterations << " iterations";
+
+        if (refinePasses > 0) {
+            text << ", " << refinePasses << " refinement passes, " << samples << " samples";
+        }
+
+        if (densityPasses > 0) {
+            text << ", " << densityPasses << " density passes, " << samples << " orbits";
+        }
+
+        if (mirroredRows > 0) {
+            text << ", " << mirroredRows << " rows mirrored";
+        }
+
+        if (nodeRows.size() > 1 || pinned) {
+            text << ", " << nodeRows.size() << " NUMA nodes (rows";
+
+            for (int rows : nodeRows) {
+                text << " " << rows;
+            }
+
+            text << ", " << remoteRows << " remote)" << (pinned ? ", pinned" : "");
+        }
+
+        return text.str();
+    }
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "SampleBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+SampleBuffer::SampleBuffer() :
+    m_width(0),
+    m_height(0),
+    m_channels(NoChannels)
+{ }
+
+SampleBuffer::SampleBuffer(int width, int height, unsigned int channels) :
+    m_width(0),
+    m_height(0),
+    m_channels(NoChannels)
+{
+    reset(width, height, channels);
+}
+
+bool SampleBuffer::reset(int width, int height, unsigned int channels)
+{
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+
+    std::size_t samples = size();
+
+    bool allocated = true;
+    allocated &= m_iterations.resize(      channels & Iterations,       samples);
+    allocated &= m_smoothIterations.resize(channels & SmoothIterations, samples);
+    allocated &= m_magnitude.resize(       channels & Magnitude,        samples);
+    allocated &= m_orbitTrap.resize(       channels & OrbitTrap,        samples);
+    allocated &= m_period.resize(          channels & Period,           samples);
+    allocated &= m_zReal.resize(           channels & State,            samples);
+    allocated &= m_zImag.resize(           channels & State,            samples);
+    allocated &= m_iterated.resize(        channels & State,            samples);
+    allocated &= m_status.resize(          channels & State,            samples);
+
+    m_storage.reset();
+
+    if (!allocated) {
+        reset(0, 0, NoChannels);
+    }
+
+    return allocated;
+}
+
+void SampleBuffer::attach(int width, int height, unsigned int channels, void* const* planes, const std::shared_ptr<void>& storage)
+{
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+
+    m_iterations.attach(      channels & Iterations,       planes[0]);
+    m_smoothIterations.attach(channels & SmoothIterations, planes[1]);
+    m_magnitude.attach(       channels & Magnitude,        planes[2]);
+    m_orbitTrap.attach(       channels & OrbitTrap,        planes[3]);
+    m_period.attach(          channels & Period,           planes[4]);
+    m_zReal.attach(           channels & State,            planes[5]);
+    m_zImag.attach(           channels & State,            planes[6]);
+    m_iterated.attach(        channels & State,            planes[7]);
+    m_status.attach(          channels & State,            planes[8]);
+
+    m_storage = storage;
+}
+
+bool SampleBuffer::resizeFrom(const SampleBuffer& other, int width, int height)
+{
+    assert(other.hasChannels(State));
+    assert(&other != this);
+
+    if (!reset(width, height, other.channels())) {
+        return false;
+    }
+
+    int overlapWidth = std::min(width, other.width());
+    int overlapHeight = std::min(height, other.height());
+
+    for (int i = 0; i < PLANE_COUNT; i++) {
+        unsigned char* target = (unsigned char*) plane(i);
+        const unsigned char* source = (const unsigned char*) other.plane(i);
+        std::size_t elementSize = planeElementSize(i);
+
+        if (target == nullptr) {
+            continue;
+        }
+
+        for (int y = 0; y < overlapHeight; y++) {
+            std::memcpy(target + index(0, y) * elementSize, source + other.index(0, y) * elementSize, overlapWidth * elementSize);
+        }
+    }
+
+    //Only the status of the new samples has to be set; the kernel writes everything else
+    unsigned char* status = m_status.data();
+
+    for (int y = 0; y < height; y++) {
+        int first = y < overlapHeight ? overlapWidth : 0;
+        std::fill(status + index(first, y), status + index(0, y + 1), (unsigned char) Uncomputed);
+    }
+
+    return true;
+}
+
+void* SampleBuffer::plane(int index)
+{
+    return const_cast<void*>(static_cast<const SampleBuffer*>(this)->plane(index));
+}
+
+const void* SampleBuffer::plane(int index) const
+{
+    switch (index) {
+        case 0: return m_iterations.data();
+        case 1: return m_smoothIterations.data();
+        case 2: return m_magnitude.data();
+        case 3: return m_orbitTrap.data();
+        case 4: return m_period.data();
+        case 5: return m_zReal.data();
+        case 6: return m_zImag.data();
+        case 7: return m_iterated.data();
+        case 8: return m_status.data();
+        default: return nullptr;
+    }
+}
+
+std::size_t SampleBuffer::planeBytes(int index) const
+{
+    return plane(index) != nullptr ? size() * planeElementSize(index) : 0;
+}
+
+unsigned int SampleBuffer::planeChannel(int index)
+{
+    static const unsigned int CHANNELS[PLANE_COUNT] = {
+        Iterations, SmoothIterations, Magnitude, OrbitTrap, Period, State, State, State, State
+    };
+
+    return CHANNELS[index];
+}
+
+std::size_t SampleBuffer::planeElementSize(int index)
+{
+    static const std::size_t SIZES[PLANE_COUNT] = {
+        sizeof(int), sizeof(float), sizeof(float), sizeof(float), sizeof(int),
+        sizeof(double), sizeof(double), sizeof(int), sizeof(unsigned char)
+    };
+
+    return SIZES[index];
+}
+
+std::size_t SampleBuffer::countStatus(Status status) const
+{
+    if (!hasChannels(State)) {
+        return 0;
+    }
+
+    return std::count(m_status.data(), m_status.data() + size(), (unsigned char) status);
+}
+
+namespace
+{
+    template<class T>
+    void copyRow(T* plane, std::size_t from, std::size_t to, std::size_t count)
+    {
+        if (plane != nullptr) {
+            std::copy(plane + from, plane + from + count, plane + to);
+        }
+    }
+}
+
+void SampleBuffer::mirrorRow(int from, int to)
+{
+    std::size_t source = index(0, from);
+    std::size_t target = index(0, to);
+    std::size_t count = m_width;
+
+    copyRow(m_iterations.data(),       source, target, count);
+    copyRow(m_smoothIterations.data(), source, target, count);
+    copyRow(m_magnitude.data(),        source, target, count);
+    copyRow(m_orbitTrap.data(),        source, target, count);
+    copyRow(m_period.data(),           source, target, count);
+    copyRow(m_zReal.data(),            source, target, count);
+    copyRow(m_iterated.data(),         source, target, count);
+    copyRow(m_status.data(),           source, target, count);
+
+    //The orbit of conj(c) is the conjugate of the orbit of c
+    if (m_zImag.data() != nullptr) {
+        std::transform(m_zImag.data() + source, m_zImag.data() + source + count, m_zImag.data() + target,
+                       [](double value) { return -value; });
+    }
+}
@@ -0,0 +1,173 @@
+#ifndef SampleBuffer_H
+#define SampleBuffer_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include "PageAllocator.h"
+
+class SampleBuffer
+{
+    public:
+        enum Channel
+        {
+            Iterations       = 0x01,
+            SmoothIterations = 0x02,
+            Magnitude        = 0x04,
+            OrbitTrap        = 0x08,
+            Period           = 0x10,
+            State            = 0x20,
+
+            NoChannels       = 0x00,
+            AllChannels      = 0x3f
+        };
+
+        //Progress of a sample whose iteration state is kept in the State channel
+        enum Status
+        {
+            Pending,
+            Escaped,
+            Interior,
+
+            //Not iterated at all yet; resuming computes it from the start
+            Uncomputed
+        };
+
+    private:
+        int m_width;
+        int m_height;
+        unsigned int m_channels;
+
+        /*
+         * One plane per channel; planes for channels that were not requested
+         * report no data. Planes are left uninitialized: the kernel writes
+         * every sample, so the first touch of each page happens on the render
+         * thread computing it, which keeps pages local to that thread's node.
+         * A plane keeps its memory when it shrinks or is disabled and only
+         * reallocates when it has to grow, so renders of changing sizes reuse
+         * the same pages. An attached plane uses memory owned by someone else
+         * until the next resize.
+         */
+        template<class T>
+        class Plane
+        {
+            private:
+                T* m_data;
+                T* m_attached;
+                std::size_t m_capacity;
+                bool m_enabled;
+
+                Plane(const Plane&);
+                Plane& operator=(const Plane&);
+
+            public:
+                Plane() : m_data(nullptr), m_attached(nullptr), m_capacity(0), m_enabled(false) { }
+                ~Plane() { PageAllocator::release(m_data, m_capacity * sizeof(T)); }
+
+                //False if the memory could not be had; the plane is then disabled
+                bool resize(bool enabled, std::size_t size)
+                {
+                    m_enabled = enabled;
+                    m_attached = nullptr;
+
+                    if (enabled && size > m_capacity) {
+                        PageAllocator::release(m_data, m_capacity * sizeof(T));
+                        m_data = (T*) PageAllocator::allocate(size * sizeof(T));
+                        m_capacity = m_data != nullptr ? size : 0;
+                        m_enabled = m_data != nullptr;
+                    }
+
+                    return m_enabled == enabled;
+                }
+
+                void attach(bool enabled, void* data)
+                {
+                    m_enabled = enabled && data != nullptr;
+                    m_attached = (T*) data;
+                }
+
+                T* data()                   { return m_enabled ? (m_attached != nullptr ? m_attached : m_data) : nullptr; }
+                const T* data() const       { return m_enabled ? (m_attached != nullptr ? m_attached : m_data) : nullptr; }
+        };
+
+        Plane<int> m_iterations;
+        Plane<float> m_smoothIterations;
+        Plane<float> m_magnitude;
+        Plane<float> m_orbitTrap;
+        Plane<int> m_period;
+
+        //Iteration state, so that raising the iteration limit continues pending samples
+        Plane<double> m_zReal;
+        Plane<double> m_zImag;
+        Plane<int> m_iterated;
+        Plane<unsigned char> m_status;
+
+        //Keeps attached planes alive
+        std::shared_ptr<void> m_storage;
+
+    public:
+        static const int PLANE_COUNT = 9;
+
+        SampleBuffer();
+        SampleBuffer(int width, int height, unsigned int channels);
+
+        //False if there was not enough memory, leaving an empty buffer
+        bool reset(int width, int height, unsigned int channels);
+
+        int width() const                                   { return m_width; }
+        int height() const                                  { return m_height; }
+        std::size_t size() const                            { return (std::size_t) m_width * (std::size_t) m_height; }
+        unsigned int channels() const                       { return m_channels; }
+        bool hasChannels(unsigned int channels) const       { return (m_channels & channels) == channels; }
+        std::size_t index(int x, int y) const               { return (std::size_t) y * (std::size_t) m_width + (std::size_t) x; }
+
+        int* iterations()                                   { return m_iterations.data(); }
+        float* smoothIterations()                           { return m_smoothIterations.data(); }
+        float* magnitude()                                  { return m_magnitude.data(); }
+        float* orbitTrap()                                  { return m_orbitTrap.data(); }
+        int* period()                                       { return m_period.data(); }
+        double* zReal()                                     { return m_zReal.data(); }
+        double* zImag()                                     { return m_zImag.data(); }
+        int* iterated()                                     { return m_iterated.data(); }
+        unsigned char* status()                             { return m_status.data(); }
+
+        const int* iterations() const                       { return m_iterations.data(); }
+        const float* smoothIterations() const               { return m_smoothIterations.data(); }
+        const float* magnitude() const                      { return m_magnitude.data(); }
+        const float* orbitTrap() const                      { return m_orbitTrap.data(); }
+        const int* period() const                           { return m_period.data(); }
+        const double* zReal() const                         { return m_zReal.data(); }
+        const double* zImag() const                         { return m_zImag.data(); }
+        const int* iterated() const                         { return m_iterated.data(); }
+        const unsigned char* status() const                 { return m_status.data(); }
+
+        std::size_t countStatus(Status status) const;
+
+        /*
+         * Raw planes in a fixed order, for storing a buffer: iterations,
+         * smooth iterations, magnitude, orbit trap, period, then the four
+         * state planes. Planes of channels that are not present are null.
+         */
+        void* plane(int index);
+        const void* plane(int index) const;
+        std::size_t planeBytes(int index) const;
+        static unsigned int planeChannel(int index);
+        static std::size_t planeElementSize(int index);
+
+        //Uses planes in the same order that live in storage, such as a mapped file, instead of the buffer's own memory
+        void attach(int width, int height, unsigned int channels, void* const* planes, const std::shared_ptr<void>& storage);
+
+        /*
+         * Becomes a width x height buffer with the channels of other, holding
+         * the samples of other that overlap it when both share the top left
+         * corner. The rest are marked Uncomputed, so other must keep the
+         * State channel and the buffer is meant to be resumed.
+         */
+        bool resizeFrom(const SampleBuffer& other, int width, int height);
+
+        //Fill row to with the samples of row from, conjugated, for images symmetric about the real axis
+        void mirrorRow(int from, int to);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SampleGrid_H
+#define SampleGrid_H
+
+#include "ZoomRegion.h"
+
+#include <cmath>
+
+/*
+ * Maps sample coordinates of a width x height image rendered with
+ * antialiasing x antialiasing samples per pixel to points in the complex
+ * plane. Everything that computes samples for the same frame must go through
+ * this so that partial results line up exactly.
+ *
+ * Samples are spread evenly and centered on their pixel, so a pixel's samples
+ * are symmetric around the pixel's own coordinate.
+ */
+class SampleGrid
+{
+    private:
+
+        double m_x;
+        double m_y;
+        double m_pitchX;
+        double m_pitchY;
+        double m_offsetStep;
+        int m_antialiasing;
+
+    public:
+        SampleGrid(const ZoomRegion& region, int width, int height, int antialiasing) :
+            m_x(region.location().x()),
+            m_y(region.location().y()),
+            m_pitchX((double) region.width() / (double) (width - 1)),
+            m_pitchY((double) region.height() / (double) (height - 1)),
+            m_offsetStep(1.0 / (double) antialiasing),
+            m_antialiasing(antialiasing)
+        { }
+
+        int antialiasing() const { return m_antialiasing; }
+
+        double real(int sampleX) const
+        {
+            int x = sampleX / m_antialiasing;
+            double x_offset = ((double) (sampleX - x * m_antialiasing) + 0.5) * m_offsetStep - 0.5;
+            return ((double) x + x_offset) * m_pitchX + m_x;
+        }
+
+        double imag(int sampleY) const
+        {
+            int y = sampleY / m_antialiasing;
+            double y_offset = ((double) (sampleY - y * m_antialiasing) + 0.5) * m_offsetStep - 0.5;
+            return ((double) y + y_offset) * m_pitchY + m_y;
+        }
+
+        //Points at continuous pixel coordinates; pixel centers are at whole numbers
+        double pointReal(double x) const    { return x * m_pitchX + m_x; }
+        double pointImag(double y) const    { return y * m_pitchY + m_y; }
+
+        /*
+         * True if the sample rows are mirror images of each other across the
+         * real axis, in which case imag(sampleY) == -imag(mirrorSum - sampleY).
+         * Rows are only considered aligned if they match to a tiny fraction of
+         * the sample spacing.
+         */
+        bool realAxisMirror(int& mirrorSum) const
+        {
+            double sum = (double) m_antialiasing * (1.0 - 2.0 * m_y / m_pitchY) - 1.0;
+
+            if (!(std::abs(sum) < 1e9)) {
+                return false;
+            }
+
+            double rounded = std::floor(sum + 0.5);
+
+            if (std::abs(sum - rounded) > 1e-6) {
+                return false;
+            }
+
+            mirrorSum = (int) rounded;
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include "Socket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::string UNIX_PREFIX = "unix:";
+    const int LISTEN_BACKLOG = 16;
+
+    //How often a read with a timeout looks at its abort flag
+    const int READ_POLL_INTERVAL = 100;
+
+    bool isUnixAddress(const std::string& address)
+    {
+        return address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0;
+    }
+
+    bool unixAddress(const std::string& address, sockaddr_un& addr)
+    {
+        std::string path = address.substr(UNIX_PREFIX.size());
+
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Invalid socket path: " << path << std::endl;
+            return false;
+        }
+
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, path.c_str());
+        return true;
+    }
+
+    addrinfo* tcpAddress(const std::string& address, bool passive)
+    {
+        std::string::size_type colon = address.rfind(':');
+
+        if (colon == std::string::npos) {
+            std::cerr << "Invalid address, expected host:port: " << address << std::endl;
+            return nullptr;
+        }
+
+        std::string host = address.substr(0, colon);
+        std::string port = address.substr(colon + 1);
+
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+        addrinfo* result = nullptr;
+        int error = getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+
+        if (error != 0) {
+            std::cerr << "Cannot resolve " << address << ": " << gai_strerror(error) << std::endl;
+            return nullptr;
+        }
+
+        return result;
+    }
+}
+
+Socket::Socket() :
+    m_fd(-1),
+    m_readTimeout(0),
+    m_abort(nullptr)
+{ }
+
+Socket::Socket(int fd) :
+    m_fd(fd),
+    m_readTimeout(0),
+    m_abort(nullptr)
+{ }
+
+Socket::~Socket()
+{
+    close();
+}
+
+void Socket::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    if (!m_unixPath.empty()) {
+        ::unlink(m_unixPath.c_str());
+        m_unixPath.clear();
+    }
+}
+
+bool Socket::connect(const std::string& address)
+{
+    close();
+
+    if (isUnixAddress(address)) {
+        sockaddr_un addr;
+
+        if (!unixAddress(address, addr)) {
+            return false;
+        }
+
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (m_fd < 0 || ::connect(m_fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    addrinfo* addresses = tcpAddress(address, false);
+
+    for (addrinfo* ai = addresses; ai != nullptr; ai = ai->ai_next) {
+        m_fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if (m_fd >= 0 && ::connect(m_fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            int noDelay = 1;
+            ::setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            break;
+        }
+
+        close();
+    }
+
+    if (addresses != nullptr) {
+        freeaddrinfo(addresses);
+    }
+
+    return m_fd >= 0;
+}
+
+bool Socket::listen(const std::string& address)
+{
+    close();
+
+    if (isUnixAddress(address)) {
+        sockaddr_un addr;
+
+        if (!unixAddress(address, addr)) {
+            return false;
+        }
+
+        ::unlink(addr.sun_path);
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (m_fd < 0 || ::bind(m_fd, (sockaddr*) &addr, sizeof(addr)) != 0 || ::listen(m_fd, LISTEN_BACKLOG) != 0) {
+            std::cerr << "Cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+
+        m_unixPath = addr.sun_path;
+        return true;
+    }
+
+    addrinfo* addresses = tcpAddress(address, true);
+
+    for (addrinfo* ai = addresses; ai != nullptr; ai = ai->ai_next) {
+        m_fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        int reuse = 1;
+
+        if (m_fd >= 0 &&
+            ::setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+            ::bind(m_fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+            ::listen(m_fd, LISTEN_BACKLOG) == 0) {
+            break;
+        }
+
+        close();
+    }
+
+    if (addresses != nullptr) {
+        freeaddrinfo(addresses);
+    }
+
+    if (m_fd < 0) {
+        std::cerr << "Cannot listen on " << address << std::endl;
+    }
+
+    return m_fd >= 0;
+}
+
+bool Socket::accept(Socket& connection)
+{
+    int fd = ::accept(m_fd, nullptr, nullptr);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    connection.close();
+    connection.m_fd = fd;
+    return true;
+}
+
+void Socket::setReadTimeout(int milliseconds, const std::atomic<bool>* abort)
+{
+    m_readTimeout = milliseconds;
+    m_abort = abort;
+}
+
+bool Socket::readAll(void* data, std::size_t size)
+{
+    char* ptr = (char*) data;
+
+    while (size > 0) {
+        //Waits in short steps, so that the abort flag is seen while the peer is silent
+        if (m_readTimeout > 0 || m_abort != nullptr) {
+            int waited = 0;
+            int ready;
+
+            do {
+                if (m_abort != nullptr && *m_abort) {
+                    return false;
+                }
+
+                if (m_readTimeout > 0 && waited >= m_readTimeout) {
+                    return false;
+                }
+
+                pollfd fd;
+                fd.fd = m_fd;
+                fd.events = POLLIN;
+                fd.revents = 0;
+
+                ready = ::poll(&fd, 1, READ_POLL_INTERVAL);
+                waited += READ_POLL_INTERVAL;
+            } while (ready == 0 || (ready < 0 && errno == EINTR));
+
+            if (ready < 0) {
+                return false;
+            }
+        }
+
+        ssize_t count = ::recv(m_fd, ptr, size, 0);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            return false;
+        }
+
+        ptr += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool Socket::writeAll(const void* data, std::size_t size)
+{
+    const char* ptr = (const char*) data;
+
+    while (size > 0) {
+        ssize_t count = ::send(m_fd, ptr, size, MSG_NOSIGNAL);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            return false;
+        }
+
+        ptr += count;
+        size -= count;
+    }
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef Socket_H
+#define Socket_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+/*
+ * Minimal blocking stream socket. Addresses are either "unix:<path>" for a
+ * Unix domain socket or "<host>:<port>" for TCP.
+ */
+class Socket
+{
+    private:
+        int m_fd;
+        std::string m_unixPath;
+        int m_readTimeout;
+        const std::atomic<bool>* m_abort;
+
+        Socket(const Socket&);
+        Socket& operator=(const Socket&);
+
+    public:
+        Socket();
+        explicit Socket(int fd);
+        ~Socket();
+
+        bool connect(const std::string& address);
+        bool listen(const std::string& address);
+        bool accept(Socket& connection);
+        void close();
+
+        /*
+         * Makes readAll give up once no data has arrived for this many
+         * milliseconds, or as soon as abort is set; 0 waits forever. The
+         * abort flag has to outlive the reads.
+         */
+        void setReadTimeout(int milliseconds, const std::atomic<bool>* abort = nullptr);
+
+        //Transfer exactly size bytes; false on error, on a read timeout or if the peer closed the connection
+        bool readAll(void* data, std::size_t size);
+        bool writeAll(const void* data, std::size_t size);
+
+        bool isOpen() const { return m_fd >= 0; }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "TileCoordinator.h"
+#include "Socket.h"
+#include "JobScheduler.h"
+#include "SampleBuffer.h"
+#include "SampleGrid.h"
+#include "EscapeTime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <csignal>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    const int MAX_BAND_ATTEMPTS = 3;
+    const int MAX_CONNECT_ATTEMPTS = 20;
+    const int CONNECT_RETRY_DELAY = 100;
+    const int CANCEL_POLL_INTERVAL = 100;
+
+    //Longest a worker may stay silent on a band before it is taken for hung and the band goes elsewhere
+    const int RESULT_TIMEOUT = 120000;
+
+    struct Band
+    {
+        TileJob job;
+        int attempts;
+    };
+
+    struct SharedState
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Band> queue;
+        int outstanding;
+        int workersAlive;
+        bool failed;
+        std::mutex callbackMutex;
+    };
+
+    //A band computed on the local pool; kept between runs when it makes way for interactive work
+    struct LocalBand
+    {
+        std::unique_ptr<SampleBuffer> samples;
+        int nextRow;
+    };
+
+    //Returns false if the band stopped early because more urgent work is waiting; the band must have its samples
+    bool computeLocalBand(const TileJob& job, LocalBand& band, const JobScheduler& scheduler, const std::atomic<bool>& canceled)
+    {
+        SampleGrid grid(ZoomRegion(job.x1, job.y1, job.x2, job.y2), job.frameWidth, job.frameHeight, job.antialiasing);
+        EscapeTimeRowFunction computeRow = escapeTimeRow(SampleBuffer::Iterations);
+
+        SampleBuffer& samples = *band.samples;
+        std::vector<double> reals(samples.width());
+
+        for (int sx = 0; sx < samples.width(); sx++) {
+            reals[sx] = grid.real(job.firstColumn * job.antialiasing + sx);
+        }
+
+        //At least one row per run, so that a band always gets somewhere
+        while (band.nextRow < samples.height() && !canceled) {
+            double imag = grid.imag(job.firstRow * job.antialiasing + band.nextRow);
+            computeRow(reals.data(), imag, samples.width(), job.maxIterations, 2.0, samples, samples.index(0, band.nextRow), false);
+
+            if (++band.nextRow < samples.height() && scheduler.preempted(JobScheduler::Background)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool connectWorker(Socket& socket, const std::string& address, const std::atomic<bool>& canceled)
+    {
+        //Freshly spawned workers may not be listening yet
+        for (int attempt = 0; attempt < MAX_CONNECT_ATTEMPTS && !canceled; attempt++) {
+            if (socket.connect(address)) {
+                socket.setReadTimeout(RESULT_TIMEOUT, &canceled);
+                return true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_DELAY));
+        }
+
+        return false;
+    }
+
+    void workerLoop(const std::string& address, SharedState& state,
+                    const TileCoordinator::TileCallback& callback, const std::atomic<bool>& canceled)
+    {
+        Socket socket;
+        TileResult result;
+
+        while (true) {
+            Band band;
+
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+
+                //Bands in flight on other workers may still come back for a retry; cancellation is polled
+                while (!canceled && !state.failed && state.outstanding > 0 && state.queue.empty()) {
+                    state.changed.wait_for(lock, std::chrono::milliseconds(CANCEL_POLL_INTERVAL));
+                }
+
+                if (canceled || state.failed || state.outstanding == 0) {
+                    break;
+                }
+
+                band = state.queue.front();
+                state.queue.pop_front();
+            }
+
+            bool delivered = (socket.isOpen() || connectWorker(socket, address, canceled)) &&
+                             TileProtocol::sendJob(socket, band.job) &&
+                             TileProtocol::receiveResult(socket, result) &&
+                             result.id == band.job.id &&
+                             result.sampleWidth == band.job.columnCount * band.job.antialiasing &&
+                             result.sampleHeight == band.job.rowCount * band.job.antialiasing;
+
+            if (delivered) {
+                {
+                    std::unique_lock<std::mutex> lock(state.callbackMutex);
+                    callback(band.job, result);
+                }
+
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.outstanding--;
+                state.changed.notify_all();
+                continue;
+            }
+
+            socket.close();
+
+            if (canceled) {
+                break;
+            }
+
+            std::cerr << "Tile worker " << address << " failed or stalled on band " << band.job.id << std::endl;
+
+            std::unique_lock<std::mutex> lock(state.mutex);
+
+            if (++band.attempts >= MAX_BAND_ATTEMPTS) {
+                state.failed = true;
+            } else {
+                state.queue.push_back(band);
+            }
+
+            state.changed.notify_all();
+            lock.unlock();
+
+            //Give up on a worker that cannot even be reached any more; retrying takes a while, so without the lock
+            if (!connectWorker(socket, address, canceled)) {
+                break;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(state.mutex);
+
+        if (--state.workersAlive == 0 && state.outstanding > 0) {
+            state.failed = true;
+        }
+
+        state.changed.notify_all();
+    }
+}
+
+TileCoordinator::TileCoordinator() :
+    m_localPool(false)
+{ }
+
+TileCoordinator::~TileCoordinator()
+{
+    for (pid_t child : m_children) {
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+    }
+
+    for (const std::string& path : m_socketPaths) {
+        unlink(path.c_str());
+    }
+
+    if (!m_socketDirectory.empty()) {
+        rmdir(m_socketDirectory.c_str());
+    }
+}
+
+void TileCoordinator::addWorker(const std::string& address)
+{
+    m_addresses.push_back(address);
+}
+
+bool TileCoordinator::spawnLocalWorkers(int count, int niceness)
+{
+    char executable[4096];
+    ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+
+    if (length <= 0) {
+        std::cerr << "Cannot locate own executable to spawn tile workers" << std::endl;
+        return false;
+    }
+
+    executable[length] = '\0';
+
+    //mkdtemp makes the directory accessible to this user only
+    if (m_socketDirectory.empty()) {
+        const char* runtime = getenv("XDG_RUNTIME_DIR");
+        std::string pattern = std::string(runtime != nullptr && runtime[0] != '\0' ? runtime : "/tmp") + "/fraktal-XXXXXX";
+        std::vector<char> directory(pattern.begin(), pattern.end());
+        directory.push_back('\0');
+
+        if (mkdtemp(directory.data()) == nullptr) {
+            std::cerr << "Cannot create a directory for tile worker sockets in " << pattern << std::endl;
+            return false;
+        }
+
+        m_socketDirectory = directory.data();
+    }
+
+    for (int i = 0; i < count; i++) {
+        std::ostringstream path;
+        path << m_socketDirectory << "/worker-" << m_children.size() << ".sock";
+        std::string address = "unix:" + path.str();
+
+        pid_t child = fork();
+
+        if (child < 0) {
+            return false;
+        }
+
+        if (child == 0) {
+            if (niceness > 0 && nice(niceness) == -1) {
+                _exit(126);
+            }
+
+            execl(executable, executable, "--worker", address.c_str(), (char*) nullptr);
+            _exit(127);
+        }
+
+        m_children.push_back(child);
+        m_socketPaths.push_back(path.str());
+        m_addresses.push_back(address);
+    }
+
+    return true;
+}
+
+bool TileCoordinator::render(const TileJob& frame, int bandRows, const TileCallback& callback, const std::atomic<bool>& canceled)
+{
+    std::vector<TileJob> jobs;
+
+    for (int row = 0; row < frame.frameHeight; row += bandRows) {
+        TileJob job = frame;
+        job.firstRow = row;
+        job.rowCount = std::min(bandRows, frame.frameHeight - row);
+        job.firstColumn = 0;
+        job.columnCount = frame.frameWidth;
+        jobs.push_back(job);
+    }
+
+    return render(jobs, callback, canceled);
+}
+
+bool TileCoordinator::render(const std::vector<TileJob>& jobs, const TileCallback& callback, const std::atomic<bool>& canceled)
+{
+    if (m_localPool) {
+        return renderLocal(jobs, callback, canceled);
+    }
+
+    if (m_addresses.empty()) {
+        return false;
+    }
+
+    SharedState state;
+    state.outstanding = 0;
+    state.workersAlive = m_addresses.size();
+    state.failed = false;
+
+    for (const TileJob& job : jobs) {
+        Band band;
+        band.job = job;
+        band.job.id = state.outstanding++;
+        band.attempts = 0;
+        state.queue.push_back(band);
+    }
+
+    std::vector<std::thread> threads;
+
+    for (const std::string& address : m_addresses) {
+        threads.emplace_back(workerLoop, std::cref(address), std::ref(state), std::cref(callback), std::cref(canceled));
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return !canceled && !state.failed && state.outstanding == 0;
+}
+
+bool TileCoordinator::renderLocal(const std::vector<TileJob>& jobs, const TileCallback& callback, const std::atomic<bool>& canceled)
+{
+    JobScheduler& scheduler = JobScheduler::shared();
+    std::vector<LocalBand> bands(jobs.size());
+    std::mutex callbackMutex;
+    std::atomic<bool> failed(false);
+
+    JobScheduler::JobHandle job = scheduler.submit(JobScheduler::Background, jobs.size(), [&](int i) {
+        LocalBand& band = bands[i];
+
+        if (!band.samples) {
+            band.samples.reset(new SampleBuffer(jobs[i].columnCount * jobs[i].antialiasing, jobs[i].rowCount * jobs[i].antialiasing, SampleBuffer::Iterations));
+            band.nextRow = 0;
+
+            //Out of memory; the render fails as a whole rather than leaving a hole
+            if (!band.samples->hasChannels(SampleBuffer::Iterations)) {
+                failed = true;
+                band.samples.reset();
+                return true;
+            }
+        }
+
+        if (!computeLocalBand(jobs[i], band, scheduler, canceled)) {
+            return false;
+        }
+
+        if (!canceled && !failed) {
+            TileJob bandJob = jobs[i];
+            bandJob.id = i;
+
+            TileResult result;
+            result.id = i;
+            result.sampleWidth = band.samples->width();
+            result.sampleHeight = band.samples->height();
+            result.iterations.assign(band.samples->iterations(), band.samples->iterations() + band.samples->size());
+
+            std::unique_lock<std::mutex> lock(callbackMutex);
+            callback(bandJob, result);
+        }
+
+        band.samples.reset();
+        return true;
+    });
+
+    scheduler.wait(job);
+
+    return !canceled && !failed;
+}
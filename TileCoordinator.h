@@ -0,0 +1,58 @@
+#ifndef TileCoordinator_H
+#define TileCoordinator_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "TileProtocol.h"
+
+/*
+ * Shards a frame into bands (or any other pieces) and farms them out to TileServer processes, either
+ * already running somewhere on the network or spawned locally. A band whose
+ * worker fails is put back in the queue for the remaining workers; a failed
+ * worker is reconnected a few times before it is given up on. Without
+ * worker processes the bands can also be computed in this process, on the
+ * shared render pool behind anything interactive.
+ */
+class TileCoordinator
+{
+    public:
+        //Called once per finished band, from the coordinator's connection threads but never concurrently
+        typedef std::function<void(const TileJob&, const TileResult&)> TileCallback;
+
+    private:
+        std::vector<std::string> m_addresses;
+        std::vector<pid_t> m_children;
+        std::vector<std::string> m_socketPaths;
+        //Private to this user, so no one else can take the workers' socket paths
+        std::string m_socketDirectory;
+        bool m_localPool;
+
+        TileCoordinator(const TileCoordinator&);
+        TileCoordinator& operator=(const TileCoordinator&);
+
+        bool renderLocal(const std::vector<TileJob>& jobs, const TileCallback& callback, const std::atomic<bool>& canceled);
+
+    public:
+        TileCoordinator();
+        ~TileCoordinator();
+
+        void addWorker(const std::string& address);
+        bool spawnLocalWorkers(int count, int niceness = 0);
+        int workerCount() const { return m_addresses.size(); }
+
+        //Computes the bands on JobScheduler::shared() as a background job instead of sending them to workers
+        void useLocalPool() { m_localPool = true; }
+
+        //Blocks until every band has been delivered; false if canceled or no worker is left
+        bool render(const TileJob& frame, int bandRows, const TileCallback& callback, const std::atomic<bool>& canceled);
+
+        //Same for arbitrary pieces of a frame; job ids are assigned here
+        bool render(const std::vector<TileJob>& jobs, const TileCallback& callback, const std::atomic<bool>& canceled);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "TileImage.h"
+#include "TileProtocol.h"
+#include "ColorTable.h"
+#include "Downsampler.h"
+
+#include <vector>
+
+#include <QImage>
+
+void TileImage::colorize(const TileJob& job, const TileResult& result, const ColorTable& colorTable, const Downsampler& downsampler,
+                         QImage& image, int x, int y)
+{
+    int antialiasing = job.antialiasing;
+    std::size_t jobSamples = result.iterations.size();
+
+    std::vector<float> indices(jobSamples);
+    std::vector<unsigned char> red(jobSamples);
+    std::vector<unsigned char> green(jobSamples);
+    std::vector<unsigned char> blue(jobSamples);
+
+    for (std::size_t i = 0; i < jobSamples; i++) {
+        indices[i] = (float) result.iterations[i];
+    }
+
+    colorTable.lookup(indices.data(), jobSamples, red.data(), green.data(), blue.data());
+
+    for (int row = 0; row < job.rowCount; row++) {
+        std::size_t rowStart = (std::size_t) row * antialiasing * result.sampleWidth;
+
+        downsampler.downsample(&red[rowStart], &green[rowStart], &blue[rowStart], result.sampleWidth, job.columnCount,
+                               (QRgb*) image.scanLine(y + row) + x);
+    }
+}
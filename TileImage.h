@@ -0,0 +1,17 @@
+#ifndef TileImage_H
+#define TileImage_H
+
+class QImage;
+class ColorTable;
+class Downsampler;
+struct TileJob;
+struct TileResult;
+
+namespace TileImage
+{
+    //Colorizes and downsamples a finished job into image, its top left pixel going to (x, y)
+    void colorize(const TileJob& job, const TileResult& result, const ColorTable& colorTable, const Downsampler& downsampler,
+                  QImage& image, int x, int y);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include "TileProtocol.h"
+#include "Socket.h"
+#include "IterationCodec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    const std::uint32_t MAGIC = 0x32544b46; // "FKT2"
+    const std::uint32_t MAX_PAYLOAD = 1u << 30;
+
+    //Largest band a worker takes on: 64M samples, a quarter of a gigabyte of iteration counts
+    const std::int64_t MAX_JOB_SAMPLES = 1 << 26;
+
+    enum MessageType
+    {
+        JOB = 1,
+        RESULT = 2
+    };
+
+    class Writer
+    {
+        private:
+            std::vector<unsigned char>& m_data;
+
+        public:
+            Writer(std::vector<unsigned char>& data) :
+                m_data(data)
+            { }
+
+            void u32(std::uint32_t value)
+            {
+                for (int i = 0; i < 4; i++) {
+                    m_data.push_back((unsigned char) (value >> (i * 8)));
+                }
+            }
+
+            void i32(std::int32_t value)
+            {
+                u32((std::uint32_t) value);
+            }
+
+            void f64(double value)
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                u32((std::uint32_t) bits);
+                u32((std::uint32_t) (bits >> 32));
+            }
+
+            void bytes(const std::vector<unsigned char>& data)
+            {
+                m_data.insert(m_data.end(), data.begin(), data.end());
+            }
+    };
+
+    class Reader
+    {
+        private:
+            const std::vector<unsigned char>& m_data;
+            std::size_t m_pos;
+            bool m_ok;
+
+        public:
+            Reader(const std::vector<unsigned char>& data) :
+                m_data(data),
+                m_pos(0),
+                m_ok(true)
+            { }
+
+            bool ok() const                     { return m_ok; }
+            std::size_t remaining() const       { return m_data.size() - m_pos; }
+            const unsigned char* current() const { return m_data.data() + m_pos; }
+
+            std::uint32_t u32()
+            {
+                if (remaining() < 4) {
+                    m_ok = false;
+                    return 0;
+                }
+
+                std::uint32_t value = 0;
+
+                for (int i = 0; i < 4; i++) {
+                    value |= (std::uint32_t) m_data[m_pos++] << (i * 8);
+                }
+
+                return value;
+            }
+
+            std::int32_t i32()
+            {
+                return (std::int32_t) u32();
+            }
+
+            double f64()
+            {
+                std::uint64_t bits = u32();
+                bits |= (std::uint64_t) u32() << 32;
+
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+    };
+
+    bool sendMessage(Socket& socket, MessageType type, const std::vector<unsigned char>& payload)
+    {
+        std::vector<unsigned char> header;
+        Writer writer(header);
+        writer.u32(MAGIC);
+        writer.u32(type);
+        writer.u32((std::uint32_t) payload.size());
+
+        return socket.writeAll(header.data(), header.size()) && socket.writeAll(payload.data(), payload.size());
+    }
+
+    bool receiveMessage(Socket& socket, MessageType type, std::vector<unsigned char>& payload)
+    {
+        std::vector<unsigned char> header(12);
+
+        if (!socket.readAll(header.data(), header.size())) {
+            return false;
+        }
+
+        Reader reader(header);
+        std::uint32_t magic = reader.u32();
+        std::uint32_t messageType = reader.u32();
+        std::uint32_t size = reader.u32();
+
+        if (magic != MAGIC || messageType != (std::uint32_t) type || size > MAX_PAYLOAD) {
+            return false;
+        }
+
+        payload.resize(size);
+        return socket.readAll(payload.data(), size);
+    }
+}
+
+bool TileProtocol::sendJob(Socket& socket, const TileJob& job)
+{
+    std::vector<unsigned char> payload;
+    Writer writer(payload);
+    writer.u32(job.id);
+    writer.f64(job.x1);
+    writer.f64(job.y1);
+    writer.f64(job.x2);
+    writer.f64(job.y2);
+    writer.i32(job.frameWidth);
+    writer.i32(job.frameHeight);
+    writer.i32(job.firstRow);
+    writer.i32(job.rowCount);
+    writer.i32(job.firstColumn);
+    writer.i32(job.columnCount);
+    writer.i32(job.antialiasing);
+    writer.i32(job.formula);
+    writer.i32(job.maxIterations);
+
+    return sendMessage(socket, JOB, payload);
+}
+
+bool TileProtocol::receiveJob(Socket& socket, TileJob& job)
+{
+    std::vector<unsigned char> payload;
+
+    if (!receiveMessage(socket, JOB, payload)) {
+        return false;
+    }
+
+    Reader reader(payload);
+    job.id = reader.u32();
+    job.x1 = reader.f64();
+    job.y1 = reader.f64();
+    job.x2 = reader.f64();
+    job.y2 = reader.f64();
+    job.frameWidth = reader.i32();
+    job.frameHeight = reader.i32();
+    job.firstRow = reader.i32();
+    job.rowCount = reader.i32();
+    job.firstColumn = reader.i32();
+    job.columnCount = reader.i32();
+    job.antialiasing = reader.i32();
+    job.formula = reader.i32();
+    job.maxIterations = reader.i32();
+
+    //In 64 bits, so that no sum or product of hostile values can wrap around into range
+    return reader.ok() &&
+           job.frameWidth > 1 && job.frameHeight > 1 &&
+           job.antialiasing > 0 && job.antialiasing <= 32 &&
+           job.firstRow >= 0 && job.rowCount > 0 && (std::int64_t) job.firstRow + job.rowCount <= job.frameHeight &&
+           job.firstColumn >= 0 && job.columnCount > 0 && (std::int64_t) job.firstColumn + job.columnCount <= job.frameWidth &&
+           (std::int64_t) job.columnCount * job.antialiasing * job.rowCount * job.antialiasing <= MAX_JOB_SAMPLES &&
+           job.formula == TileJob::Mandelbrot &&
+           job.maxIterations > 0;
+}
+
+bool TileProtocol::sendResult(Socket& socket, const TileResult& result)
+{
+    std::vector<unsigned char> compressed;
+    IterationCodec::compress(result.iterations.data(), result.iterations.size(), compressed);
+
+    std::vector<unsigned char> payload;
+    Writer writer(payload);
+    writer.u32(result.id);
+    writer.i32(result.sampleWidth);
+    writer.i32(result.sampleHeight);
+    writer.bytes(compressed);
+
+    return sendMessage(socket, RESULT, payload);
+}
+
+bool TileProtocol::receiveResult(Socket& socket, TileResult& result)
+{
+    std::vector<unsigned char> payload;
+
+    if (!receiveMessage(socket, RESULT, payload)) {
+        return false;
+    }
+
+    Reader reader(payload);
+    result.id = reader.u32();
+    result.sampleWidth = reader.i32();
+    result.sampleHeight = reader.i32();
+
+    if (!reader.ok() || result.sampleWidth <= 0 || result.sampleHeight <= 0 ||
+        (std::size_t) result.sampleWidth * (std::size_t) result.sampleHeight > MAX_PAYLOAD) {
+        return false;
+    }
+
+    result.iterations.resize((std::size_t) result.sampleWidth * (std::size_t) result.sampleHeight);
+
+    return IterationCodec::decompress(reader.current(), reader.remaining(), result.iterations.data(), result.iterations.size());
+}
@@ -0,0 +1,60 @@
+#ifndef TileProtocol_H
+#define TileProtocol_H
+
+#include <vector>
+
+class Socket;
+
+/*
+ * A rectangle of a frame, usually a full width band. The whole frame is
+ * described so that every worker derives sample coordinates from the same
+ * SampleGrid and the pieces join without seams.
+ */
+struct TileJob
+{
+    enum Formula
+    {
+        Mandelbrot = 0
+    };
+
+    unsigned int id;
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+    int frameWidth;
+    int frameHeight;
+    int firstRow;
+    int rowCount;
+    int firstColumn;
+    int columnCount;
+    int antialiasing;
+    int formula;
+    int maxIterations;
+};
+
+//Iteration counts of a job's samples, row major, rowCount * antialiasing rows of columnCount * antialiasing
+struct TileResult
+{
+    unsigned int id;
+    int sampleWidth;
+    int sampleHeight;
+    std::vector<int> iterations;
+};
+
+/*
+ * Wire format: every message is a 12 byte header (magic, type, payload size)
+ * followed by the payload. All integers are little endian, doubles are sent
+ * as their IEEE 754 bit pattern. Result payloads carry the iteration counts
+ * compressed with IterationCodec.
+ */
+namespace TileProtocol
+{
+    bool sendJob(Socket& socket, const TileJob& job);
+    bool receiveJob(Socket& socket, TileJob& job);
+
+    bool sendResult(Socket& socket, const TileResult& result);
+    bool receiveResult(Socket& socket, TileResult& result);
+}
+
+#endif
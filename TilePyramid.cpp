@@ -0,0 +1,329 @@
+#include "TilePyramid.h"
+#include "TileCoordinator.h"
+#include "TileImage.h"
+#include "ColorScheme.h"
+#include "ColorTable.h"
+#include "JobScheduler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <QImage>
+#include <QString>
+
+namespace
+{
+    const std::string DESCRIPTOR_SUFFIX = ".dzi";
+
+    //Describes the frame the tiles on disk belong to; tiles are only kept if it matches
+    const std::string FRAME_FILE = "frame.txt";
+
+    bool exists(const std::string& path)
+    {
+        return ::access(path.c_str(), F_OK) == 0;
+    }
+
+    bool makeDirectory(const std::string& path)
+    {
+        return ::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+    }
+
+    //Written under a temporary name first, so a crash never leaves a truncated tile behind
+    bool saveTile(const QImage& tile, const std::string& path)
+    {
+        std::string partial = path + ".part";
+
+        return tile.save(QString::fromLocal8Bit(partial.c_str()), "PNG") &&
+               std::rename(partial.c_str(), path.c_str()) == 0;
+    }
+}
+
+TilePyramid::TilePyramid(const std::string& descriptorPath, int width, int height, int tileSize) :
+    m_name(descriptorPath),
+    m_width(width),
+    m_height(height),
+    m_tileSize(tileSize),
+    m_maxLevel(0)
+{
+    if (m_name.size() > DESCRIPTOR_SUFFIX.size() &&
+        m_name.compare(m_name.size() - DESCRIPTOR_SUFFIX.size(), DESCRIPTOR_SUFFIX.size(), DESCRIPTOR_SUFFIX) == 0) {
+        m_name.erase(m_name.size() - DESCRIPTOR_SUFFIX.size());
+    }
+
+    while ((1LL << m_maxLevel) < std::max(width, height)) {
+        m_maxLevel++;
+    }
+}
+
+int TilePyramid::levelWidth(int level) const
+{
+    long long scale = 1LL << (m_maxLevel - level);
+    return (int) ((m_width + scale - 1) / scale);
+}
+
+int TilePyramid::levelHeight(int level) const
+{
+    long long scale = 1LL << (m_maxLevel - level);
+    return (int) ((m_height + scale - 1) / scale);
+}
+
+int TilePyramid::tileCount() const
+{
+    int count = 0;
+
+    for (int level = 0; level <= m_maxLevel; level++) {
+        count += columns(level) * rows(level);
+    }
+
+    return count;
+}
+
+std::string TilePyramid::filesPath() const
+{
+    return m_name + "_files";
+}
+
+std::string TilePyramid::tilePath(int level, int column, int row) const
+{
+    std::ostringstream path;
+    path << filesPath() << "/" << level << "/" << column << "_" << row << ".png";
+    return path.str();
+}
+
+bool TilePyramid::writeFile(const std::string& path, const std::string& contents) const
+{
+    std::string partial = path + ".part";
+
+    {
+        std::ofstream file(partial.c_str());
+        file << contents;
+
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    return std::rename(partial.c_str(), path.c_str()) == 0;
+}
+
+bool TilePyramid::prepare(const std::string& frameDescription)
+{
+    if (!makeDirectory(filesPath())) {
+        std::cerr << "Cannot create " << filesPath() << std::endl;
+        return false;
+    }
+
+    for (int level = 0; level <= m_maxLevel; level++) {
+        std::ostringstream path;
+        path << filesPath() << "/" << level;
+
+        if (!makeDirectory(path.str())) {
+            std::cerr << "Cannot create " << path.str() << std::endl;
+            return false;
+        }
+    }
+
+    std::string framePath = filesPath() + "/" + FRAME_FILE;
+    std::ifstream previous(framePath.c_str());
+    std::ostringstream previousDescription;
+    previousDescription << previous.rdbuf();
+
+    if (previous.good() && previousDescription.str() == frameDescription) {
+        return true;
+    }
+
+    //Tiles of some other frame: none of them can be kept
+    std::remove((m_name + DESCRIPTOR_SUFFIX).c_str());
+
+    for (int level = 0; level <= m_maxLevel; level++) {
+        for (int row = 0; row < rows(level); row++) {
+            for (int column = 0; column < columns(level); column++) {
+                std::remove(tilePath(level, column, row).c_str());
+            }
+        }
+    }
+
+    return writeFile(framePath, frameDescription);
+}
+
+bool TilePyramid::render(TileCoordinator& coordinator, const TileJob& frame, const ColorScheme& colors, Downsampler::Filter filter,
+                         const ProgressCallback& progress, const std::atomic<bool>& canceled)
+{
+    std::ostringstream description;
+    description.precision(17);
+    description << frame.x1 << " " << frame.y1 << " " << frame.x2 << " " << frame.y2 << "\n"
+                << frame.frameWidth << " " << frame.frameHeight << " " << frame.antialiasing << " "
+                << frame.formula << " " << frame.maxIterations << " " << m_tileSize << " " << filter << "\n";
+
+    for (int i = 0; i < colors.paletteSize(); i++) {
+        description << std::hex << colors.paletteColor(i).rgb() << " ";
+    }
+
+    description << colors.interiorColor().rgb() << "\n";
+
+    if (frame.frameWidth != m_width || frame.frameHeight != m_height || !prepare(description.str())) {
+        return false;
+    }
+
+    int total = tileCount();
+    std::atomic<int> done(0);
+    std::mutex progressMutex;
+
+    auto tileDone = [&]() {
+        std::unique_lock<std::mutex> lock(progressMutex);
+        progress(++done, total);
+    };
+
+    //Full resolution level: every tile is a job for the tile workers
+    std::vector<TileJob> jobs;
+
+    for (int row = 0; row < rows(m_maxLevel); row++) {
+        for (int column = 0; column < columns(m_maxLevel); column++) {
+            if (exists(tilePath(m_maxLevel, column, row))) {
+                done++;
+                continue;
+            }
+
+            TileJob job = frame;
+            job.firstRow = row * m_tileSize;
+            job.rowCount = std::min(m_tileSize, m_height - job.firstRow);
+            job.firstColumn = column * m_tileSize;
+            job.columnCount = std::min(m_tileSize, m_width - job.firstColumn);
+            jobs.push_back(job);
+        }
+    }
+
+    ColorTable colorTable(colors, frame.maxIterations);
+    Downsampler downsampler(filter, frame.antialiasing);
+    bool written = true;
+
+    bool computed = jobs.empty() || coordinator.render(jobs, [&](const TileJob& job, const TileResult& result) {
+        QImage tile(job.columnCount, job.rowCount, QImage::Format_RGB32);
+        TileImage::colorize(job, result, colorTable, downsampler, tile, 0, 0);
+
+        if (saveTile(tile, tilePath(m_maxLevel, job.firstColumn / m_tileSize, job.firstRow / m_tileSize))) {
+            tileDone();
+        } else {
+            written = false;
+        }
+    }, canceled);
+
+    if (!computed || !written) {
+        return false;
+    }
+
+    //Every other level halves the one below it; a tile is built from up to four tiles of the level below
+    for (int level = m_maxLevel - 1; level >= 0; level--) {
+        std::vector<std::pair<int, int>> missing;
+
+        for (int row = 0; row < rows(level); row++) {
+            for (int column = 0; column < columns(level); column++) {
+                if (exists(tilePath(level, column, row))) {
+                    done++;
+                } else {
+                    missing.push_back(std::make_pair(column, row));
+                }
+            }
+        }
+
+        std::atomic<bool> failed(false);
+
+        //Export work, so it runs on the shared pool behind anything the user is waiting for
+        JobScheduler& scheduler = JobScheduler::shared();
+        JobScheduler::JobHandle levelJob = scheduler.submit(JobScheduler::Background, missing.size(), [&](int i) {
+            if (canceled || failed) {
+                return true;
+            }
+
+            int column = missing[i].first;
+            int row = missing[i].second;
+            int childWidth = levelWidth(level + 1);
+            int childHeight = levelHeight(level + 1);
+            int width = std::min(m_tileSize, levelWidth(level) - column * m_tileSize);
+            int height = std::min(m_tileSize, levelHeight(level) - row * m_tileSize);
+
+            QImage children[2][2];
+
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    if (column * 2 + dx < columns(level + 1) && row * 2 + dy < rows(level + 1)) {
+                        std::string path = tilePath(level + 1, column * 2 + dx, row * 2 + dy);
+
+                        if (!children[dy][dx].load(QString::fromLocal8Bit(path.c_str()))) {
+                            std::cerr << "Cannot read " << path << std::endl;
+                            failed = true;
+                            return true;
+                        }
+
+                        children[dy][dx] = children[dy][dx].convertToFormat(QImage::Format_RGB32);
+                    }
+                }
+            }
+
+            QImage tile(width, height, QImage::Format_RGB32);
+
+            for (int y = 0; y < height; y++) {
+                QRgb* out = (QRgb*) tile.scanLine(y);
+
+                for (int x = 0; x < width; x++) {
+                    int red = 0;
+                    int green = 0;
+                    int blue = 0;
+                    int count = 0;
+
+                    for (int sy = 0; sy < 2; sy++) {
+                        for (int sx = 0; sx < 2; sx++) {
+                            int childX = (column * m_tileSize + x) * 2 + sx;
+                            int childY = (row * m_tileSize + y) * 2 + sy;
+
+                            if (childX >= childWidth || childY >= childHeight) {
+                                continue;
+                            }
+
+                            const QImage& child = children[childY / m_tileSize - row * 2][childX / m_tileSize - column * 2];
+                            QRgb pixel = ((const QRgb*) child.scanLine(childY % m_tileSize))[childX % m_tileSize];
+
+                            red += qRed(pixel);
+                            green += qGreen(pixel);
+                            blue += qBlue(pixel);
+                            count++;
+                        }
+                    }
+
+                    out[x] = qRgb((red + count / 2) / count, (green + count / 2) / count, (blue + count / 2) / count);
+                }
+            }
+
+            if (!saveTile(tile, tilePath(level, column, row))) {
+                failed = true;
+                return true;
+            }
+
+            tileDone();
+            return true;
+        });
+
+        scheduler.wait(levelJob);
+
+        if (canceled || failed) {
+            return false;
+        }
+    }
+
+    std::ostringstream descriptor;
+    descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"png\" Overlap=\"0\" TileSize=\"" << m_tileSize << "\">\n"
+               << "    <Size Width=\"" << m_width << "\" Height=\"" << m_height << "\"/>\n"
+               << "</Image>\n";
+
+    return writeFile(m_name + DESCRIPTOR_SUFFIX, descriptor.str());
+}
@@ -0,0 +1,62 @@
+#ifndef TilePyramid_H
+#define TilePyramid_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "TileProtocol.h"
+#include "Downsampler.h"
+
+class ColorScheme;
+class TileCoordinator;
+
+/*
+ * DeepZoom tile pyramid of a frame: <name>.dzi next to
+ * <name>_files/<level>/<column>_<row>.png, level 0 being a single pixel.
+ * Only the full resolution level is computed; every level above it is made by
+ * halving the level below. Tiles are written as soon as they are finished and
+ * kept if the same frame is exported again, so an interrupted export picks up
+ * where it stopped.
+ */
+class TilePyramid
+{
+    public:
+        //Tiles finished so far, including ones kept from an earlier run, out of all tiles of all levels
+        typedef std::function<void(int done, int total)> ProgressCallback;
+
+    private:
+        std::string m_name;
+        int m_width;
+        int m_height;
+        int m_tileSize;
+        int m_maxLevel;
+
+        std::string filesPath() const;
+        bool prepare(const std::string& frameDescription);
+        bool writeFile(const std::string& path, const std::string& contents) const;
+
+    public:
+        //descriptorPath is the .dzi file; width and height are those of the full resolution level
+        TilePyramid(const std::string& descriptorPath, int width, int height, int tileSize = 256);
+
+        int levelCount() const                  { return m_maxLevel + 1; }
+        int levelWidth(int level) const;
+        int levelHeight(int level) const;
+        int columns(int level) const            { return (levelWidth(level) + m_tileSize - 1) / m_tileSize; }
+        int rows(int level) const               { return (levelHeight(level) + m_tileSize - 1) / m_tileSize; }
+        int tileCount() const;
+        std::string tilePath(int level, int column, int row) const;
+
+        /*
+         * Computes the missing full resolution tiles of frame on the
+         * coordinator's workers, then builds the missing tiles of the other
+         * levels as Background jobs on the shared JobScheduler. Frame is
+         * colorized by iteration count. Returns false if canceled or if a
+         * tile could not be computed or written.
+         */
+        bool render(TileCoordinator& coordinator, const TileJob& frame, const ColorScheme& colors, Downsampler::Filter filter,
+                    const ProgressCallback& progress, const std::atomic<bool>& canceled);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "TileServer.h"
+#include "TileProtocol.h"
+#include "SampleBuffer.h"
+#include "SampleGrid.h"
+#include "EscapeTime.h"
+#include "Topology.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+TileServer::TileServer() :
+    m_threads(Topology::defaultWorkerCount())
+{ }
+
+bool TileServer::listen(const std::string& address)
+{
+    if (!m_listener.listen(address)) {
+        return false;
+    }
+
+    std::cout << "Tile worker listening on " << address << std::endl;
+    return true;
+}
+
+int TileServer::exec()
+{
+    while (true) {
+        Socket* connection = new Socket();
+
+        if (!m_listener.accept(*connection)) {
+            delete connection;
+            std::cerr << "Tile worker stopped accepting connections" << std::endl;
+            return 1;
+        }
+
+        std::thread(&TileServer::serve, this, connection).detach();
+    }
+}
+
+void TileServer::serve(Socket* connection)
+{
+    TileJob job;
+    TileResult result;
+
+    //A failed read is either the coordinator hanging up or a malformed job; both end the connection, and so
+    //does a band too large for this machine, which makes the coordinator retry it on another worker
+    while (TileProtocol::receiveJob(*connection, job)) {
+        if (!computeTile(job, result, m_threads)) {
+            std::cerr << "Not enough memory for band " << job.id << ", dropping the connection" << std::endl;
+            break;
+        }
+
+        if (!TileProtocol::sendResult(*connection, result)) {
+            break;
+        }
+    }
+
+    delete connection;
+}
+
+bool TileServer::computeTile(const TileJob& job, TileResult& result, int threads)
+{
+    SampleGrid grid(ZoomRegion(job.x1, job.y1, job.x2, job.y2), job.frameWidth, job.frameHeight, job.antialiasing);
+    SampleBuffer samples;
+
+    if (!samples.reset(job.columnCount * job.antialiasing, job.rowCount * job.antialiasing, SampleBuffer::Iterations)) {
+        return false;
+    }
+
+    EscapeTimeRowFunction computeRow = escapeTimeRow(SampleBuffer::Iterations);
+
+    std::vector<double> reals(samples.width());
+
+    for (int sx = 0; sx < samples.width(); sx++) {
+        reals[sx] = grid.real(job.firstColumn * job.antialiasing + sx);
+    }
+
+    std::atomic<int> nextRow(0);
+    std::vector<std::thread> workers;
+
+    auto rowTask = [&]() {
+        int row;
+
+        while ((row = nextRow++) < samples.height()) {
+            double imag = grid.imag(job.firstRow * job.antialiasing + row);
+            computeRow(reals.data(), imag, samples.width(), job.maxIterations, 2.0, samples, samples.index(0, row), false);
+        }
+    };
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(rowTask);
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    result.id = job.id;
+    result.sampleWidth = samples.width();
+    result.sampleHeight = samples.height();
+    result.iterations.assign(samples.iterations(), samples.iterations() + samples.size());
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef TileServer_H
+#define TileServer_H
+
+#include <string>
+
+#include "Socket.h"
+
+struct TileJob;
+struct TileResult;
+
+/*
+ * Worker process mode: accepts connections from a TileCoordinator and answers
+ * every TileJob it receives with the iteration counts of that band. Each
+ * connection is served on its own thread and every tile is computed with all
+ * of the machine's cores.
+ */
+class TileServer
+{
+    private:
+        Socket m_listener;
+        int m_threads;
+
+        void serve(Socket* connection);
+
+    public:
+        TileServer();
+
+        bool listen(const std::string& address);
+        int exec();
+
+        //False if there is not enough memory for the band's samples
+        static bool computeTile(const TileJob& job, TileResult& result, int threads);
+};
+
+#endif
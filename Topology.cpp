@@ -0,0 +1,269 @@
+#include "Topology.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    const int MAX_NODES = 64;
+
+    //Parses sysfs cpu lists such as "0-7,16-23"
+    std::vector<int> parseCpuList(const std::string& list)
+    {
+        std::vector<int> cpus;
+        std::istringstream stream(list);
+        std::string range;
+
+        while (std::getline(stream, range, ',')) {
+            std::string::size_type dash = range.find('-');
+
+            int first = std::atoi(range.c_str());
+            int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        return cpus;
+    }
+
+    //Quota in CPUs from a cgroup v2 cpu.max ("<quota> <period>" or "max <period>")
+    double readCpuMax(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string quota;
+        double period = 0.0;
+
+        if (!(file >> quota >> period) || quota == "max" || period <= 0.0) {
+            return 0.0;
+        }
+
+        return std::atof(quota.c_str()) / period;
+    }
+
+    //Quota in CPUs from a cgroup v1 cpu controller directory
+    double readCfsQuota(const std::string& directory)
+    {
+        std::ifstream quotaFile(directory + "/cpu.cfs_quota_us");
+        std::ifstream periodFile(directory + "/cpu.cfs_period_us");
+        double quota = 0.0;
+        double period = 0.0;
+
+        if (!(quotaFile >> quota) || !(periodFile >> period) || quota <= 0.0 || period <= 0.0) {
+            return 0.0;
+        }
+
+        return quota / period;
+    }
+
+    //The tightest quota along the path from the process's cgroup up to the root
+    double hierarchyQuota(const std::string& mount, std::string path, bool version2)
+    {
+        double quota = 0.0;
+
+        while (true) {
+            std::string directory = mount + (path == "/" ? "" : path);
+            double level = version2 ? readCpuMax(directory + "/cpu.max") : readCfsQuota(directory);
+
+            if (level > 0.0 && (quota == 0.0 || level < quota)) {
+                quota = level;
+            }
+
+            if (path.empty() || path == "/") {
+                break;
+            }
+
+            std::string::size_type slash = path.rfind('/');
+            path = slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+        }
+
+        //Containers usually see their own cgroup as the root of the mount
+        if (quota == 0.0) {
+            quota = version2 ? readCpuMax(mount + "/cpu.max") : readCfsQuota(mount);
+        }
+
+        return quota;
+    }
+}
+
+Topology::Topology()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveAffinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    for (int node = 0; node < MAX_NODES; node++) {
+        std::ostringstream path;
+        path << "/sys/devices/system/node/node" << node << "/cpulist";
+
+        std::ifstream file(path.str());
+        std::string list;
+
+        if (!file || !std::getline(file, list)) {
+            continue;
+        }
+
+        std::vector<int> cpus;
+
+        for (int cpu : parseCpuList(list)) {
+            if (!haveAffinity || CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        if (!cpus.empty()) {
+            m_nodes.push_back(cpus);
+        }
+    }
+
+    if (m_nodes.empty()) {
+        std::vector<int> cpus;
+
+        if (haveAffinity) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } else {
+            for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        m_nodes.push_back(cpus);
+    }
+}
+
+const Topology& Topology::system()
+{
+    static const Topology topology;
+    return topology;
+}
+
+int Topology::cpuCount() const
+{
+    int count = 0;
+
+    for (const std::vector<int>& cpus : m_nodes) {
+        count += cpus.size();
+    }
+
+    return count;
+}
+
+int Topology::cpuQuota()
+{
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    double quota = 0.0;
+
+    //Lines look like "0::/path" for cgroup v2 and "4:cpu,cpuacct:/path" for v1
+    while (std::getline(cgroups, line)) {
+        std::string::size_type first = line.find(':');
+        std::string::size_type second = line.find(':', first + 1);
+
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+
+        if (controllers.empty()) {
+            quota = hierarchyQuota("/sys/fs/cgroup", path, true);
+        } else if (("," + controllers + ",").find(",cpu,") != std::string::npos) {
+            quota = hierarchyQuota("/sys/fs/cgroup/" + controllers, path, false);
+
+            if (quota == 0.0) {
+                quota = hierarchyQuota("/sys/fs/cgroup/cpu", path, false);
+            }
+        }
+
+        if (quota > 0.0) {
+            break;
+        }
+    }
+
+    return (int) std::ceil(quota);
+}
+
+int Topology::defaultWorkerCount()
+{
+    //Asked for by every render and sketch, so the cgroup files are only read the first time
+    static const int workers = [] {
+        int count = system().cpuCount();
+        int quota = cpuQuota();
+
+        if (quota > 0 && quota < count) {
+            count = quota;
+        }
+
+        return std::max(count, 1);
+    }();
+
+    return workers;
+}
+
+bool Topology::pinCurrentThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool Topology::currentThreadAffinity(std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+
+    cpus.clear();
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return true;
+}
+
+bool Topology::setCurrentThreadAffinity(const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool Topology::setCurrentThreadNiceness(int niceness)
+{
+    if (niceness <= 0) {
+        return true;
+    }
+
+    //On Linux the nice value is a per-thread attribute addressed by thread id
+    return setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), std::min(niceness, 19)) == 0;
+}
@@ -0,0 +1,42 @@
+#ifndef Topology_H
+#define Topology_H
+
+#include <vector>
+
+/*
+ * NUMA layout of the CPUs this process may run on, read from sysfs. Machines
+ * without NUMA information are reported as a single node holding every
+ * allowed CPU. Inside containers the CPUs visible here can far exceed what
+ * the cgroup CPU quota lets the process use, see defaultWorkerCount().
+ */
+class Topology
+{
+    private:
+        std::vector<std::vector<int>> m_nodes;
+
+        Topology();
+
+    public:
+        static const Topology& system();
+
+        int nodeCount() const                           { return m_nodes.size(); }
+        const std::vector<int>& cpus(int node) const    { return m_nodes[node]; }
+        int cpuCount() const;
+
+        //CPUs granted by the cgroup CPU quota, rounded up; 0 when there is no quota
+        static int cpuQuota();
+
+        //Render threads to use by default: the allowed CPUs, capped by the CPU quota; worked out once per process
+        static int defaultWorkerCount();
+
+        static bool pinCurrentThread(int cpu);
+
+        //The CPUs the calling thread may run on, so that pinning can be undone
+        static bool currentThreadAffinity(std::vector<int>& cpus);
+        static bool setCurrentThreadAffinity(const std::vector<int>& cpus);
+
+        //Raises the nice value of the calling thread only; niceness is 0 (unchanged) to 19. Unprivileged threads cannot lower it again
+        static bool setCurrentThreadNiceness(int niceness);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    //Spans kept per thread
+    const std::size_t RING_CAPACITY = 1 << 14;
+
+    struct Event
+    {
+        const char* name;
+        std::int64_t begin;
+        std::int64_t end;
+        int row;
+    };
+
+    /*
+     * Rings belong to one thread at a time. When a thread exits its ring is
+     * handed to the next new thread, keeping the older spans, so short-lived
+     * render threads do not each leave a buffer behind; their spans share a
+     * track in the viewer.
+     */
+    struct Ring
+    {
+        std::vector<Event> events;
+        std::atomic<std::uint64_t> written;
+        std::string name;
+        int track;
+
+        Ring(int track) : events(RING_CAPACITY), written(0), track(track) { }
+    };
+
+    std::mutex g_ringsMutex;
+    std::vector<Ring*> g_rings;
+    std::vector<Ring*> g_freeRings;
+
+    struct RingOwner
+    {
+        Ring* ring;
+
+        RingOwner() : ring(nullptr) { }
+
+        ~RingOwner()
+        {
+            if (ring != nullptr) {
+                std::unique_lock<std::mutex> lock(g_ringsMutex);
+                g_freeRings.push_back(ring);
+            }
+        }
+    };
+
+    thread_local RingOwner t_owner;
+
+    Ring* currentRing()
+    {
+        if (t_owner.ring == nullptr) {
+            std::unique_lock<std::mutex> lock(g_ringsMutex);
+
+            if (!g_freeRings.empty()) {
+                t_owner.ring = g_freeRings.back();
+                g_freeRings.pop_back();
+            } else {
+                t_owner.ring = new Ring(g_rings.size() + 1);
+                g_rings.push_back(t_owner.ring);
+            }
+        }
+
+        return t_owner.ring;
+    }
+
+    void writeString(std::ostream& out, const std::string& text)
+    {
+        out << '"';
+
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if ((unsigned char) c >= 0x20) {
+                out << c;
+            }
+        }
+
+        out << '"';
+    }
+
+    const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+}
+
+std::atomic<bool> Trace::g_enabled(false);
+
+void Trace::setEnabled(bool enabled)
+{
+    g_enabled.store(enabled);
+}
+
+std::int64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void Trace::record(const char* name, std::int64_t begin, std::int64_t end, int row)
+{
+    Ring* ring = currentRing();
+    std::uint64_t index = ring->written.load(std::memory_order_relaxed);
+
+    Event& event = ring->events[index % RING_CAPACITY];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.row = row;
+
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+void Trace::nameThread(const char* name)
+{
+    if (!enabled()) {
+        return;
+    }
+
+    Ring* ring = currentRing();
+
+    std::unique_lock<std::mutex> lock(g_ringsMutex);
+    ring->name = name;
+}
+
+bool Trace::write(const std::string& path)
+{
+    std::ofstream out(path.c_str());
+
+    if (!out) {
+        return false;
+    }
+
+    //Microseconds with nanosecond digits, however long the process has been running
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[";
+
+    bool first = true;
+    std::unique_lock<std::mutex> lock(g_ringsMutex);
+
+    //Spans a thread records while this runs may show up torn; tracing is for looking at, not for exact numbers
+    for (Ring* ring : g_rings) {
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->track << ",\"args\":{\"name\":";
+        writeString(out, ring->name.empty() ? "thread " + std::to_string(ring->track) : ring->name);
+        out << "}}";
+        first = false;
+
+        std::uint64_t written = ring->written.load(std::memory_order_acquire);
+        std::uint64_t oldest = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+
+        for (std::uint64_t i = oldest; i < written; i++) {
+            const Event& event = ring->events[i % RING_CAPACITY];
+
+            out << ",\n{\"name\":";
+            writeString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->track
+                << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0;
+
+            if (event.row >= 0) {
+                out << ",\"args\":{\"row\":" << event.row << "}";
+            }
+
+            out << "}";
+        }
+    }
+
+    out << "\n]}\n";
+    return (bool) out;
+}
@@ -0,0 +1,64 @@
+#ifndef Trace_H
+#define Trace_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Opt-in timeline of what every thread spends its time on, written in the
+ * Chrome trace event format that chrome://tracing and Perfetto open. Spans
+ * go into a ring buffer of the thread that records them, so recording takes
+ * no lock; while tracing is off a span is a single relaxed load. Only the
+ * latest spans of each thread are kept.
+ */
+namespace Trace
+{
+    extern std::atomic<bool> g_enabled;
+
+    inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    //Nanoseconds on a clock shared by all threads
+    std::int64_t now();
+
+    //name must be a string literal or otherwise outlive the trace; row is shown as an argument unless negative
+    void record(const char* name, std::int64_t begin, std::int64_t end, int row);
+
+    //Label for the calling thread's track
+    void nameThread(const char* name);
+
+    //Writes the spans recorded so far as Chrome trace JSON
+    bool write(const std::string& path);
+
+    //Records the time from construction to end() or destruction
+    class Span
+    {
+        private:
+            const char* m_name;
+            std::int64_t m_begin;
+            int m_row;
+
+            Span(const Span&);
+            Span& operator=(const Span&);
+
+        public:
+            explicit Span(const char* name, int row = -1) :
+                m_name(name),
+                m_begin(enabled() ? now() : -1),
+                m_row(row)
+            { }
+
+            ~Span() { end(); }
+
+            void end()
+            {
+                if (m_begin >= 0) {
+                    record(m_name, m_begin, now(), m_row);
+                    m_begin = -1;
+                }
+            }
+    };
+}
+
+#endif
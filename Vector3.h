@@ -0,0 +1,49 @@
+#ifndef Vector3_H
+#define Vector3_H
+
+#include <cmath>
+
+class Vector3
+{
+    private:
+        double m_x;
+        double m_y;
+        double m_z;
+
+    public:
+        Vector3() :
+            m_x(0.0),
+            m_y(0.0),
+            m_z(0.0)
+        { }
+
+        Vector3(double x, double y, double z) :
+            m_x(x),
+            m_y(y),
+            m_z(z)
+        { }
+
+        double x() const { return m_x; }
+        double y() const { return m_y; }
+        double z() const { return m_z; }
+
+        Vector3 operator+(const Vector3& other) const   { return Vector3(m_x + other.m_x, m_y + other.m_y, m_z + other.m_z); }
+        Vector3 operator-(const Vector3& other) const   { return Vector3(m_x - other.m_x, m_y - other.m_y, m_z - other.m_z); }
+        Vector3 operator*(double factor) const          { return Vector3(m_x * factor, m_y * factor, m_z * factor); }
+
+        double dot(const Vector3& other) const          { return m_x * other.m_x + m_y * other.m_y + m_z * other.m_z; }
+        double length() const                           { return std::sqrt(dot(*this)); }
+
+        Vector3 cross(const Vector3& other) const
+        {
+            return Vector3(m_y * other.m_z - m_z * other.m_y, m_z * other.m_x - m_x * other.m_z, m_x * other.m_y - m_y * other.m_x);
+        }
+
+        Vector3 normalized() const
+        {
+            double l = length();
+            return l > 0.0 ? *this * (1.0 / l) : *this;
+        }
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "ViewHistory.h"
+#include "SampleBuffer.h"
+#include "IterationCodec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    //Views are cheap without samples, but the list should not grow forever
+    const std::size_t MAX_ENTRIES = 256;
+
+    //Sample rows per independently compressed band
+    const int BAND_ROWS = 64;
+
+    //The planes worth keeping: the finished per-sample results, all 32 bits wide; the iteration state is not
+    const int STORED_PLANES = 5;
+}
+
+ViewHistory::Entry::Entry(const ZoomRegion& region, const Formula& formula, int width, int height, int maxIterations) :
+    m_region(region),
+    m_formula(formula),
+    m_width(width),
+    m_height(height),
+    m_maxIterations(maxIterations),
+    m_sampleWidth(0),
+    m_sampleHeight(0),
+    m_channels(SampleBuffer::NoChannels),
+    m_planes(),
+    m_bytes(0)
+{ }
+
+bool ViewHistory::Entry::restore(SampleBuffer& samples) const
+{
+    if (!hasSamples()) {
+        return false;
+    }
+
+    if (!samples.reset(m_sampleWidth, m_sampleHeight, m_channels)) {
+        return false;
+    }
+
+    int bands = (m_sampleHeight + BAND_ROWS - 1) / BAND_ROWS;
+    std::atomic<bool> valid(true);
+
+    //The view is wanted on screen now, so this competes with renders rather than exports
+    JobScheduler& scheduler = JobScheduler::shared();
+    JobScheduler::JobHandle job = scheduler.submit(JobScheduler::Interactive, STORED_PLANES * bands, [&](int tile) {
+        int plane = tile / bands;
+        int band = tile % bands;
+
+        if (m_planes[plane].empty()) {
+            return true;
+        }
+
+        //Planes are 32 bit ints or floats; floats travel through the codec as their bit patterns
+        std::size_t first = (std::size_t) band * BAND_ROWS * m_sampleWidth;
+        std::size_t count = (std::size_t) std::min(BAND_ROWS, m_sampleHeight - band * BAND_ROWS) * m_sampleWidth;
+        const std::vector<unsigned char>& data = m_planes[plane][band];
+        std::vector<int> values(count);
+
+        if (!IterationCodec::decompress(data.data(), data.size(), values.data(), count)) {
+            valid = false;
+            return true;
+        }
+
+        std::memcpy((char*) samples.plane(plane) + first * 4, values.data(), count * 4);
+        return true;
+    });
+
+    scheduler.wait(job);
+
+    return valid;
+}
+
+ViewHistory::ViewHistory(std::size_t budgetBytes) :
+    m_current(-1),
+    m_budget(budgetBytes),
+    m_recording(),
+    m_recordingEntry(-1),
+    m_recordingChannels(SampleBuffer::NoChannels),
+    m_recordingPlanes()
+{ }
+
+ViewHistory::~ViewHistory()
+{
+    finishRecording();
+}
+
+void ViewHistory::setBudget(std::size_t budgetBytes)
+{
+    finishRecording();
+
+    m_budget = budgetBytes;
+    enforceBudget();
+}
+
+void ViewHistory::record(const ZoomRegion& region, const Formula& formula, int width, int height, int maxIterations, const SampleBuffer& samples)
+{
+    finishRecording();
+
+    bool sameView = m_current >= 0 && m_entries[m_current].m_region == region && m_entries[m_current].m_formula == formula &&
+                    m_entries[m_current].m_width == width && m_entries[m_current].m_height == height;
+
+    if (!sameView) {
+        m_entries.erase(m_entries.begin() + (m_current + 1), m_entries.end());
+        m_entries.push_back(Entry(region, formula, width, height, maxIterations));
+
+        if (m_entries.size() > MAX_ENTRIES) {
+            m_entries.erase(m_entries.begin());
+        }
+
+        m_current = m_entries.size() - 1;
+    }
+
+    //Until the job is done the entry has no samples, so nothing can restore it half compressed
+    Entry& entry = m_entries[m_current];
+    entry.m_maxIterations = maxIterations;
+    entry.m_sampleWidth = samples.width();
+    entry.m_sampleHeight = samples.height();
+    entry.m_channels = SampleBuffer::NoChannels;
+    entry.m_planes.clear();
+    entry.m_bytes = 0;
+
+    int bands = (samples.height() + BAND_ROWS - 1) / BAND_ROWS;
+
+    m_recordingEntry = m_current;
+    m_recordingChannels = SampleBuffer::NoChannels;
+    m_recordingPlanes.assign(STORED_PLANES, std::vector<std::vector<unsigned char>>());
+
+    for (int plane = 0; plane < STORED_PLANES; plane++) {
+        if (samples.plane(plane) != nullptr) {
+            assert(SampleBuffer::planeElementSize(plane) == 4);
+            m_recordingChannels |= SampleBuffer::planeChannel(plane);
+            m_recordingPlanes[plane].resize(bands);
+        }
+    }
+
+    //Each tile writes only its own band, and the vectors are not resized until the job is done
+    const SampleBuffer* source = &samples;
+
+    m_recording = JobScheduler::shared().submit(JobScheduler::Background, STORED_PLANES * bands, [this, source, bands](int tile) {
+        int plane = tile / bands;
+        int band = tile % bands;
+
+        if (m_recordingPlanes[plane].empty()) {
+            return true;
+        }
+
+        std::size_t first = (std::size_t) band * BAND_ROWS * source->width();
+        std::size_t count = (std::size_t) std::min(BAND_ROWS, source->height() - band * BAND_ROWS) * source->width();
+        std::vector<int> values(count);
+
+        std::memcpy(values.data(), (const char*) source->plane(plane) + first * 4, count * 4);
+        IterationCodec::compress(values.data(), count, m_recordingPlanes[plane][band]);
+        m_recordingPlanes[plane][band].shrink_to_fit();
+        return true;
+    });
+}
+
+void ViewHistory::finishRecording()
+{
+    if (!m_recording) {
+        return;
+    }
+
+    JobScheduler::shared().wait(m_recording);
+    m_recording.reset();
+
+    Entry& entry = m_entries[m_recordingEntry];
+    entry.m_channels = m_recordingChannels;
+    entry.m_planes.swap(m_recordingPlanes);
+    m_recordingPlanes.clear();
+
+    for (const std::vector<std::vector<unsigned char>>& plane : entry.m_planes) {
+        for (const std::vector<unsigned char>& band : plane) {
+            entry.m_bytes += band.size();
+        }
+    }
+
+    enforceBudget();
+}
+
+void ViewHistory::enforceBudget()
+{
+    std::size_t total = 0;
+
+    for (const Entry& entry : m_entries) {
+        total += entry.m_bytes;
+    }
+
+    while (total > m_budget) {
+        //Drop the samples of the view least likely to be visited next: the one farthest from the current view
+        int farthest = -1;
+
+        for (int i = 0; i < (int) m_entries.size(); i++) {
+            if (m_entries[i].hasSamples() &&
+                (farthest < 0 || std::abs(i - m_current) > std::abs(farthest - m_current))) {
+                farthest = i;
+            }
+        }
+
+        if (farthest < 0) {
+            break;
+        }
+
+        Entry& entry = m_entries[farthest];
+        total -= entry.m_bytes;
+        entry.m_planes.clear();
+        entry.m_channels = SampleBuffer::NoChannels;
+        entry.m_bytes = 0;
+    }
+}
+
+const ViewHistory::Entry* ViewHistory::back(const ZoomRegion& shown, const Formula& shownFormula)
+{
+    finishRecording();
+
+    if (m_current < 0) {
+        return nullptr;
+    }
+
+    if (!(m_entries[m_current].m_region == shown && m_entries[m_current].m_formula == shownFormula)) {
+        return &m_entries[m_current];
+    }
+
+    if (m_current == 0) {
+        return nullptr;
+    }
+
+    return &m_entries[--m_current];
+}
+
+const ViewHistory::Entry* ViewHistory::forward(const ZoomRegion& shown, const Formula& shownFormula)
+{
+    finishRecording();
+
+    if (m_current < 0 || m_current + 1 >= (int) m_entries.size() ||
+        !(m_entries[m_current].m_region == shown && m_entries[m_current].m_formula == shownFormula)) {
+        return nullptr;
+    }
+
+    return &m_entries[++m_current];
+}
@@ -0,0 +1,104 @@
+#ifndef ViewHistory_H
+#define ViewHistory_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Formula.h"
+#include "JobScheduler.h"
+#include "ZoomRegion.h"
+
+class SampleBuffer;
+
+/*
+ * Back and forward navigation between finished views. Each view keeps its
+ * samples compressed with IterationCodec, in bands of rows that are
+ * compressed and decompressed as tiles on the shared JobScheduler, so
+ * stepping back only has to recolor. Recording runs as a background job and
+ * returns at once; restoring is interactive and waits. Iteration state is not
+ * kept: a restored view that needs more iterations is rendered again. When
+ * the compressed samples exceed the memory budget, the views farthest from
+ * the current one lose theirs and are rendered again if they are visited.
+ */
+class ViewHistory
+{
+    public:
+        class Entry
+        {
+            friend class ViewHistory;
+
+            private:
+                ZoomRegion m_region;
+                Formula m_formula;
+                int m_width;
+                int m_height;
+                int m_maxIterations;
+                int m_sampleWidth;
+                int m_sampleHeight;
+                unsigned int m_channels;
+
+                //Per stored plane, one compressed band per BAND_ROWS sample rows
+                std::vector<std::vector<std::vector<unsigned char>>> m_planes;
+                std::size_t m_bytes;
+
+            public:
+                Entry(const ZoomRegion& region, const Formula& formula, int width, int height, int maxIterations);
+
+                const ZoomRegion& region() const    { return m_region; }
+                const Formula& formula() const      { return m_formula; }
+                int width() const                   { return m_width; }
+                int height() const                  { return m_height; }
+                int maxIterations() const           { return m_maxIterations; }
+                bool hasSamples() const             { return m_channels != 0; }
+                unsigned int channels() const       { return m_channels; }
+
+                //Decompresses into samples, which end up with the stored channels only
+                bool restore(SampleBuffer& samples) const;
+        };
+
+    private:
+        std::vector<Entry> m_entries;
+        int m_current;
+        std::size_t m_budget;
+
+        //The samples being compressed, which join their entry once the job is done
+        JobScheduler::JobHandle m_recording;
+        int m_recordingEntry;
+        unsigned int m_recordingChannels;
+        std::vector<std::vector<std::vector<unsigned char>>> m_recordingPlanes;
+
+        ViewHistory(const ViewHistory&);
+        ViewHistory& operator=(const ViewHistory&);
+
+        void enforceBudget();
+
+    public:
+        explicit ViewHistory(std::size_t budgetBytes);
+
+        //Waits for the samples being recorded
+        ~ViewHistory();
+
+        void setBudget(std::size_t budgetBytes);
+
+        /*
+         * Records a finished render of a width x height view of formula. A render of the
+         * current entry's view replaces its samples; any other view becomes
+         * the new current entry and drops the entries ahead of it. The
+         * samples are compressed in the background and must not change or go
+         * away until finishRecording() has returned.
+         */
+        void record(const ZoomRegion& region, const Formula& formula, int width, int height, int maxIterations, const SampleBuffer& samples);
+
+        //Blocks until the samples of the last record() are compressed
+        void finishRecording();
+
+        /*
+         * The entry to show when stepping back from or forward to the view
+         * on screen, or null if there is none. Stepping back from a view that
+         * has not been recorded yet returns to the current entry.
+         */
+        const Entry* back(const ZoomRegion& shown, const Formula& shownFormula);
+        const Entry* forward(const ZoomRegion& shown, const Formula& shownFormula);
+};
+
+#endif
@@ -30,6 +30,11 @@ class ZoomRegion
         Point location() const   { return Point(m_x1, m_y1); }
         double width() const     { return m_x2 - m_x1; }
         double height() const    { return m_y2 - m_y1; }
+
+        bool operator==(const ZoomRegion& other) const
+        {
+            return m_x1 == other.m_x1 && m_y1 == other.m_y1 && m_x2 == other.m_x2 && m_y2 == other.m_y2;
+        }
 };
 
 #endif
@@ -4,6 +4,10 @@
 #include <KUrl>
 
 #include "MainWindow.h"
+#include "TileServer.h"
+#include "Trace.h"
+
+#include <cstdlib>
 
 int main(int argc, char** argv)
 {
@@ -24,14 +28,46 @@ int main(int argc, char** argv)
 
     KCmdLineOptions options;
     options.add("+[file]", ki18n("Document to open"));
+    options.add("worker <address>", ki18n("Run as a headless tile worker listening on unix:<path> or <host>:<port>"));
     KCmdLineArgs::addCmdLineOptions(options);
 
+    KCmdLineArgs *args = KCmdLineArgs::parsedArgs();
+
+    //Worker processes never touch the GUI, so they are started before KApplication
+    if (args->isSet("worker")) {
+        TileServer server;
+
+        if (!server.listen(args->getOption("worker").toLocal8Bit().constData())) {
+            return 1;
+        }
+
+        return server.exec();
+    }
+
+    //Records a timeline from the start and writes it there on exit
+    const char* tracePath = std::getenv("FRAKTAL_TRACE");
+
+    if (tracePath != nullptr) {
+        Trace::setEnabled(true);
+        Trace::nameThread("gui");
+    }
+
     KApplication app;
 
     MainWindow* window = new MainWindow();
     window->show();
 
-    KCmdLineArgs *args = KCmdLineArgs::parsedArgs();
+    if (args->count() > 0) {
+        window->openFile(args->url(0).toLocalFile());
+    }
+
+    args->clear();
+
+    int result = app.exec();
+
+    if (tracePath != nullptr) {
+        Trace::write(tracePath);
+    }
 
-    return app.exec();
+    return result;
 }